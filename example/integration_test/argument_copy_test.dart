@@ -0,0 +1,47 @@
+// Measures what sending a large video as bytes costs the native side: call
+// latency and how much the peak RSS of the process grows during the call.
+// Every copy of `videoBytes` on the way to FFmpeg shows up as growth.
+//
+// Run with a large local file, e.g. 500 MB:
+// flutter test integration_test/argument_copy_test.dart -d linux \
+//   --dart-define=LARGE_VIDEO_PATH=/path/to/video.mp4
+
+import 'dart:io';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:integration_test/integration_test.dart';
+import 'package:pro_video_editor/pro_video_editor.dart';
+
+const _largeVideoPath = String.fromEnvironment('LARGE_VIDEO_PATH');
+
+void main() {
+  IntegrationTestWidgetsFlutterBinding.ensureInitialized();
+
+  testWidgets(
+    'getVideoInformation with videoBytes: peak RSS and latency',
+    (WidgetTester tester) async {
+      final bytes = await File(_largeVideoPath).readAsBytes();
+      final sizeMb = bytes.length / (1024 * 1024);
+      final rssBeforeMb = ProcessInfo.maxRss / (1024 * 1024);
+
+      final watch = Stopwatch()..start();
+      final info = await VideoUtilsService.instance
+          .getVideoInformation(EditorVideo(byteArray: bytes));
+      watch.stop();
+
+      final rssAfterMb = ProcessInfo.maxRss / (1024 * 1024);
+
+      // ignore: avoid_print
+      print('input: ${sizeMb.toStringAsFixed(1)} MB\n'
+          'latency: ${watch.elapsedMilliseconds} ms\n'
+          'peak RSS: ${rssBeforeMb.toStringAsFixed(1)} MB -> '
+          '${rssAfterMb.toStringAsFixed(1)} MB '
+          '(+${(rssAfterMb - rssBeforeMb).toStringAsFixed(1)} MB, '
+          '${((rssAfterMb - rssBeforeMb) / sizeMb).toStringAsFixed(2)} '
+          'copies of the input)');
+
+      expect(info.fileSize, bytes.length);
+    },
+    skip: _largeVideoPath.isEmpty,
+  );
+}
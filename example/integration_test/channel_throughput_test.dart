@@ -0,0 +1,52 @@
+// Measures how fast a large video reaches the native side, once sent as bytes
+// over the platform channel and once passed by path.
+//
+// Run with a large local file, e.g.:
+// flutter test integration_test/channel_throughput_test.dart -d linux \
+//   --dart-define=LARGE_VIDEO_PATH=/path/to/video.mp4
+
+import 'dart:io';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:integration_test/integration_test.dart';
+import 'package:pro_video_editor/pro_video_editor.dart';
+
+const _largeVideoPath = String.fromEnvironment('LARGE_VIDEO_PATH');
+
+void main() {
+  IntegrationTestWidgetsFlutterBinding.ensureInitialized();
+
+  testWidgets(
+    'getVideoInformation throughput: bytes vs path',
+    (WidgetTester tester) async {
+      final file = File(_largeVideoPath);
+      final sizeMb = await file.length() / (1024 * 1024);
+
+      final bytesWatch = Stopwatch()..start();
+      final bytes = await file.readAsBytes();
+      final fromBytes = await VideoUtilsService.instance
+          .getVideoInformation(EditorVideo(byteArray: bytes));
+      bytesWatch.stop();
+
+      final pathWatch = Stopwatch()..start();
+      final fromPath = await VideoUtilsService.instance
+          .getVideoInformation(EditorVideo(file: file));
+      pathWatch.stop();
+
+      String throughput(Stopwatch watch) =>
+          (sizeMb / (watch.elapsedMicroseconds / 1e6)).toStringAsFixed(1);
+
+      // ignore: avoid_print
+      print('${sizeMb.toStringAsFixed(1)} MB\n'
+          'bytes: ${bytesWatch.elapsedMilliseconds} ms '
+          '(${throughput(bytesWatch)} MB/s)\n'
+          'path:  ${pathWatch.elapsedMilliseconds} ms '
+          '(${throughput(pathWatch)} MB/s)');
+
+      expect(fromPath.resolution, fromBytes.resolution);
+      expect(fromPath.duration, fromBytes.duration);
+      expect(fromPath.fileSize, fromBytes.fileSize);
+    },
+    skip: _largeVideoPath.isEmpty,
+  );
+}
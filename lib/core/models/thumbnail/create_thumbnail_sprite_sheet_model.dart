@@ -0,0 +1,25 @@
+import 'create_video_thumbnail_model.dart';
+
+/// A configuration model for packing video thumbnails into one image.
+///
+/// Takes the same options as [CreateVideoThumbnail]. [format] selects the
+/// format of the whole sheet; [ThumbnailFormat.raw] returns RGBA pixels.
+class CreateThumbnailSpriteSheet extends CreateVideoThumbnail {
+  /// Creates a [CreateThumbnailSpriteSheet] configuration.
+  ///
+  /// [columns] is the number of tiles per row. If `null`, the platform packs
+  /// the tiles into a roughly square sheet.
+  CreateThumbnailSpriteSheet({
+    required super.video,
+    required super.timestamps,
+    required super.imageWidth,
+    super.format,
+    super.exactness,
+    super.maxConcurrency,
+    super.quality,
+    this.columns,
+  }) : assert(columns == null || columns > 0, 'columns must be positive');
+
+  /// The number of tiles per row of the sheet.
+  final int? columns;
+}
@@ -11,12 +11,22 @@ class CreateVideoThumbnail {
   /// [timestamps] defines the frames to extract as thumbnails.
   /// [imageWidth] is the target width for each thumbnail in pixels.
   /// [format] specifies the output image format (defaults to [jpeg]).
+  /// [exactness] controls how closely frames match the timestamps (defaults
+  /// to [ThumbnailExactness.exact]).
+  /// [maxConcurrency] limits how many decoders run in parallel.
+  /// [quality] sets the quality of lossy formats from 1 to 100.
   CreateVideoThumbnail({
     required this.video,
     required this.timestamps,
     required this.imageWidth,
     this.format = ThumbnailFormat.jpeg,
-  });
+    this.exactness = ThumbnailExactness.exact,
+    this.maxConcurrency,
+    this.quality,
+  }) : assert(
+          quality == null || (quality >= 1 && quality <= 100),
+          'quality must be between 1 and 100',
+        );
 
   /// The video from which thumbnails will be generated.
   final EditorVideo video;
@@ -32,6 +42,23 @@ class CreateVideoThumbnail {
   /// If the selected [format] isn't supported by the platform, the
   /// default format will be used instead.
   final ThumbnailFormat format;
+
+  /// How closely each thumbnail has to match its timestamp.
+  ///
+  /// Platforms without a keyframe mode always return exact frames.
+  final ThumbnailExactness exactness;
+
+  /// The maximum number of videos decoded in parallel for this request.
+  ///
+  /// If `null`, the platform uses one decoder per CPU core. Only supported
+  /// on Linux.
+  final int? maxConcurrency;
+
+  /// The quality of [ThumbnailFormat.jpeg] and [ThumbnailFormat.webp]
+  /// thumbnails, from 1 (smallest) to 100 (best).
+  ///
+  /// If `null`, the platform default is used. Only supported on Linux.
+  final int? quality;
 }
 
 /// Supported image formats for video thumbnails.
@@ -44,4 +71,24 @@ enum ThumbnailFormat {
 
   /// WebP format (modern, efficient, may not be supported on all platforms).
   webp,
+
+  /// Tightly packed RGBA8888 pixels without any image encoding.
+  ///
+  /// Skips the encode on the native side and the decode in Flutter, which
+  /// suits thumbnails that are only shown on screen. Use
+  /// `VideoUtilsService.createRawVideoThumbnails` to get the frame size.
+  /// Only supported on Linux.
+  raw,
+}
+
+/// How closely a thumbnail has to match its requested timestamp.
+enum ThumbnailExactness {
+  /// The first frame at or after the timestamp.
+  exact,
+
+  /// The keyframe at or before the timestamp.
+  ///
+  /// Only keyframes are decoded, which is much faster on videos with long
+  /// keyframe intervals. Good enough for scrubbing previews.
+  nearestKeyframe,
 }
@@ -0,0 +1,29 @@
+import 'dart:typed_data';
+
+/// A single thumbnail delivered by a streaming thumbnail request.
+class IndexedThumbnail {
+  /// Creates an [IndexedThumbnail].
+  ///
+  /// [index] is the position of the thumbnail's timestamp in the request.
+  /// [bytes] holds the encoded image, or the pixels of a
+  /// `ThumbnailFormat.raw` thumbnail of [width] x [height].
+  const IndexedThumbnail({
+    required this.index,
+    required this.bytes,
+    this.width,
+    this.height,
+  });
+
+  /// The position of the thumbnail's timestamp in
+  /// `CreateVideoThumbnail.timestamps`.
+  final int index;
+
+  /// The encoded image bytes, or RGBA pixels for raw thumbnails.
+  final Uint8List bytes;
+
+  /// The size of a raw thumbnail in pixels, `null` for encoded images.
+  final int? width;
+
+  /// See [width].
+  final int? height;
+}
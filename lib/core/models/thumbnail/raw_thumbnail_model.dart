@@ -0,0 +1,38 @@
+import 'dart:async';
+import 'dart:typed_data';
+import 'dart:ui' as ui;
+
+/// A thumbnail as tightly packed RGBA8888 pixels.
+class RawThumbnail {
+  /// Creates a [RawThumbnail].
+  ///
+  /// [bytes] holds `width * height * 4` bytes, row by row.
+  const RawThumbnail({
+    required this.bytes,
+    required this.width,
+    required this.height,
+  });
+
+  /// The pixels, four bytes (R, G, B, A) each.
+  final Uint8List bytes;
+
+  /// The width of the thumbnail in pixels.
+  final int width;
+
+  /// The height of the thumbnail in pixels.
+  final int height;
+
+  /// Uploads the pixels into an image for `RawImage` or a `Canvas`, without
+  /// decoding an image file.
+  Future<ui.Image> toImage() {
+    final completer = Completer<ui.Image>();
+    ui.decodeImageFromPixels(
+      bytes,
+      width,
+      height,
+      ui.PixelFormat.rgba8888,
+      completer.complete,
+    );
+    return completer.future;
+  }
+}
@@ -0,0 +1,49 @@
+/// Counters of the native thumbnail cache.
+class ThumbnailCacheStats {
+  /// Creates a [ThumbnailCacheStats].
+  const ThumbnailCacheStats({
+    required this.memoryHits,
+    required this.diskHits,
+    required this.misses,
+    required this.memoryBytes,
+    required this.diskBytes,
+  });
+
+  /// Creates a [ThumbnailCacheStats] from the map sent by the platform.
+  factory ThumbnailCacheStats.fromMap(Map<dynamic, dynamic> map) {
+    return ThumbnailCacheStats(
+      memoryHits: map['memoryHits'] ?? 0,
+      diskHits: map['diskHits'] ?? 0,
+      misses: map['misses'] ?? 0,
+      memoryBytes: map['memoryBytes'] ?? 0,
+      diskBytes: map['diskBytes'] ?? 0,
+    );
+  }
+
+  /// Thumbnails served from memory.
+  final int memoryHits;
+
+  /// Thumbnails read back from the on-disk cache.
+  final int diskHits;
+
+  /// Thumbnails that had to be decoded.
+  final int misses;
+
+  /// Size of the in-memory tier in bytes.
+  final int memoryBytes;
+
+  /// Size of the on-disk tier in bytes.
+  final int diskBytes;
+
+  /// The share of lookups served without decoding, from 0.0 to 1.0.
+  double get hitRate {
+    final lookups = memoryHits + diskHits + misses;
+    return lookups == 0 ? 0 : (memoryHits + diskHits) / lookups;
+  }
+
+  @override
+  String toString() {
+    return 'ThumbnailCacheStats(memoryHits: $memoryHits, diskHits: $diskHits, '
+        'misses: $misses, memoryBytes: $memoryBytes, diskBytes: $diskBytes)';
+  }
+}
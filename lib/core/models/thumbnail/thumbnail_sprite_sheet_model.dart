@@ -0,0 +1,79 @@
+import 'dart:async';
+import 'dart:typed_data';
+import 'dart:ui' as ui;
+
+import 'create_video_thumbnail_model.dart';
+
+/// Thumbnails packed into a single image, so they are decoded and uploaded
+/// to the GPU once instead of one by one.
+class ThumbnailSpriteSheet {
+  /// Creates a [ThumbnailSpriteSheet].
+  const ThumbnailSpriteSheet({
+    required this.bytes,
+    required this.format,
+    required this.width,
+    required this.height,
+    required this.tiles,
+  });
+
+  /// Creates a [ThumbnailSpriteSheet] from the map sent by the platform.
+  factory ThumbnailSpriteSheet.fromMap(
+    Map<dynamic, dynamic> map,
+    ThumbnailFormat format,
+  ) {
+    final List<dynamic> tiles = map['tiles'] ?? [];
+    return ThumbnailSpriteSheet(
+      bytes: map['bytes'] as Uint8List,
+      format: format,
+      width: map['width'] as int,
+      height: map['height'] as int,
+      tiles: tiles.map((tile) {
+        if (tile is! Map) return null;
+        return ui.Rect.fromLTWH(
+          (tile['x'] as int).toDouble(),
+          (tile['y'] as int).toDouble(),
+          (tile['width'] as int).toDouble(),
+          (tile['height'] as int).toDouble(),
+        );
+      }).toList(),
+    );
+  }
+
+  /// The encoded sheet, or its RGBA pixels for [ThumbnailFormat.raw].
+  final Uint8List bytes;
+
+  /// The format of [bytes].
+  final ThumbnailFormat format;
+
+  /// The width of the sheet in pixels.
+  final int width;
+
+  /// The height of the sheet in pixels.
+  final int height;
+
+  /// The area of each thumbnail in the sheet, in the order of the requested
+  /// timestamps. `null` for thumbnails that could not be extracted.
+  ///
+  /// Draw one with `Canvas.drawImageRect` or `Canvas.drawAtlas`.
+  final List<ui.Rect?> tiles;
+
+  /// Decodes the sheet into an image, without decoding for raw sheets.
+  Future<ui.Image> toImage() async {
+    if (format != ThumbnailFormat.raw) {
+      final codec = await ui.instantiateImageCodec(bytes);
+      final frame = await codec.getNextFrame();
+      codec.dispose();
+      return frame.image;
+    }
+
+    final completer = Completer<ui.Image>();
+    ui.decodeImageFromPixels(
+      bytes,
+      width,
+      height,
+      ui.PixelFormat.rgba8888,
+      completer.complete,
+    );
+    return completer.future;
+  }
+}
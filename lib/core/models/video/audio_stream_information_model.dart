@@ -0,0 +1,68 @@
+/// Metadata of one audio stream of a video.
+class AudioStreamInformation {
+  /// Creates an [AudioStreamInformation] instance.
+  const AudioStreamInformation({
+    this.codec,
+    this.sampleFormat,
+    this.sampleRate,
+    this.channels,
+    this.channelLayout,
+    this.bitRate,
+  });
+
+  /// Creates an [AudioStreamInformation] from the map sent by the platform.
+  factory AudioStreamInformation.fromMap(Map<dynamic, dynamic> map) {
+    int? positive(dynamic value) => value is int && value > 0 ? value : null;
+    return AudioStreamInformation(
+      codec: map['codec'],
+      sampleFormat: map['sampleFormat'],
+      sampleRate: positive(map['sampleRate']),
+      channels: positive(map['channels']),
+      channelLayout: map['channelLayout'],
+      bitRate: positive(map['bitRate']),
+    );
+  }
+
+  /// The name of the codec, e.g. "aac" or "opus".
+  final String? codec;
+
+  /// The sample format of the decoded audio, e.g. "fltp".
+  final String? sampleFormat;
+
+  /// Samples per second.
+  final int? sampleRate;
+
+  /// The number of channels.
+  final int? channels;
+
+  /// The channel layout, e.g. "stereo" or "5.1".
+  final String? channelLayout;
+
+  /// Bits per second of the encoded stream.
+  final int? bitRate;
+
+  @override
+  bool operator ==(Object other) {
+    if (identical(this, other)) return true;
+
+    return other is AudioStreamInformation &&
+        other.codec == codec &&
+        other.sampleFormat == sampleFormat &&
+        other.sampleRate == sampleRate &&
+        other.channels == channels &&
+        other.channelLayout == channelLayout &&
+        other.bitRate == bitRate;
+  }
+
+  @override
+  int get hashCode {
+    return Object.hash(
+      codec,
+      sampleFormat,
+      sampleRate,
+      channels,
+      channelLayout,
+      bitRate,
+    );
+  }
+}
@@ -3,6 +3,7 @@ import 'dart:typed_data';
 import '/core/platform/io/io_helper.dart';
 import '/shared/utils/converters.dart';
 import '/shared/utils/file_constructor_utils.dart';
+import 'video_range_reader_model.dart';
 
 /// A model that encapsulates various ways to load and represent a video.
 ///
@@ -14,11 +15,12 @@ class EditorVideo {
   /// properties.
   ///
   /// At least one of `byteArray`, `file`, `networkUrl`, or `assetPath`
-  /// must not be null.
+  /// must not be null. `rangeReader` is an optional faster way to read it.
   EditorVideo({
     this.byteArray,
     this.networkUrl,
     this.assetPath,
+    this.rangeReader,
     dynamic file,
   })  : file = file == null ? null : ensureFileInstance(file),
         assert(
@@ -42,6 +44,14 @@ class EditorVideo {
   /// A string representing the asset path of an video.
   final String? assetPath;
 
+  /// Reads the same video on demand.
+  ///
+  /// Used by `getVideoInformation` on Linux, which then only reads the
+  /// headers instead of loading the whole video. Network videos without a
+  /// reader are read with an [HttpVideoRangeReader] there. Other operations
+  /// load the video from its source.
+  final VideoRangeReader? rangeReader;
+
   /// Indicates whether the `byteArray` property is not null.
   bool get hasBytes => byteArray != null;
 
@@ -54,6 +64,13 @@ class EditorVideo {
   /// Indicates whether the `assetPath` property is not null.
   bool get hasAssetPath => assetPath != null;
 
+  /// The path of the video on the local file system, if it was loaded from a
+  /// file.
+  ///
+  /// Platforms that can read the file directly use this path instead of
+  /// transferring the video bytes over the platform channel.
+  String? get localPath => hasFile ? file!.path : null;
+
   /// A future that retrieves the image data as a `Uint8List` from the
   /// appropriate source based on the `EditorVideoType`.
   Future<Uint8List> safeByteArray() async {
@@ -99,12 +116,14 @@ class EditorVideo {
     File? file,
     String? networkUrl,
     String? assetPath,
+    VideoRangeReader? rangeReader,
   }) {
     return EditorVideo(
       byteArray: byteArray ?? this.byteArray,
       file: file ?? this.file,
       networkUrl: networkUrl ?? this.networkUrl,
       assetPath: assetPath ?? this.assetPath,
+      rangeReader: rangeReader ?? this.rangeReader,
     );
   }
 
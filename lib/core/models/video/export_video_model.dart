@@ -29,6 +29,8 @@ class ExportVideoModel {
     this.colorFilters = const [],
     this.customFilter = '',
     this.encoding = const VideoEncoding(),
+    this.allowStreamCopy = false,
+    this.parallelSegments = 1,
   })  : assert(
           startTime == null || endTime == null || startTime < endTime,
           'startTime must be before endTime',
@@ -36,6 +38,10 @@ class ExportVideoModel {
         assert(
           blur >= 0,
           'Blur must be greater than or equal to 0',
+        ),
+        assert(
+          parallelSegments >= 0,
+          'parallelSegments must be greater than or equal to 0',
         );
 
   /// The target format for the exported video.
@@ -101,6 +107,33 @@ class ExportVideoModel {
   /// The encoding settings used for exporting the video.
   final VideoEncoding encoding;
 
+  /// Whether an export that only trims may copy the unchanged video instead
+  /// of re-encoding it.
+  ///
+  /// Only the frames around [startTime] and [endTime] are re-encoded, which
+  /// is much faster, but the copied part keeps the quality and encoding
+  /// settings of the source: [outputQuality], [encodingPreset] and bitrate
+  /// or quality arguments of [encoding] (`-crf`, `-preset`, `-b:v`,
+  /// `-qscale`) are ignored for it. Used on Linux when no filters, color
+  /// filters or visible layers are applied and the codec and pixel format
+  /// match the source.
+  ///
+  /// **Default**: `false`
+  final bool allowStreamCopy;
+
+  /// Into how many segments the export is split to encode them at the same
+  /// time.
+  ///
+  /// The video is cut at keyframes of the source, every segment is decoded,
+  /// filtered and encoded on its own thread and the encoded segments are
+  /// joined without re-encoding. This speeds up long exports on machines
+  /// with many cores. Each segment starts with a keyframe, and segments are
+  /// at least 10 seconds long. `0` picks a count from the number of cores,
+  /// `1` exports in a single pass. Used on Linux.
+  ///
+  /// **Default**: `1`
+  final int parallelSegments;
+
   /// The FFmpeg constant rate factor (CRF) for the selected [outputQuality].
   ///
   /// Lower CRF means better quality and larger file size.
@@ -219,6 +252,8 @@ class ExportVideoModel {
     ExportTransform? transform,
     String? customFilter,
     VideoEncoding? encoding,
+    bool? allowStreamCopy,
+    int? parallelSegments,
   }) {
     return ExportVideoModel(
       outputFormat: outputFormat ?? this.outputFormat,
@@ -236,6 +271,8 @@ class ExportVideoModel {
       transform: transform ?? this.transform,
       customFilter: customFilter ?? this.customFilter,
       encoding: encoding ?? this.encoding,
+      allowStreamCopy: allowStreamCopy ?? this.allowStreamCopy,
+      parallelSegments: parallelSegments ?? this.parallelSegments,
     );
   }
 
@@ -258,7 +295,9 @@ class ExportVideoModel {
         other.devicePixelRatio == devicePixelRatio &&
         other.transform == transform &&
         other.customFilter == customFilter &&
-        other.encoding == encoding;
+        other.encoding == encoding &&
+        other.allowStreamCopy == allowStreamCopy &&
+        other.parallelSegments == parallelSegments;
   }
 
   @override
@@ -277,7 +316,9 @@ class ExportVideoModel {
         devicePixelRatio.hashCode ^
         transform.hashCode ^
         customFilter.hashCode ^
-        encoding.hashCode;
+        encoding.hashCode ^
+        allowStreamCopy.hashCode ^
+        parallelSegments.hashCode;
   }
 }
 
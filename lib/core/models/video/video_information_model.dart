@@ -1,5 +1,9 @@
 import 'dart:ui';
 
+import 'package:flutter/foundation.dart';
+
+import 'audio_stream_information_model.dart';
+
 /// A class that holds metadata information about a video.
 class VideoInformation {
   /// Creates a [VideoInformation] instance.
@@ -8,11 +12,25 @@ class VideoInformation {
   /// - [extension]: The file format of the video (e.g., "mp4", "avi").
   /// - [fileSize]: The size of the video file in bytes.
   /// - [resolution]: The width and height of the video in pixels.
+  ///
+  /// The other fields are only reported by platforms that read them, and
+  /// are `null` when unknown.
   VideoInformation({
     required this.duration,
     required this.extension,
     required this.fileSize,
     required this.resolution,
+    this.frameRate,
+    this.averageFrameRate,
+    this.rotation = 0,
+    this.containerFormat,
+    this.videoCodec,
+    this.pixelFormat,
+    this.videoBitRate,
+    this.bitRate,
+    this.audioStreams = const [],
+    this.indexEntries,
+    this.keyframeCount,
   });
 
   /// The size of the video file in bytes.
@@ -20,6 +38,8 @@ class VideoInformation {
 
   /// The resolution of the video, represented as a [Size] object.
   ///
+  /// This is the coded size, before [rotation] is applied.
+  ///
   /// Example:
   /// ```dart
   /// Size(1920, 1080) // Full HD resolution
@@ -37,18 +57,81 @@ class VideoInformation {
   /// The format of the video file, such as "mp4" or "avi".
   final String extension;
 
+  /// The base frame rate of the video stream in frames per second, the
+  /// lowest rate all timestamps can be represented in.
+  final double? frameRate;
+
+  /// The average frame rate of the video stream in frames per second.
+  final double? averageFrameRate;
+
+  /// The clockwise rotation in degrees (0, 90, 180 or 270) a player applies
+  /// when displaying the video.
+  final int rotation;
+
+  /// The name of the container format, e.g. "mov,mp4,m4a,3gp,3g2,mj2" or
+  /// "matroska,webm".
+  final String? containerFormat;
+
+  /// The name of the video codec, e.g. "h264" or "hevc".
+  final String? videoCodec;
+
+  /// The pixel format of the decoded frames, e.g. "yuv420p".
+  final String? pixelFormat;
+
+  /// Bits per second of the video stream.
+  final int? videoBitRate;
+
+  /// Bits per second of the whole file.
+  final int? bitRate;
+
+  /// The audio streams of the video, in container order.
+  final List<AudioStreamInformation> audioStreams;
+
+  /// The number of entries in the container's seek index of the video
+  /// stream.
+  ///
+  /// Some containers load their index lazily, e.g. Matroska, so it may
+  /// be 0 there even though the video can be seeked.
+  final int? indexEntries;
+
+  /// The number of keyframes in the container's seek index, see
+  /// [indexEntries].
+  final int? keyframeCount;
+
   /// Returns a copy of this config with the given fields replaced.
   VideoInformation copyWith({
     int? fileSize,
     Size? resolution,
     Duration? duration,
     String? extension,
+    double? frameRate,
+    double? averageFrameRate,
+    int? rotation,
+    String? containerFormat,
+    String? videoCodec,
+    String? pixelFormat,
+    int? videoBitRate,
+    int? bitRate,
+    List<AudioStreamInformation>? audioStreams,
+    int? indexEntries,
+    int? keyframeCount,
   }) {
     return VideoInformation(
       fileSize: fileSize ?? this.fileSize,
       resolution: resolution ?? this.resolution,
       duration: duration ?? this.duration,
       extension: extension ?? this.extension,
+      frameRate: frameRate ?? this.frameRate,
+      averageFrameRate: averageFrameRate ?? this.averageFrameRate,
+      rotation: rotation ?? this.rotation,
+      containerFormat: containerFormat ?? this.containerFormat,
+      videoCodec: videoCodec ?? this.videoCodec,
+      pixelFormat: pixelFormat ?? this.pixelFormat,
+      videoBitRate: videoBitRate ?? this.videoBitRate,
+      bitRate: bitRate ?? this.bitRate,
+      audioStreams: audioStreams ?? this.audioStreams,
+      indexEntries: indexEntries ?? this.indexEntries,
+      keyframeCount: keyframeCount ?? this.keyframeCount,
     );
   }
 
@@ -60,7 +143,18 @@ class VideoInformation {
         other.fileSize == fileSize &&
         other.resolution == resolution &&
         other.duration == duration &&
-        other.extension == extension;
+        other.extension == extension &&
+        other.frameRate == frameRate &&
+        other.averageFrameRate == averageFrameRate &&
+        other.rotation == rotation &&
+        other.containerFormat == containerFormat &&
+        other.videoCodec == videoCodec &&
+        other.pixelFormat == pixelFormat &&
+        other.videoBitRate == videoBitRate &&
+        other.bitRate == bitRate &&
+        listEquals(other.audioStreams, audioStreams) &&
+        other.indexEntries == indexEntries &&
+        other.keyframeCount == keyframeCount;
   }
 
   @override
@@ -68,6 +162,32 @@ class VideoInformation {
     return fileSize.hashCode ^
         resolution.hashCode ^
         duration.hashCode ^
-        extension.hashCode;
+        extension.hashCode ^
+        Object.hash(
+          frameRate,
+          averageFrameRate,
+          rotation,
+          containerFormat,
+          videoCodec,
+          pixelFormat,
+          videoBitRate,
+          bitRate,
+          Object.hashAll(audioStreams),
+          indexEntries,
+          keyframeCount,
+        );
   }
 }
+
+/// How thoroughly a video is analyzed to read its [VideoInformation].
+enum VideoProbeMode {
+  /// Reads the container headers (e.g. the MP4 `moov` box or the Matroska
+  /// segment info) and only analyzes the streams if they miss a field.
+  ///
+  /// Much faster on most files, and the result is the same.
+  fast,
+
+  /// Always analyzes the streams, which may decode several seconds of
+  /// frames.
+  full,
+}
@@ -0,0 +1,74 @@
+import 'dart:math';
+import 'dart:typed_data';
+
+import 'package:http/http.dart' as http;
+
+/// Reads parts of a video on demand.
+///
+/// Lets the platform read only the bytes it needs, e.g. the headers of a
+/// huge video for `VideoUtilsService.getVideoInformation`, instead of
+/// loading the whole video into memory first.
+abstract class VideoRangeReader {
+  /// The total size of the video in bytes.
+  Future<int> length();
+
+  /// Reads up to [length] bytes starting at [offset]. Returns fewer bytes
+  /// only at the end of the video.
+  Future<Uint8List> read(int offset, int length);
+}
+
+/// Reads a video over HTTP with `Range` requests.
+///
+/// Servers without range support send the whole video on the first read;
+/// it is then kept in memory for the following reads.
+class HttpVideoRangeReader implements VideoRangeReader {
+  /// Creates an [HttpVideoRangeReader] for [url].
+  ///
+  /// Requests are sent with [client] if given, which then stays open on
+  /// [close].
+  HttpVideoRangeReader(this.url, {http.Client? client})
+      : _client = client ?? http.Client(),
+        _ownsClient = client == null;
+
+  /// The URL of the video.
+  final String url;
+
+  final http.Client _client;
+  final bool _ownsClient;
+  Uint8List? _body;
+
+  /// Closes the connections of the reader.
+  void close() {
+    if (_ownsClient) _client.close();
+    _body = null;
+  }
+
+  @override
+  Future<int> length() async {
+    final response = await _client.head(Uri.parse(url));
+    final length = int.tryParse(response.headers['content-length'] ?? '');
+    if (response.statusCode != 200 || length == null) {
+      throw Exception('Failed to read the size of the video: $url');
+    }
+    return length;
+  }
+
+  @override
+  Future<Uint8List> read(int offset, int length) async {
+    var body = _body;
+    if (body == null) {
+      final response = await _client.get(
+        Uri.parse(url),
+        headers: {'range': 'bytes=$offset-${offset + length - 1}'},
+      );
+      if (response.statusCode == 206) return response.bodyBytes;
+      if (response.statusCode != 200) {
+        throw Exception('Failed to load video: $url');
+      }
+      body = _body = response.bodyBytes;
+    }
+
+    final start = min(offset, body.length);
+    return Uint8List.sublistView(body, start, min(start + length, body.length));
+  }
+}
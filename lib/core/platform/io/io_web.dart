@@ -15,6 +15,11 @@ class File {
     throw ArgumentError('This function is not supported on the web.');
   }
 
+  /// Write bytes async
+  Future<File> writeAsBytes(List<int> bytes, {bool flush = false}) async {
+    throw ArgumentError('This function is not supported on the web.');
+  }
+
   /// Read bytes async
   Future<Uint8List> readAsBytes() async {
     throw ArgumentError('This function is not supported on the web.');
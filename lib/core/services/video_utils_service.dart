@@ -2,7 +2,12 @@ import 'dart:typed_data';
 
 import 'package:pro_video_editor/core/models/video/export_video_model.dart';
 
+import '/core/models/thumbnail/create_thumbnail_sprite_sheet_model.dart';
 import '/core/models/thumbnail/create_video_thumbnail_model.dart';
+import '/core/models/thumbnail/indexed_thumbnail_model.dart';
+import '/core/models/thumbnail/raw_thumbnail_model.dart';
+import '/core/models/thumbnail/thumbnail_cache_stats_model.dart';
+import '/core/models/thumbnail/thumbnail_sprite_sheet_model.dart';
 import '/core/models/video/editor_video_model.dart';
 import '/core/models/video/video_information_model.dart';
 import '/pro_video_editor_platform_interface.dart';
@@ -25,14 +30,54 @@ class VideoUtilsService {
     return ProVideoEditorPlatform.instance.getPlatformVersion();
   }
 
+  /// Keeps [value] open on the native side, so following calls with the same
+  /// [EditorVideo] instance reuse the opened video instead of sending and
+  /// probing it again. Exports of the same `videoBytes` reuse it as well.
+  ///
+  /// The platform may close least recently used videos under memory
+  /// pressure; calls then transparently send the video again. Release it
+  /// with [closeVideo] when done.
+  Future<void> openVideo(EditorVideo value) {
+    return ProVideoEditorPlatform.instance.openVideo(value);
+  }
+
+  /// Releases the native resources held for a video opened by [openVideo].
+  Future<void> closeVideo(EditorVideo value) {
+    return ProVideoEditorPlatform.instance.closeVideo(value);
+  }
+
   /// Retrieves detailed information about the given video.
   ///
   /// [value] is an [EditorVideo] instance that can point to a file, memory,
   /// network URL, or asset.
   ///
+  /// [probeMode] trades analysis for speed; see [VideoProbeMode].
+  ///
   /// Returns a [Future] containing [VideoInformation] about the video.
-  Future<VideoInformation> getVideoInformation(EditorVideo value) {
-    return ProVideoEditorPlatform.instance.getVideoInformation(value);
+  Future<VideoInformation> getVideoInformation(
+    EditorVideo value, {
+    VideoProbeMode probeMode = VideoProbeMode.fast,
+  }) {
+    return ProVideoEditorPlatform.instance
+        .getVideoInformation(value, probeMode: probeMode);
+  }
+
+  /// Retrieves information about many videos at once, e.g. when importing a
+  /// folder of clips.
+  ///
+  /// On Linux the videos are probed in parallel, at most [maxConcurrency]
+  /// at once (one per CPU core by default). The results are in the order
+  /// of [values]; videos that could not be read are `null`.
+  Future<List<VideoInformation?>> getVideoInformationBatch(
+    List<EditorVideo> values, {
+    VideoProbeMode probeMode = VideoProbeMode.fast,
+    int? maxConcurrency,
+  }) {
+    return ProVideoEditorPlatform.instance.getVideoInformationBatch(
+      values,
+      probeMode: probeMode,
+      maxConcurrency: maxConcurrency,
+    );
   }
 
   /// Creates thumbnails from the given video based on the specified config.
@@ -47,6 +92,49 @@ class VideoUtilsService {
     return ProVideoEditorPlatform.instance.createVideoThumbnails(value);
   }
 
+  /// Creates thumbnails like [createVideoThumbnails], but as raw RGBA pixels
+  /// with their size instead of encoded images. `value.format` is ignored.
+  ///
+  /// Showing them with [RawThumbnail.toImage] skips encoding the image on
+  /// the native side and decoding it again in Flutter. Entries that could
+  /// not be extracted are `null`. Only supported on Linux.
+  Future<List<RawThumbnail?>> createRawVideoThumbnails(
+    CreateVideoThumbnail value,
+  ) {
+    return ProVideoEditorPlatform.instance.createRawVideoThumbnails(value);
+  }
+
+  /// Creates thumbnails like [createVideoThumbnails], but emits each one as
+  /// soon as it is encoded.
+  ///
+  /// Thumbnails arrive in order of completion; use [IndexedThumbnail.index]
+  /// to place them. The stream closes once all thumbnails are delivered.
+  Stream<IndexedThumbnail> createVideoThumbnailsStream(
+    CreateVideoThumbnail value,
+  ) {
+    return ProVideoEditorPlatform.instance.createVideoThumbnailsStream(value);
+  }
+
+  /// Creates thumbnails like [createVideoThumbnails], but packed into a
+  /// single image with the area of each one in
+  /// [ThumbnailSpriteSheet.tiles].
+  ///
+  /// A timeline then decodes and uploads one texture instead of one per
+  /// thumbnail. Only supported on Linux.
+  Future<ThumbnailSpriteSheet> createThumbnailSpriteSheet(
+    CreateThumbnailSpriteSheet value,
+  ) {
+    return ProVideoEditorPlatform.instance.createThumbnailSpriteSheet(value);
+  }
+
+  /// Returns the hit and miss counters of the thumbnail cache.
+  ///
+  /// Thumbnails are cached by the content of the video, timestamp, width,
+  /// format and exactness, so repeated requests skip decoding.
+  Future<ThumbnailCacheStats> getThumbnailCacheStats() {
+    return ProVideoEditorPlatform.instance.getThumbnailCacheStats();
+  }
+
   /// Exports a video using the given [value] configuration.
   ///
   /// Delegates the export to the platform-specific implementation and returns
@@ -55,6 +143,16 @@ class VideoUtilsService {
     return ProVideoEditorPlatform.instance.exportVideo(value);
   }
 
+  /// Exports a video using the given [value] configuration into the file at
+  /// [outputPath] and returns that path.
+  ///
+  /// On Linux the encoded video is written straight to the file, so memory
+  /// use stays flat however long the video is. Not supported on the web.
+  Future<String> exportVideoToFile(ExportVideoModel value, String outputPath) {
+    return ProVideoEditorPlatform.instance
+        .exportVideoToFile(value, outputPath);
+  }
+
   /// A stream that emits export progress updates as a double from 0.0 to 1.0.
   ///
   /// Useful for showing progress indicators during the export process.
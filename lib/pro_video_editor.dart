@@ -1,8 +1,15 @@
+export 'core/models/thumbnail/create_thumbnail_sprite_sheet_model.dart';
 export 'core/models/thumbnail/create_video_thumbnail_model.dart';
+export 'core/models/thumbnail/indexed_thumbnail_model.dart';
+export 'core/models/thumbnail/raw_thumbnail_model.dart';
+export 'core/models/thumbnail/thumbnail_cache_stats_model.dart';
+export 'core/models/thumbnail/thumbnail_sprite_sheet_model.dart';
+export 'core/models/video/audio_stream_information_model.dart';
 export 'core/models/video/editor_video_model.dart';
 export 'core/models/video/encoding/video_encoding.dart';
 export 'core/models/video/export_transform_model.dart';
 export 'core/models/video/export_video_model.dart';
 export 'core/models/video/video_information_model.dart';
+export 'core/models/video/video_range_reader_model.dart';
 export 'core/services/video_utils_service.dart';
 export 'shared/utils/converters.dart';
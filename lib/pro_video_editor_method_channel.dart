@@ -1,3 +1,5 @@
+import 'dart:async';
+
 import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
 import 'package:mime/mime.dart';
@@ -5,9 +7,16 @@ import 'package:mime/mime.dart';
 import '/core/models/video/editor_video_model.dart';
 import '/shared/utils/parser/double_parser.dart';
 import '/shared/utils/parser/int_parser.dart';
+import 'core/models/thumbnail/create_thumbnail_sprite_sheet_model.dart';
 import 'core/models/thumbnail/create_video_thumbnail_model.dart';
+import 'core/models/thumbnail/indexed_thumbnail_model.dart';
+import 'core/models/thumbnail/raw_thumbnail_model.dart';
+import 'core/models/thumbnail/thumbnail_cache_stats_model.dart';
+import 'core/models/thumbnail/thumbnail_sprite_sheet_model.dart';
+import 'core/models/video/audio_stream_information_model.dart';
 import 'core/models/video/export_video_model.dart';
 import 'core/models/video/video_information_model.dart';
+import 'core/models/video/video_range_reader_model.dart';
 import 'pro_video_editor_platform_interface.dart';
 
 /// An implementation of [ProVideoEditorPlatform] that uses method channels.
@@ -16,6 +25,25 @@ class MethodChannelProVideoEditor extends ProVideoEditorPlatform {
   @visibleForTesting
   final methodChannel = const MethodChannel('pro_video_editor');
   final _progressChannel = const EventChannel('pro_video_editor_progress');
+  final _thumbnailChannel = const EventChannel('pro_video_editor_thumbnails');
+
+  /// Identifies the events of concurrent streaming thumbnail requests.
+  int _nextThumbnailRequestId = 0;
+
+  /// Native sessions of the videos passed to [openVideo].
+  final _sessions = Expando<_VideoSession>();
+
+  /// The same sessions by the bytes of in-memory videos, so an export of
+  /// those bytes can reuse them.
+  final _byteSessions = Expando<_VideoSession>();
+
+  /// Readers the native side currently reads videos through.
+  final _rangeReaders = <int, VideoRangeReader>{};
+  int _nextRangeReaderId = 0;
+  bool _handlesNativeCalls = false;
+
+  bool get _isLinux =>
+      !kIsWeb && defaultTargetPlatform == TargetPlatform.linux;
 
   @override
   Future<String?> getPlatformVersion() async {
@@ -25,74 +53,337 @@ class MethodChannelProVideoEditor extends ProVideoEditorPlatform {
   }
 
   @override
-  Future<VideoInformation> getVideoInformation(EditorVideo value) async {
-    var videoBytes = await value.safeByteArray();
+  Future<void> openVideo(EditorVideo value) async {
+    if (!_isLinux || _sessions[value] != null) return;
 
-    var extension = _getFileExtension(videoBytes);
+    var sourceArgs = await _videoSourceArgs(value);
+    final id = await methodChannel.invokeMethod<int>('openVideo', sourceArgs);
+    if (id == null) return;
 
-    final response = await methodChannel
-            .invokeMethod<Map<dynamic, dynamic>>('getVideoInformation', {
-          'videoBytes': videoBytes,
-          'extension': extension,
-        }) ??
-        {};
+    final bytes = sourceArgs['videoBytes'];
+    final session = _VideoSession(
+      id: id,
+      extension: sourceArgs['extension'],
+      bytes: bytes is Uint8List ? bytes : null,
+    );
+    _sessions[value] = session;
+    if (session.bytes != null) _byteSessions[session.bytes!] = session;
+  }
+
+  @override
+  Future<void> closeVideo(EditorVideo value) async {
+    final session = _sessions[value];
+    if (session == null) return;
+
+    _forgetSession(value);
+    await methodChannel.invokeMethod<void>('closeVideo', {
+      'sessionId': session.id,
+    });
+  }
+
+  @override
+  Future<VideoInformation> getVideoInformation(
+    EditorVideo value, {
+    VideoProbeMode probeMode = VideoProbeMode.fast,
+  }) async {
+    final reader = _rangeReaderOf(value);
+    if (reader != null) {
+      try {
+        return await _getVideoInformationByRanges(reader, probeMode);
+      } on Exception {
+        // E.g. a server that does not tell the size; load it as usual.
+        if (value.rangeReader != null) rethrow;
+      } finally {
+        if (reader != value.rangeReader && reader is HttpVideoRangeReader) {
+          reader.close();
+        }
+      }
+    }
+
+    final (response, sourceArgs) =
+        await _invokeWithVideo<Map<dynamic, dynamic>>(
+      'getVideoInformation',
+      value,
+      {'probeMode': probeMode.name},
+    );
+
+    return _videoInformation(response, sourceArgs['extension']);
+  }
+
+  @override
+  Future<List<VideoInformation?>> getVideoInformationBatch(
+    List<EditorVideo> values, {
+    VideoProbeMode probeMode = VideoProbeMode.fast,
+    int? maxConcurrency,
+  }) async {
+    if (!_isLinux) {
+      return super.getVideoInformationBatch(values, probeMode: probeMode);
+    }
+
+    final results = List<Future<VideoInformation?>?>.filled(
+      values.length,
+      null,
+    );
+    // Videos read on demand go one by one, the native side calls back for
+    // their ranges; the others are probed natively in one call.
+    final batchIndices = <int>[];
+    final batchArgs = <Map<String, dynamic>>[];
+    for (var i = 0; i < values.length; i++) {
+      if (_rangeReaderOf(values[i]) != null) {
+        results[i] = _tryGetVideoInformation(values[i], probeMode);
+      } else {
+        batchIndices.add(i);
+        batchArgs.add(await _videoArgs(values[i]));
+      }
+    }
+
+    final response = batchArgs.isEmpty
+        ? <dynamic>[]
+        : await methodChannel
+            .invokeMethod<List<dynamic>>('getVideoInformationBatch', {
+            'videos': batchArgs,
+            'probeMode': probeMode.name,
+            if (maxConcurrency != null) 'maxConcurrency': maxConcurrency,
+          });
+
+    for (var k = 0; k < batchIndices.length; k++) {
+      final i = batchIndices[k];
+      final entry = response != null && k < response.length ? response[k] : null;
+      if (entry is! Map) {
+        results[i] = Future.value(null);
+      } else if (entry['errorCode'] == 'SessionNotFound') {
+        // The session was evicted; send the video itself again.
+        results[i] = _tryGetVideoInformation(values[i], probeMode);
+      } else if (entry['errorCode'] != null) {
+        results[i] = Future.value(null);
+      } else {
+        results[i] = Future.value(
+          _videoInformation(entry, batchArgs[k]['extension']),
+        );
+      }
+    }
+
+    return Future.wait(results.map((result) => result!));
+  }
+
+  Future<VideoInformation?> _tryGetVideoInformation(
+    EditorVideo value,
+    VideoProbeMode probeMode,
+  ) async {
+    try {
+      return await getVideoInformation(value, probeMode: probeMode);
+    } catch (_) {
+      return null;
+    }
+  }
+
+  /// Probes a video the native side reads through [reader], so only the
+  /// ranges it seeks to are transferred.
+  Future<VideoInformation> _getVideoInformationByRanges(
+    VideoRangeReader reader,
+    VideoProbeMode probeMode,
+  ) async {
+    final size = await reader.length();
+    final header = await reader.read(0, defaultMagicNumbersMaxLength);
+    final extension = _getFileExtension(header);
+
+    _listenToNativeCalls();
+    final id = _nextRangeReaderId++;
+    _rangeReaders[id] = reader;
+    try {
+      final response = await methodChannel
+          .invokeMethod<Map<dynamic, dynamic>>('getVideoInformation', {
+        'readerId': id,
+        'videoSize': size,
+        'extension': extension,
+        'probeMode': probeMode.name,
+      });
+      return _videoInformation(response, extension);
+    } finally {
+      _rangeReaders.remove(id);
+    }
+  }
+
+  VideoInformation _videoInformation(
+    Map<dynamic, dynamic>? response,
+    String extension,
+  ) {
+    // Platforms report unknown numbers as 0 or leave them out.
+    int? positiveInt(dynamic value) => value is int && value > 0 ? value : null;
+    double? positiveDouble(dynamic value) =>
+        value is num && value > 0 ? value.toDouble() : null;
+    final List<dynamic> audioStreams = response?['audioStreams'] ?? [];
 
     return VideoInformation(
-      duration: Duration(milliseconds: safeParseInt(response['duration'])),
+      duration: Duration(milliseconds: safeParseInt(response?['duration'])),
       extension: extension,
-      fileSize: response['fileSize'] ?? 0,
+      fileSize: response?['fileSize'] ?? 0,
       resolution: Size(
-        safeParseDouble(response['width']),
-        safeParseDouble(response['height']),
+        safeParseDouble(response?['width']),
+        safeParseDouble(response?['height']),
       ),
+      frameRate: positiveDouble(response?['frameRate']),
+      averageFrameRate: positiveDouble(response?['averageFrameRate']),
+      rotation: safeParseInt(response?['rotation']),
+      containerFormat: response?['containerFormat'],
+      videoCodec: response?['videoCodec'],
+      pixelFormat: response?['pixelFormat'],
+      videoBitRate: positiveInt(response?['videoBitRate']),
+      bitRate: positiveInt(response?['bitRate']),
+      audioStreams: audioStreams
+          .whereType<Map<dynamic, dynamic>>()
+          .map(AudioStreamInformation.fromMap)
+          .toList(),
+      indexEntries: response?['indexEntries'],
+      keyframeCount: response?['keyframeCount'],
     );
   }
 
+  /// The reader to probe [video] with, if reading it on demand beats
+  /// loading it. Files are already read on demand by their path.
+  VideoRangeReader? _rangeReaderOf(EditorVideo video) {
+    if (!_isLinux || _sessions[video] != null) return null;
+    if (video.hasBytes || video.hasFile) return null;
+    if (video.rangeReader != null) return video.rangeReader;
+    return video.hasNetworkUrl ? HttpVideoRangeReader(video.networkUrl!) : null;
+  }
+
+  void _listenToNativeCalls() {
+    if (_handlesNativeCalls) return;
+    _handlesNativeCalls = true;
+    methodChannel.setMethodCallHandler((call) async {
+      if (call.method != 'readVideoRange') {
+        throw MissingPluginException('No handler for ${call.method}');
+      }
+      final reader = _rangeReaders[call.arguments['readerId']];
+      if (reader == null) {
+        throw PlatformException(
+          code: 'ReaderNotFound',
+          message: 'The video reader was already released',
+        );
+      }
+      return reader.read(call.arguments['offset'], call.arguments['length']);
+    });
+  }
+
   @override
   Future<List<Uint8List>> createVideoThumbnails(
       CreateVideoThumbnail value) async {
-    var videoBytes = await value.video.safeByteArray();
+    final (response, _) = await _invokeWithVideo<List<dynamic>>(
+      'createVideoThumbnails',
+      value.video,
+      _thumbnailArgs(value),
+    );
+    // Raw thumbnails come with their size.
+    final List<Uint8List> thumbnails = response
+            ?.map((thumbnail) =>
+                thumbnail is Map ? thumbnail['bytes'] as Uint8List : thumbnail)
+            .cast<Uint8List>()
+            .toList() ??
+        [];
 
-    final response = await methodChannel.invokeMethod<List<dynamic>>(
+    return thumbnails;
+  }
+
+  @override
+  Future<List<RawThumbnail?>> createRawVideoThumbnails(
+    CreateVideoThumbnail value,
+  ) async {
+    final (response, _) = await _invokeWithVideo<List<dynamic>>(
       'createVideoThumbnails',
+      value.video,
       {
-        'videoBytes': videoBytes,
-        'timestamps': value.timestamps.map((el) => el.inMilliseconds).toList(),
-        'imageWidth': value.imageWidth,
-        'thumbnailFormat': value.format.name,
-        'extension': _getFileExtension(videoBytes),
+        ..._thumbnailArgs(value),
+        'thumbnailFormat': ThumbnailFormat.raw.name,
       },
     );
-    final List<Uint8List> thumbnails = response?.cast<Uint8List>() ?? [];
 
-    return thumbnails;
+    return response?.map((thumbnail) {
+          if (thumbnail is! Map) return null;
+          return RawThumbnail(
+            bytes: thumbnail['bytes'] as Uint8List,
+            width: thumbnail['width'] as int,
+            height: thumbnail['height'] as int,
+          );
+        }).toList() ??
+        [];
   }
 
   @override
-  Future<Uint8List> exportVideo(ExportVideoModel value) async {
-    var format = lookupMimeType('', headerBytes: value.videoBytes);
-    String inputFormat = 'mp4';
-    List<String>? sp = format?.split('/');
-    if (sp?.length == 1) inputFormat = sp![1];
+  Stream<IndexedThumbnail> createVideoThumbnailsStream(
+    CreateVideoThumbnail value,
+  ) {
+    if (kIsWeb || defaultTargetPlatform != TargetPlatform.linux) {
+      return super.createVideoThumbnailsStream(value);
+    }
+
+    final requestId = _nextThumbnailRequestId++;
+    late final StreamSubscription<dynamic> subscription;
+    final controller = StreamController<IndexedThumbnail>(
+      onCancel: () => subscription.cancel(),
+    );
+
+    // Listen before invoking, so no event can arrive unobserved. The native
+    // side responds after the last event of this request was sent.
+    subscription = _thumbnailChannel.receiveBroadcastStream().listen((event) {
+      if (event is! Map || event['requestId'] != requestId) return;
+      controller.add(IndexedThumbnail(
+        index: event['index'] as int,
+        bytes: event['bytes'] as Uint8List,
+        width: event['width'] as int?,
+        height: event['height'] as int?,
+      ));
+    });
+
+    () async {
+      try {
+        await _invokeWithVideo<void>(
+          'createVideoThumbnailsStream',
+          value.video,
+          {
+            ..._thumbnailArgs(value),
+            'requestId': requestId,
+          },
+        );
+      } catch (error, stackTrace) {
+        controller.addError(error, stackTrace);
+      }
+      await subscription.cancel();
+      await controller.close();
+    }();
+
+    return controller.stream;
+  }
 
-    final Uint8List? result = await methodChannel.invokeMethod<Uint8List>(
-      'exportVideo',
+  @override
+  Future<ThumbnailSpriteSheet> createThumbnailSpriteSheet(
+    CreateThumbnailSpriteSheet value,
+  ) async {
+    final (response, _) = await _invokeWithVideo<Map<dynamic, dynamic>>(
+      'createThumbnailSpriteSheet',
+      value.video,
       {
-        'codecArgs': value.encoding.toFFmpegArgs(
-          outputFormat: value.outputFormat,
-          enableAudio: value.enableAudio,
-        ),
-        'videoBytes': value.videoBytes,
-        'imageBytes': value.imageBytes,
-        'videoDuration': value.videoDuration.inMilliseconds,
-        'inputFormat': inputFormat,
-        'outputFormat': value.outputFormat.name,
-        'startTime': value.startTime?.inSeconds,
-        'endTime': value.endTime?.inSeconds,
-        'filters': value.complexFilter,
-        'colorMatrices': value.colorFilters,
+        ..._thumbnailArgs(value),
+        if (value.columns != null) 'columns': value.columns,
       },
     );
+    if (response == null) {
+      throw ArgumentError('Failed to create the sprite sheet');
+    }
+
+    return ThumbnailSpriteSheet.fromMap(response, value.format);
+  }
+
+  @override
+  Future<ThumbnailCacheStats> getThumbnailCacheStats() async {
+    final response = await methodChannel
+        .invokeMethod<Map<dynamic, dynamic>>('getThumbnailCacheStats');
+    return ThumbnailCacheStats.fromMap(response ?? {});
+  }
+
+  @override
+  Future<Uint8List> exportVideo(ExportVideoModel value) async {
+    final result = await _invokeExport<Uint8List>(value, {});
 
     if (result == null) {
       throw ArgumentError('Failed to export the video');
@@ -101,6 +392,74 @@ class MethodChannelProVideoEditor extends ProVideoEditorPlatform {
     return result;
   }
 
+  @override
+  Future<String> exportVideoToFile(
+    ExportVideoModel value,
+    String outputPath,
+  ) async {
+    // Only the Linux exporter can mux straight into the file.
+    if (!_isLinux) return super.exportVideoToFile(value, outputPath);
+
+    final result = await _invokeExport<String>(
+      value,
+      {'outputPath': outputPath},
+    );
+
+    if (result == null) {
+      throw ArgumentError('Failed to export the video');
+    }
+
+    return result;
+  }
+
+  Future<T?> _invokeExport<T>(
+    ExportVideoModel value,
+    Map<String, dynamic> outputArgs,
+  ) async {
+    var format = lookupMimeType('', headerBytes: value.videoBytes);
+    String inputFormat = 'mp4';
+    List<String>? sp = format?.split('/');
+    if (sp?.length == 1) inputFormat = sp![1];
+
+    final args = {
+      'codecArgs': value.encoding.toFFmpegArgs(
+        outputFormat: value.outputFormat,
+        enableAudio: value.enableAudio,
+      ),
+      'imageBytes': value.imageBytes,
+      'videoDuration': value.videoDuration.inMilliseconds,
+      'inputFormat': inputFormat,
+      'outputFormat': value.outputFormat.name,
+      'startTime': value.startTime?.inSeconds,
+      'endTime': value.endTime?.inSeconds,
+      'filters': value.complexFilter,
+      'colorMatrices': value.colorFilters,
+      'allowStreamCopy': value.allowStreamCopy,
+      'parallelSegments': value.parallelSegments,
+      ...outputArgs,
+    };
+    final videoArgs = {
+      'videoBytes': value.videoBytes,
+      'extension': _getFileExtension(value.videoBytes),
+    };
+
+    // Bytes of an opened video are already on the native side.
+    final session = _byteSessions[value.videoBytes];
+    try {
+      return await methodChannel.invokeMethod<T>(
+        'exportVideo',
+        {...args, ...session?.args ?? videoArgs},
+      );
+    } on PlatformException catch (e) {
+      if (session == null || e.code != 'SessionNotFound') rethrow;
+      _byteSessions[value.videoBytes] = null;
+      return await methodChannel.invokeMethod<T>(
+        'exportVideo',
+        {...args, ...videoArgs},
+      );
+    }
+  }
+
   @override
   Stream<double> get exportProgressStream {
     return _progressChannel
@@ -108,6 +467,78 @@ class MethodChannelProVideoEditor extends ProVideoEditorPlatform {
         .map((event) => event as double);
   }
 
+  Map<String, dynamic> _thumbnailArgs(CreateVideoThumbnail value) {
+    return {
+      'timestamps': value.timestamps.map((el) => el.inMilliseconds).toList(),
+      'imageWidth': value.imageWidth,
+      'thumbnailFormat': value.format.name,
+      'exactness': value.exactness.name,
+      if (value.maxConcurrency != null) 'maxConcurrency': value.maxConcurrency,
+      if (value.quality != null) 'quality': value.quality,
+    };
+  }
+
+  /// Invokes [method] with the arguments of [video] added to [args] and
+  /// returns the result together with the video arguments that were sent.
+  ///
+  /// Opened videos are referenced by their session. If the native side
+  /// evicted it, the session is dropped and the video is sent again.
+  Future<(T?, Map<String, dynamic>)> _invokeWithVideo<T>(
+    String method,
+    EditorVideo video, [
+    Map<String, dynamic> args = const {},
+  ]) async {
+    var videoArgs = await _videoArgs(video);
+    try {
+      final result =
+          await methodChannel.invokeMethod<T>(method, {...videoArgs, ...args});
+      return (result, videoArgs);
+    } on PlatformException catch (e) {
+      if (e.code != 'SessionNotFound') rethrow;
+      _forgetSession(video);
+      videoArgs = await _videoSourceArgs(video);
+      final result =
+          await methodChannel.invokeMethod<T>(method, {...videoArgs, ...args});
+      return (result, videoArgs);
+    }
+  }
+
+  void _forgetSession(EditorVideo video) {
+    final bytes = _sessions[video]?.bytes;
+    if (bytes != null) _byteSessions[bytes] = null;
+    _sessions[video] = null;
+  }
+
+  /// The session of [video] if it is open, its source otherwise.
+  Future<Map<String, dynamic>> _videoArgs(EditorVideo video) async {
+    return _sessions[video]?.args ?? await _videoSourceArgs(video);
+  }
+
+  /// Builds the arguments that describe the video of a method call.
+  ///
+  /// On Linux, local files are passed by `videoPath` so the native side can
+  /// read them directly instead of receiving a copy of the bytes.
+  Future<Map<String, dynamic>> _videoSourceArgs(EditorVideo video) async {
+    var path = video.localPath;
+    if (path != null && _isLinux) {
+      return {
+        'videoPath': path,
+        'extension': _getPathExtension(path),
+      };
+    }
+
+    var videoBytes = await video.safeByteArray();
+    return {
+      'videoBytes': videoBytes,
+      'extension': _getFileExtension(videoBytes),
+    };
+  }
+
+  String _getPathExtension(String path) {
+    var mimeSp = lookupMimeType(path)?.split('/') ?? [];
+    return mimeSp.length == 2 ? mimeSp[1] : 'mp4';
+  }
+
   String _getFileExtension(Uint8List videoBytes) {
     var mimeType = lookupMimeType('', headerBytes: videoBytes);
     var mimeSp = mimeType?.split('/') ?? [];
@@ -116,3 +547,16 @@ class MethodChannelProVideoEditor extends ProVideoEditorPlatform {
     return extension;
   }
 }
+
+/// A video opened on the native side.
+class _VideoSession {
+  _VideoSession({required this.id, required this.extension, this.bytes});
+
+  final int id;
+  final String extension;
+
+  /// The bytes the session was opened with, for in-memory videos.
+  final Uint8List? bytes;
+
+  Map<String, dynamic> get args => {'sessionId': id, 'extension': extension};
+}
@@ -2,10 +2,16 @@ import 'dart:typed_data';
 
 import 'package:plugin_platform_interface/plugin_platform_interface.dart';
 
+import '/core/models/thumbnail/create_thumbnail_sprite_sheet_model.dart';
 import '/core/models/thumbnail/create_video_thumbnail_model.dart';
+import '/core/models/thumbnail/indexed_thumbnail_model.dart';
+import '/core/models/thumbnail/raw_thumbnail_model.dart';
+import '/core/models/thumbnail/thumbnail_cache_stats_model.dart';
+import '/core/models/thumbnail/thumbnail_sprite_sheet_model.dart';
 import '/core/models/video/editor_video_model.dart';
 import '/core/models/video/export_video_model.dart';
 import '/core/models/video/video_information_model.dart';
+import '/core/platform/io/io_helper.dart';
 import 'pro_video_editor_method_channel.dart';
 
 /// An abstract class that defines the platform interface for the
@@ -38,13 +44,48 @@ abstract class ProVideoEditorPlatform extends PlatformInterface {
     throw UnimplementedError('platformVersion() has not been implemented.');
   }
 
+  /// Keeps [value] open on the native side until [closeVideo], so later
+  /// calls with the same [EditorVideo] skip sending, probing and opening
+  /// the decoder again.
+  ///
+  /// Platforms without native sessions ignore this.
+  Future<void> openVideo(EditorVideo value) async {}
+
+  /// Releases the resources [openVideo] holds for [value].
+  Future<void> closeVideo(EditorVideo value) async {}
+
   /// Fetches information about a video.
   ///
+  /// Platforms without a fast probe ignore [probeMode].
+  ///
   /// Throws an [UnimplementedError] if not implemented.
-  Future<VideoInformation> getVideoInformation(EditorVideo value) {
+  Future<VideoInformation> getVideoInformation(
+    EditorVideo value, {
+    VideoProbeMode probeMode = VideoProbeMode.fast,
+  }) {
     throw UnimplementedError('getVideoInformation() has not been implemented.');
   }
 
+  /// Fetches information about many videos, in the order of [values].
+  ///
+  /// Entries of videos that could not be read are `null`. Platforms without
+  /// a batch call read the videos one after another.
+  Future<List<VideoInformation?>> getVideoInformationBatch(
+    List<EditorVideo> values, {
+    VideoProbeMode probeMode = VideoProbeMode.fast,
+    int? maxConcurrency,
+  }) async {
+    final results = <VideoInformation?>[];
+    for (final value in values) {
+      try {
+        results.add(await getVideoInformation(value, probeMode: probeMode));
+      } catch (_) {
+        results.add(null);
+      }
+    }
+    return results;
+  }
+
   /// Generates thumbnails for a video.
   ///
   /// Throws an [UnimplementedError] if not implemented.
@@ -53,6 +94,49 @@ abstract class ProVideoEditorPlatform extends PlatformInterface {
         'createVideoThumbnails() has not been implemented.');
   }
 
+  /// Generates thumbnails for a video as raw RGBA pixels, ignoring
+  /// `value.format`. Failed thumbnails are `null`.
+  ///
+  /// Throws an [UnimplementedError] if not implemented.
+  Future<List<RawThumbnail?>> createRawVideoThumbnails(
+    CreateVideoThumbnail value,
+  ) {
+    throw UnimplementedError(
+        'createRawVideoThumbnails() has not been implemented.');
+  }
+
+  /// Generates thumbnails for a video and emits each one as soon as it is
+  /// ready, in order of completion.
+  ///
+  /// Platforms without native streaming emit all thumbnails once
+  /// [createVideoThumbnails] completes.
+  Stream<IndexedThumbnail> createVideoThumbnailsStream(
+    CreateVideoThumbnail value,
+  ) async* {
+    final thumbnails = await createVideoThumbnails(value);
+    for (var i = 0; i < thumbnails.length; i++) {
+      yield IndexedThumbnail(index: i, bytes: thumbnails[i]);
+    }
+  }
+
+  /// Generates thumbnails for a video and packs them into one image.
+  ///
+  /// Throws an [UnimplementedError] if not implemented.
+  Future<ThumbnailSpriteSheet> createThumbnailSpriteSheet(
+    CreateThumbnailSpriteSheet value,
+  ) {
+    throw UnimplementedError(
+        'createThumbnailSpriteSheet() has not been implemented.');
+  }
+
+  /// Returns the hit and miss counters of the native thumbnail cache.
+  ///
+  /// Throws an [UnimplementedError] if not implemented.
+  Future<ThumbnailCacheStats> getThumbnailCacheStats() {
+    throw UnimplementedError(
+        'getThumbnailCacheStats() has not been implemented.');
+  }
+
   /// Exports a video using the given [value] configuration.
   ///
   /// Delegates the export to the platform-specific implementation and returns
@@ -61,6 +145,21 @@ abstract class ProVideoEditorPlatform extends PlatformInterface {
     throw UnimplementedError('exportVideo() has not been implemented.');
   }
 
+  /// Exports a video using the given [value] configuration into the file at
+  /// [outputPath] and returns that path.
+  ///
+  /// Platforms that can write the result straight to the file override this,
+  /// so the video is never held in memory. The default exports into memory
+  /// with [exportVideo] and writes the bytes afterwards.
+  Future<String> exportVideoToFile(
+    ExportVideoModel value,
+    String outputPath,
+  ) async {
+    final bytes = await exportVideo(value);
+    await File(outputPath).writeAsBytes(bytes, flush: true);
+    return outputPath;
+  }
+
   /// A stream that emits export progress updates as a double from 0.0 to 1.0.
   ///
   /// Useful for showing progress indicators during the export process.
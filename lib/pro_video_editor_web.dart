@@ -36,7 +36,10 @@ class ProVideoEditorWeb extends ProVideoEditorPlatform {
   }
 
   @override
-  Future<VideoInformation> getVideoInformation(EditorVideo value) async {
+  Future<VideoInformation> getVideoInformation(
+    EditorVideo value, {
+    VideoProbeMode probeMode = VideoProbeMode.fast,
+  }) async {
     return _manager.getVideoInformation(value);
   }
 
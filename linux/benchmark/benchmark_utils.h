@@ -0,0 +1,88 @@
+// benchmark/benchmark_utils.h
+#pragma once
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace pro_video_editor {
+namespace benchmark {
+
+// Wall time and CPU time (user + system) of a measured block. CPU time
+// includes waited-for child processes, so subprocess based paths are
+// measured fairly against in-process ones.
+struct Measurement {
+    double wallMs = 0;
+    double cpuMs = 0;
+};
+
+inline double CpuTimeMs() {
+    auto toMs = [](const timeval& tv) { return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0; };
+    rusage self{};
+    rusage children{};
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    return toMs(self.ru_utime) + toMs(self.ru_stime) +
+           toMs(children.ru_utime) + toMs(children.ru_stime);
+}
+
+template <typename Fn>
+Measurement Measure(Fn&& fn) {
+    double cpuStart = CpuTimeMs();
+    auto wallStart = std::chrono::steady_clock::now();
+    fn();
+    Measurement m;
+    m.wallMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - wallStart).count();
+    m.cpuMs = CpuTimeMs() - cpuStart;
+    return m;
+}
+
+inline void PrintMeasurement(const std::string& label, const Measurement& m) {
+    std::printf("%-32s wall %10.1f ms   cpu %10.1f ms\n", label.c_str(), m.wallMs, m.cpuMs);
+}
+
+inline int64_t ReadDurationMs(const std::string& path) {
+    AVFormatContext* format_ctx = nullptr;
+    if (avformat_open_input(&format_ctx, path.c_str(), nullptr, nullptr) < 0) return 0;
+    int64_t duration = 0;
+    if (avformat_find_stream_info(format_ctx, nullptr) >= 0 && format_ctx->duration > 0) {
+        duration = format_ctx->duration / (AV_TIME_BASE / 1000);
+    }
+    avformat_close_input(&format_ctx);
+    return duration;
+}
+
+inline std::vector<uint8_t> ReadFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+inline size_t CountImages(const std::vector<std::vector<uint8_t>>& images) {
+    size_t count = 0;
+    for (const auto& image : images) count += image.empty() ? 0 : 1;
+    return count;
+}
+
+// |count| timestamps spread evenly over |durationMs|.
+inline std::vector<int64_t> SpreadTimestamps(int64_t durationMs, int count) {
+    std::vector<int64_t> timestampsMs;
+    for (int i = 0; i < count; ++i) {
+        timestampsMs.push_back(durationMs * i / count);
+    }
+    return timestampsMs;
+}
+
+}  // namespace benchmark
+}  // namespace pro_video_editor
@@ -0,0 +1,173 @@
+// Measures how decoding scales with the decoder threads and thread type.
+//
+// Usage: pro_video_editor_decoder_benchmark <video> [frames] [thumbnails]
+//
+// For 1, 2, 4, ... up to all cores, decodes the first |frames| frames
+// (default 300) sequentially, like an export does, and extracts
+// |thumbnails| thumbnails (default 20) spread over the video with one
+// ThumbnailEngine, once with slice and once with frame threads. Run it on
+// a 4K HEVC source to see where each thread type stops scaling, e.g.
+// $ ffmpeg -i in.mp4 -vf scale=3840:-2 -c:v libx265 hevc_4k.mp4
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_utils.h"
+#include "src/av_utils.h"
+#include "src/decoder_threading.h"
+#include "src/thumbnail_engine.h"
+
+using namespace pro_video_editor;
+using namespace pro_video_editor::benchmark;
+
+namespace {
+
+const char* ThreadTypeName(DecoderThreadType type) {
+    switch (type) {
+        case DecoderThreadType::Slice:
+            return "slice";
+        case DecoderThreadType::Frame:
+            return "frame";
+        case DecoderThreadType::FrameAndSlice:
+            return "frame+slice";
+    }
+    return "unknown";
+}
+
+// Decodes up to |maxFrames| frames from the start of the video.
+Measurement MeasureSequentialDecode(
+    const std::string& path,
+    const DecoderThreading& threading,
+    int maxFrames,
+    int* frames) {
+    *frames = 0;
+    return Measure([&]() {
+        AVFormatContext* format_ctx = nullptr;
+        if (avformat_open_input(&format_ctx, path.c_str(), nullptr, nullptr) < 0) return;
+        int streamIndex = avformat_find_stream_info(format_ctx, nullptr) >= 0
+            ? FindVideoStreamIndex(format_ctx)
+            : -1;
+        const AVCodec* codec = streamIndex >= 0
+            ? avcodec_find_decoder(format_ctx->streams[streamIndex]->codecpar->codec_id)
+            : nullptr;
+        AVCodecContext* codec_ctx = codec ? avcodec_alloc_context3(codec) : nullptr;
+        if (codec_ctx) ApplyDecoderThreading(codec_ctx, threading);
+        if (!codec_ctx ||
+            avcodec_parameters_to_context(codec_ctx, format_ctx->streams[streamIndex]->codecpar) < 0 ||
+            avcodec_open2(codec_ctx, codec, nullptr) < 0) {
+            avcodec_free_context(&codec_ctx);
+            avformat_close_input(&format_ctx);
+            return;
+        }
+
+        AVPacket* packet = av_packet_alloc();
+        AVFrame* frame = av_frame_alloc();
+        bool draining = false;
+        while (*frames < maxFrames) {
+            int ret = avcodec_receive_frame(codec_ctx, frame);
+            if (ret == 0) {
+                ++*frames;
+                continue;
+            }
+            if (ret != AVERROR(EAGAIN) || draining) break;
+
+            if (av_read_frame(format_ctx, packet) < 0) {
+                avcodec_send_packet(codec_ctx, nullptr);
+                draining = true;
+                continue;
+            }
+            if (packet->stream_index == streamIndex) avcodec_send_packet(codec_ctx, packet);
+            av_packet_unref(packet);
+        }
+
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+        avcodec_free_context(&codec_ctx);
+        avformat_close_input(&format_ctx);
+    });
+}
+
+Measurement MeasureThumbnails(
+    const MediaSource& source,
+    const DecoderThreading& threading,
+    const std::vector<int64_t>& timestampsMs,
+    size_t* images) {
+    *images = 0;
+    return Measure([&]() {
+        ThumbnailEngine engine;
+        if (!engine.Open(source, nullptr, threading)) return;
+        std::vector<uint8_t> image;
+        for (int64_t timestampMs : timestampsMs) {
+            image.clear();
+            if (engine.ExtractThumbnail(timestampMs, 320, "jpeg", &image)) ++*images;
+        }
+    });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <video> [frames] [thumbnails]\n", argv[0]);
+        return 1;
+    }
+    std::string videoPath = argv[1];
+    int maxFrames = argc > 2 ? std::atoi(argv[2]) : 300;
+    int thumbnailCount = argc > 3 ? std::atoi(argv[3]) : 20;
+
+    int64_t durationMs = ReadDurationMs(videoPath);
+    if (durationMs <= 0 || maxFrames <= 0 || thumbnailCount <= 0) {
+        std::fprintf(stderr, "Could not read the duration of %s\n", videoPath.c_str());
+        return 1;
+    }
+
+    MediaSource source;
+    source.path = videoPath;
+    std::vector<int64_t> timestampsMs = SpreadTimestamps(durationMs, thumbnailCount);
+
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    if (cores <= 0) cores = 1;
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < cores; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(cores);
+
+    std::printf("%s: %d frames, %d thumbnails, %d cores\n", videoPath.c_str(), maxFrames, thumbnailCount, cores);
+    std::printf("%-12s %8s %12s %9s %14s %9s\n", "type", "threads", "decode fps", "speedup", "ms/thumbnail", "speedup");
+
+    for (DecoderThreadType type : {DecoderThreadType::Slice, DecoderThreadType::Frame}) {
+        double baseFps = 0;
+        double baseThumbnailMs = 0;
+        for (int threads : threadCounts) {
+            DecoderThreading threading{threads, type};
+
+            int frames = 0;
+            Measurement decode = MeasureSequentialDecode(videoPath, threading, maxFrames, &frames);
+            double fps = decode.wallMs > 0 ? frames * 1000.0 / decode.wallMs : 0;
+
+            size_t images = 0;
+            Measurement thumbnails = MeasureThumbnails(source, threading, timestampsMs, &images);
+            double thumbnailMs = images > 0 ? thumbnails.wallMs / images : 0;
+
+            if (threads == 1) {
+                baseFps = fps;
+                baseThumbnailMs = thumbnailMs;
+            }
+            std::printf("%-12s %8d %12.1f %8.2fx %14.1f %8.2fx\n",
+                        ThreadTypeName(type), threads, fps, baseFps > 0 ? fps / baseFps : 0,
+                        thumbnailMs, thumbnailMs > 0 ? baseThumbnailMs / thumbnailMs : 0);
+        }
+    }
+
+    DecoderThreadingPolicy policy = GetDecoderThreadingPolicy();
+    std::printf("policy: thumbnails %s, export %s\n",
+                ThreadTypeName(policy.thumbnails.threadType), ThreadTypeName(policy.exportVideo.threadType));
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Measures the cost of encoding one thumbnail, without any decoding.
+//
+// Usage: pro_video_editor_encode_benchmark [width] [iterations]
+//
+// A synthetic 1080p YUV420P frame (what most decoders produce) is scaled to
+// |width| pixels (default 320) and encoded as jpeg and webp, once with a
+// warm ImageEncoder reused for every frame, like a ThumbnailEngine does,
+// and once with a new encoder per frame. The target is below 1 ms per frame
+// for the warm encoder.
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "benchmark_utils.h"
+#include "src/image_encoder.h"
+
+using namespace pro_video_editor;
+using namespace pro_video_editor::benchmark;
+
+namespace {
+
+constexpr double kTargetMsPerFrame = 1.0;
+
+// A gradient with some detail, so the encoder has real work to do.
+AVFrame* CreateSourceFrame(int width, int height) {
+    AVFrame* frame = av_frame_alloc();
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = width;
+    frame->height = height;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        av_frame_free(&frame);
+        return nullptr;
+    }
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            frame->data[0][y * frame->linesize[0] + x] = static_cast<uint8_t>((x + y) ^ (x * y >> 6));
+        }
+    }
+    for (int plane = 1; plane < 3; ++plane) {
+        for (int y = 0; y < height / 2; ++y) {
+            for (int x = 0; x < width / 2; ++x) {
+                frame->data[plane][y * frame->linesize[plane] + x] = static_cast<uint8_t>(plane * 60 + x / 4);
+            }
+        }
+    }
+    return frame;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 320;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 500;
+    if (width <= 0 || iterations <= 0) {
+        std::fprintf(stderr, "Usage: %s [width] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    AVFrame* source = CreateSourceFrame(1920, 1080);
+    if (!source) return 1;
+    int height = width * 1080 / 1920 / 2 * 2;
+    std::printf("1920x1080 yuv420p -> %dx%d, %d frames\n", width, height, iterations);
+
+    bool allBelowTarget = true;
+    for (const std::string format : {"jpeg", "webp"}) {
+        if (!ImageEncoder::Supports(format)) {
+            std::printf("%s: no encoder in this FFmpeg build\n", format.c_str());
+            continue;
+        }
+
+        ImageEncoder warmEncoder;
+        std::vector<uint8_t> image;
+        warmEncoder.EncodeFrame(source, width, height, format, 80, &image);
+        Measurement warm = Measure([&]() {
+            for (int i = 0; i < iterations; ++i) {
+                warmEncoder.EncodeFrame(source, width, height, format, 80, &image);
+            }
+        });
+
+        Measurement fresh = Measure([&]() {
+            for (int i = 0; i < iterations; ++i) {
+                ImageEncoder encoder;
+                encoder.EncodeFrame(source, width, height, format, 80, &image);
+            }
+        });
+
+        double warmMs = warm.wallMs / iterations;
+        PrintMeasurement(format + " reused encoder", warm);
+        PrintMeasurement(format + " encoder per frame", fresh);
+        std::printf("%s: %.3f ms/frame reused, %.3f ms/frame fresh, %zu bytes -> %s\n",
+                    format.c_str(), warmMs, fresh.wallMs / iterations, image.size(),
+                    warmMs < kTargetMsPerFrame ? "below 1 ms" : "ABOVE 1 ms");
+        allBelowTarget = allBelowTarget && warmMs < kTargetMsPerFrame;
+    }
+
+    av_frame_free(&source);
+    return allBelowTarget ? 0 : 2;
+}
@@ -0,0 +1,99 @@
+// Measures how an export scales when it is split into parallel segments.
+//
+// Usage: pro_video_editor_export_benchmark <video> [codec args...]
+//
+// Exports the whole video once in a single pass and once with 2, 4, ... up
+// to all cores parallel segments, each to an unnamed scratch file, and
+// prints the wall and CPU time, the output size and the speedup over the
+// single pass. The codec args default to `-c:v libx264 -preset medium -crf
+// 23`; stream copy is turned off so every run encodes. Run it on a long
+// source with the keyframes of a typical camera or editor, e.g. 10 minutes
+// of 1080p:
+// $ ffmpeg -f lavfi -i testsrc2=size=1920x1080:rate=30 -f lavfi -i sine -t 600 -g 60 src.mp4
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "benchmark_utils.h"
+#include "src/export_video.h"
+#include "src/scratch_storage.h"
+
+using namespace pro_video_editor;
+using namespace pro_video_editor::benchmark;
+
+namespace {
+
+// Exports |options| to a new scratch file. |size| is the size of the
+// output in bytes, or 0 if the export failed.
+Measurement MeasureExport(ExportVideoOptions options, int segments, off_t* size) {
+    *size = 0;
+    std::string error;
+    std::unique_ptr<ScratchFile> file = ScratchFile::Create("export-benchmark", &error);
+    if (!file) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return Measurement();
+    }
+    options.outputFd = file->fd();
+    options.parallelSegments = segments;
+
+    bool ok = false;
+    Measurement m = Measure([&]() { ok = ExportVideo(options, nullptr, nullptr, &error); });
+    if (!ok) {
+        std::fprintf(stderr, "%d segments: %s\n", segments, error.c_str());
+        return m;
+    }
+    struct stat info;
+    if (fstat(file->fd(), &info) == 0) *size = info.st_size;
+    return m;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <video> [codec args...]\n", argv[0]);
+        return 1;
+    }
+    std::string videoPath = argv[1];
+    int64_t durationMs = ReadDurationMs(videoPath);
+    if (durationMs <= 0) {
+        std::fprintf(stderr, "Could not read the duration of %s\n", videoPath.c_str());
+        return 1;
+    }
+
+    ExportVideoOptions options;
+    options.source.path = videoPath;
+    options.videoDurationMs = durationMs;
+    options.allowStreamCopy = false;
+    if (argc > 2) {
+        options.codecArgs.assign(argv + 2, argv + argc);
+    } else {
+        options.codecArgs = {"-c:v", "libx264", "-preset", "medium", "-crf", "23"};
+    }
+
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    if (cores <= 0) cores = 1;
+    std::vector<int> segmentCounts;
+    for (int segments = 1; segments < cores; segments *= 2) segmentCounts.push_back(segments);
+    segmentCounts.push_back(cores);
+
+    std::printf("%s: %.1f s, %d cores\n", videoPath.c_str(), durationMs / 1000.0, cores);
+    std::printf("%-9s %12s %12s %9s %12s %9s\n", "segments", "wall ms", "cpu ms", "realtime", "size KB", "speedup");
+
+    double baseMs = 0;
+    for (int segments : segmentCounts) {
+        off_t size = 0;
+        Measurement m = MeasureExport(options, segments, &size);
+        if (size == 0) continue;
+        if (segments == 1) baseMs = m.wallMs;
+        std::printf("%-9d %12.1f %12.1f %8.2fx %12.1f %8.2fx\n",
+                    segments, m.wallMs, m.cpuMs, m.wallMs > 0 ? durationMs / m.wallMs : 0,
+                    size / 1024.0, baseMs > 0 && m.wallMs > 0 ? baseMs / m.wallMs : 0);
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Compares exact and nearest-keyframe thumbnails on a real video file.
+//
+// Usage: pro_video_editor_keyframe_benchmark <video> [count] [width] [format]
+//
+// Extracts |count| thumbnails (default 30) spread evenly over the video, once
+// per ThumbnailExactness, each with a single seek per timestamp so only the
+// decoding cost differs. Run it on long-GOP sources to see the difference,
+// e.g. H.264 and HEVC encoded with a 10 s keyframe interval:
+// $ ffmpeg -i in.mp4 -c:v libx264 -g 300 h264.mp4
+// $ ffmpeg -i in.mp4 -c:v libx265 -x265-params keyint=300 hevc.mp4
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "benchmark_utils.h"
+#include "src/av_utils.h"
+#include "src/thumbnail_engine.h"
+
+using namespace pro_video_editor;
+using namespace pro_video_editor::benchmark;
+
+namespace {
+
+std::string ReadVideoCodecName(const std::string& path) {
+    AVFormatContext* format_ctx = nullptr;
+    if (avformat_open_input(&format_ctx, path.c_str(), nullptr, nullptr) < 0) return "unknown";
+    std::string name = "unknown";
+    if (avformat_find_stream_info(format_ctx, nullptr) >= 0) {
+        int index = FindVideoStreamIndex(format_ctx);
+        if (index >= 0) name = avcodec_get_name(format_ctx->streams[index]->codecpar->codec_id);
+    }
+    avformat_close_input(&format_ctx);
+    return name;
+}
+
+Measurement MeasureExactness(
+    const MediaSource& source,
+    const std::vector<int64_t>& timestampsMs,
+    int width,
+    const std::string& format,
+    ThumbnailExactness exactness,
+    size_t* images) {
+    *images = 0;
+    return Measure([&]() {
+        ThumbnailEngine engine;
+        if (!engine.Open(source, nullptr)) return;
+        std::vector<uint8_t> image;
+        for (int64_t timestampMs : timestampsMs) {
+            image.clear();
+            if (engine.ExtractThumbnail(timestampMs, width, format, &image, exactness)) ++*images;
+        }
+    });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <video> [count] [width] [format]\n", argv[0]);
+        return 1;
+    }
+    std::string videoPath = argv[1];
+    int count = argc > 2 ? std::atoi(argv[2]) : 30;
+    int width = argc > 3 ? std::atoi(argv[3]) : 160;
+    std::string format = argc > 4 ? argv[4] : "jpeg";
+
+    int64_t durationMs = ReadDurationMs(videoPath);
+    if (durationMs <= 0 || count <= 0) {
+        std::fprintf(stderr, "Could not read the duration of %s\n", videoPath.c_str());
+        return 1;
+    }
+
+    std::vector<int64_t> timestampsMs = SpreadTimestamps(durationMs, count);
+    std::printf("%s (%s): %d thumbnails, %d px, %s\n",
+                videoPath.c_str(), ReadVideoCodecName(videoPath).c_str(), count, width, format.c_str());
+
+    MediaSource source;
+    source.path = videoPath;
+
+    size_t exactImages = 0;
+    size_t keyframeImages = 0;
+    Measurement exact = MeasureExactness(source, timestampsMs, width, format, ThumbnailExactness::Exact, &exactImages);
+    PrintMeasurement("exact", exact);
+    Measurement keyframe = MeasureExactness(source, timestampsMs, width, format, ThumbnailExactness::NearestKeyframe, &keyframeImages);
+    PrintMeasurement("nearest keyframe", keyframe);
+
+    std::printf("images: exact %zu/%d, keyframe %zu/%d\n", exactImages, count, keyframeImages, count);
+    std::printf("per thumbnail: exact %.1f ms, keyframe %.1f ms (%.2fx)\n",
+                exact.wallMs / count, keyframe.wallMs / count, exact.wallMs / keyframe.wallMs);
+    return 0;
+}
@@ -0,0 +1,169 @@
+// Compares the latency of full and fast metadata probes.
+//
+// Usage: pro_video_editor_probe_benchmark [--iterations N] [--reader] <video>...
+//
+// Opens every video |N| times (default 20) per MediaProbe and prints the
+// average time to open it, the bytes the demuxer read, the metadata each
+// probe found and whether the fast probe had to fall back to a full
+// analysis. With --reader the files are read through a RangeReader, like
+// videos read from Dart on demand, which also counts the reads. Pass a
+// 1 GB+ file to see that a probe only reads the headers. Pass a corpus of
+// containers to cover both header kinds, e.g.
+// $ ffmpeg -i in.mp4 -c copy in.mov
+// $ ffmpeg -i in.mp4 -c copy in.mkv
+// $ ffmpeg -i in.mp4 -c:v libvpx-vp9 -c:a libopus in.webm
+// $ ffmpeg -i in.mp4 -c copy -movflags +faststart faststart.mp4
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark_utils.h"
+#include "src/av_utils.h"
+#include "src/media_input.h"
+
+using namespace pro_video_editor;
+using namespace pro_video_editor::benchmark;
+
+namespace {
+
+struct ProbeResult {
+    Measurement time;
+    uint64_t bytesRead = 0;
+    uint64_t reads = 0;
+    int width = 0;
+    int height = 0;
+    int64_t durationMs = 0;
+    bool fellBack = false;
+    bool ok = false;
+};
+
+// Reads |path| with pread on every call, counting the calls.
+MediaSource CreateReaderSource(const std::string& path, int fd, uint64_t* reads) {
+    struct stat st{};
+    fstat(fd, &st);
+    MediaSource source;
+    source.extension = path.substr(path.find_last_of('.') == std::string::npos ? path.size() : path.find_last_of('.'));
+    source.size = static_cast<size_t>(st.st_size);
+    source.read = [fd, reads](int64_t offset, uint8_t* buffer, size_t size) -> int64_t {
+        ++*reads;
+        return pread(fd, buffer, size, static_cast<off_t>(offset));
+    };
+    return source;
+}
+
+ProbeResult MeasureProbe(const MediaSource& source, MediaProbe probe, int iterations, uint64_t* reads = nullptr) {
+    ProbeResult result;
+    uint64_t readsBefore = reads ? *reads : 0;
+    result.time = Measure([&]() {
+        for (int i = 0; i < iterations; ++i) {
+            std::unique_ptr<MediaInput> input = MediaInput::Open(source, nullptr, probe);
+            if (!input) return;
+            if (i > 0) continue;
+
+            result.bytesRead = input->bytes_read();
+            if (reads) result.reads = *reads - readsBefore;
+
+            AVFormatContext* format_ctx = input->format_context();
+            int index = FindVideoStreamIndex(format_ctx);
+            if (index < 0) return;
+            const AVStream* stream = format_ctx->streams[index];
+            result.width = stream->codecpar->width;
+            result.height = stream->codecpar->height;
+            result.durationMs = format_ctx->duration > 0
+                ? format_ctx->duration / (AV_TIME_BASE / 1000)
+                : static_cast<int64_t>(stream->duration * av_q2d(stream->time_base) * 1000);
+            result.fellBack = probe == MediaProbe::Fast && input->probe() == MediaProbe::Full;
+            result.ok = true;
+        }
+    });
+    result.time.wallMs /= iterations;
+    result.time.cpuMs /= iterations;
+    return result;
+}
+
+double ReadFileSize(const std::string& path) {
+    struct stat st{};
+    return stat(path.c_str(), &st) == 0 ? static_cast<double>(st.st_size) : 0;
+}
+
+void PrintResult(const char* label, const ProbeResult& result) {
+    if (!result.ok) {
+        std::printf("  %-5s failed\n", label);
+        return;
+    }
+    std::printf("  %-5s %8.2f ms %10.1f KB read", label, result.time.wallMs, result.bytesRead / 1024.0);
+    if (result.reads > 0) std::printf(" in %llu reads", static_cast<unsigned long long>(result.reads));
+    std::printf("   %dx%d, %lld ms%s\n", result.width, result.height,
+                static_cast<long long>(result.durationMs), result.fellBack ? "   (fell back to full)" : "");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int iterations = 20;
+    bool useReader = false;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--reader") == 0) {
+            useReader = true;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty() || iterations <= 0) {
+        std::fprintf(stderr, "Usage: %s [--iterations N] [--reader] <video>...\n", argv[0]);
+        return 1;
+    }
+
+    double fullTotal = 0;
+    double fastTotal = 0;
+    for (const std::string& path : paths) {
+        MediaSource source;
+        source.path = path;
+        int fd = -1;
+        uint64_t reads = 0;
+        if (useReader) {
+            fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                std::printf("%s: could not open\n", path.c_str());
+                continue;
+            }
+            source = CreateReaderSource(path, fd, &reads);
+        }
+
+        // Warm the page cache, so both probes read from memory.
+        MeasureProbe(source, MediaProbe::Full, 1);
+
+        std::printf("%s (%.1f MB)\n", path.c_str(), ReadFileSize(path) / (1024.0 * 1024.0));
+        ProbeResult full = MeasureProbe(source, MediaProbe::Full, iterations, useReader ? &reads : nullptr);
+        ProbeResult fast = MeasureProbe(source, MediaProbe::Fast, iterations, useReader ? &reads : nullptr);
+        if (fd >= 0) close(fd);
+        PrintResult("full", full);
+        PrintResult("fast", fast);
+        if (full.ok && fast.ok) {
+            std::printf("  speedup %.1fx%s\n", full.time.wallMs / fast.time.wallMs,
+                        full.width == fast.width && full.height == fast.height ? "" : "   (size differs)");
+            fullTotal += full.time.wallMs;
+            fastTotal += fast.time.wallMs;
+        }
+    }
+
+    if (fastTotal > 0) {
+        std::printf("total: full %.2f ms, fast %.2f ms per pass (%.1fx)\n", fullTotal, fastTotal, fullTotal / fastTotal);
+    }
+    return 0;
+}
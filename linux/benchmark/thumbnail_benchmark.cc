@@ -0,0 +1,131 @@
+// Compares thumbnail generation paths on a real video file.
+//
+// Usage: pro_video_editor_thumbnail_benchmark <video> [count] [width] [format]
+//
+// Extracts |count| thumbnails (default 60) spread evenly over the video, once
+// with the in-process ThumbnailEngine and once with one ffmpeg subprocess per
+// timestamp (run concurrently, like the previous handler), and prints wall
+// and CPU time for both. The engine is measured in strip mode and with one
+// seek per timestamp; use a high count to see the effect of dense strips.
+// Streaming is measured by the time until the first thumbnail is delivered.
+// Raw RGBA output is compared per frame against |format|; it skips the image
+// encoder here and the image decoder in Flutter, which is not measured.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "benchmark_utils.h"
+#include "src/ffmpeg_cli_thumbnailer.h"
+#include "src/thread_pool.h"
+#include "src/thumbnail_engine.h"
+
+using namespace pro_video_editor;
+using namespace pro_video_editor::benchmark;
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <video> [count] [width] [format]\n", argv[0]);
+        return 1;
+    }
+    std::string videoPath = argv[1];
+    int count = argc > 2 ? std::atoi(argv[2]) : 60;
+    int width = argc > 3 ? std::atoi(argv[3]) : 160;
+    std::string format = argc > 4 ? argv[4] : "jpeg";
+
+    int64_t durationMs = ReadDurationMs(videoPath);
+    if (durationMs <= 0 || count <= 0) {
+        std::fprintf(stderr, "Could not read the duration of %s\n", videoPath.c_str());
+        return 1;
+    }
+
+    std::vector<int64_t> timestampsMs = SpreadTimestamps(durationMs, count);
+    std::printf("%s: %d thumbnails, %d px, %s\n", videoPath.c_str(), count, width, format.c_str());
+
+    // The handler receives the video as bytes, so the engine demuxes from
+    // memory here as well.
+    std::vector<uint8_t> videoBytes = ReadFile(videoPath);
+    MediaSource source;
+    source.data = videoBytes.data();
+    source.size = videoBytes.size();
+    source.extension = std::filesystem::path(videoPath).extension().string();
+
+    std::vector<std::vector<uint8_t>> inProcess;
+    Measurement engine = Measure([&]() {
+        inProcess = GenerateThumbnailsInProcess(source, timestampsMs, width, format);
+    });
+    PrintMeasurement("in-process engine (bytes)", engine);
+    std::printf("decoders: up to %zu\n", ThreadPool::Shared().size());
+
+    MediaSource pathSource;
+    pathSource.path = videoPath;
+    Measurement mapped = Measure([&]() {
+        GenerateThumbnailsInProcess(pathSource, timestampsMs, width, format, ThumbnailExactness::Exact, 1);
+    });
+    PrintMeasurement("single decoder (path)", mapped);
+
+    // Time to first thumbnail when images are streamed as they complete.
+    auto streamStart = std::chrono::steady_clock::now();
+    std::atomic<bool> gotFirst{false};
+    double firstMs = 0;
+    Measurement streamed = Measure([&]() {
+        GenerateThumbnailsInProcess(
+            pathSource, timestampsMs, width, format, ThumbnailExactness::Exact, 0,
+            [&](size_t, const std::vector<uint8_t>&) {
+                if (!gotFirst.exchange(true)) {
+                    firstMs = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - streamStart).count();
+                }
+            });
+    });
+    PrintMeasurement("streamed (path)", streamed);
+    std::printf("time to first thumbnail: streamed %.1f ms, batched %.1f ms\n", firstMs, streamed.wallMs);
+
+    std::vector<std::vector<uint8_t>> rawFrames;
+    Measurement raw = Measure([&]() {
+        rawFrames = GenerateThumbnailsInProcess(
+            pathSource, timestampsMs, width, kRawThumbnailFormat, ThumbnailExactness::Exact, 1);
+    });
+    PrintMeasurement("raw rgba, single decoder (path)", raw);
+    size_t rawBytes = 0;
+    for (const auto& frame : rawFrames) rawBytes += frame.size();
+    std::printf("per frame: %s %.2f ms, raw %.2f ms (%.1f KB)\n",
+                format.c_str(), mapped.wallMs / count, raw.wallMs / count,
+                rawBytes / 1024.0 / std::max<size_t>(1, CountImages(rawFrames)));
+
+    Measurement seeking = Measure([&]() {
+        ThumbnailEngine seekEngine;
+        if (!seekEngine.Open(pathSource, nullptr)) return;
+        std::vector<uint8_t> image;
+        for (int64_t timestampMs : timestampsMs) {
+            seekEngine.ExtractThumbnail(timestampMs, width, format, &image);
+        }
+    });
+    PrintMeasurement("seek per timestamp (path)", seeking);
+    std::printf("strip mode speedup: wall %.2fx\n", seeking.wallMs / mapped.wallMs);
+
+    std::vector<std::vector<uint8_t>> subprocess(timestampsMs.size());
+    Measurement cli = Measure([&]() {
+        // Mirrors the previous handler: one std::async job per timestamp.
+        std::vector<std::future<void>> futures;
+        for (size_t i = 0; i < timestampsMs.size(); ++i) {
+            futures.push_back(std::async(std::launch::async, [&, i]() {
+                ExtractThumbnailWithFFmpegCli(FFmpegCliInput{videoPath}, timestampsMs[i], width, "." + format, &subprocess[i]);
+            }));
+        }
+        for (auto& fut : futures) fut.get();
+    });
+    PrintMeasurement("ffmpeg subprocess per timestamp", cli);
+
+    std::printf("images: engine %zu/%d, subprocess %zu/%d\n",
+                CountImages(inProcess), count, CountImages(subprocess), count);
+    std::printf("speedup: wall %.2fx, cpu %.2fx\n",
+                cli.wallMs / engine.wallMs, cli.cpuMs / engine.cpuMs);
+    return 0;
+}
@@ -4,13 +4,23 @@
 #include <gtk/gtk.h>
 #include <sys/utsname.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <functional>
+#include <future>
 #include <memory>
 #include <iostream>
+#include <optional>
+#include <vector>
 
 #include "pro_video_editor_plugin_private.h"
-#include "src/video_processor.h"
+#include "src/method_args.h"
+#include "src/thread_pool.h"
 #include "src/thumbnail_generator.h"
+#include "src/video_exporter.h"
+#include "src/video_processor.h"
+#include "src/video_session.h"
 
 #define PRO_VIDEO_EDITOR_PLUGIN(obj) \
   (G_TYPE_CHECK_INSTANCE_CAST((obj), pro_video_editor_plugin_get_type(), \
@@ -18,6 +28,17 @@
 
 struct _ProVideoEditorPlugin {
   GObject parent_instance;
+
+  // Asks Dart for ranges of videos read on demand.
+  FlMethodChannel* method_channel;
+
+  // Sends export progress to Dart while a listener is attached.
+  FlEventChannel* progress_channel;
+  gboolean progress_listening;
+
+  // Sends streamed thumbnails to Dart while a listener is attached.
+  FlEventChannel* thumbnail_channel;
+  gboolean thumbnail_listening;
 };
 
 G_DEFINE_TYPE(ProVideoEditorPlugin, pro_video_editor_plugin, g_object_get_type())
@@ -28,6 +49,10 @@ static void pro_video_editor_plugin_handle_method_call(
     FlMethodCall* method_call);
 
 static void pro_video_editor_plugin_dispose(GObject* object) {
+  ProVideoEditorPlugin* self = PRO_VIDEO_EDITOR_PLUGIN(object);
+  g_clear_object(&self->method_channel);
+  g_clear_object(&self->progress_channel);
+  g_clear_object(&self->thumbnail_channel);
   G_OBJECT_CLASS(pro_video_editor_plugin_parent_class)->dispose(object);
 }
 
@@ -37,6 +62,186 @@ static void pro_video_editor_plugin_class_init(ProVideoEditorPluginClass* klass)
 
 static void pro_video_editor_plugin_init(ProVideoEditorPlugin* self) {}
 
+// Runs method handlers off the GTK main loop. Thumbnail handlers wait on
+// the shared ThreadPool, so they get their own threads here to avoid
+// blocking the pool they wait on.
+static pro_video_editor::ThreadPool& method_executor() {
+  static pro_video_editor::ThreadPool executor(4);
+  return executor;
+}
+
+// Calls with a Dart range reader block their thread on the main loop for
+// every read, for up to kRangeReadTimeout each. They get their own threads
+// so slow readers never hold up the other method calls.
+static pro_video_editor::ThreadPool& range_reader_executor() {
+  static pro_video_editor::ThreadPool executor(2);
+  return executor;
+}
+
+// Exports and thumbnail streams run for as long as the video takes to
+// decode. They get their own threads so they never occupy all of
+// method_executor() and short calls like getVideoInformation stay quick.
+static pro_video_editor::ThreadPool& long_task_executor() {
+  static pro_video_editor::ThreadPool executor(2);
+  return executor;
+}
+
+// The result of background work, delivered on the main thread.
+struct PendingCompletion {
+  std::function<void(FlMethodResponse*)> on_done;
+  FlMethodResponse* response;
+};
+
+static gboolean completion_cb(gpointer user_data) {
+  PendingCompletion* pending = static_cast<PendingCompletion*>(user_data);
+  pending->on_done(pending->response);
+  g_clear_object(&pending->response);
+  delete pending;
+  return G_SOURCE_REMOVE;
+}
+
+static void run_on_executor(pro_video_editor::ThreadPool& executor,
+                            std::function<FlMethodResponse*()> work,
+                            std::function<void(FlMethodResponse*)> on_done) {
+  executor.Submit([work = std::move(work),
+                   on_done = std::move(on_done)]() mutable {
+    // Flutter's messenger may only be used on the main thread, so the
+    // response is posted to the main context.
+    PendingCompletion* pending =
+        new PendingCompletion{std::move(on_done), work()};
+    g_main_context_invoke(nullptr, completion_cb, pending);
+  });
+}
+
+void run_on_background_thread(std::function<FlMethodResponse*()> work,
+                              std::function<void(FlMethodResponse*)> on_done) {
+  run_on_executor(method_executor(), std::move(work), std::move(on_done));
+}
+
+// An event produced on a worker thread.
+typedef struct {
+  ProVideoEditorPlugin* plugin;
+  FlEventChannel* channel;
+  FlValue* value;
+} PendingEvent;
+
+static gboolean* get_listening_flag(ProVideoEditorPlugin* self,
+                                    FlEventChannel* channel) {
+  if (channel == self->progress_channel) return &self->progress_listening;
+  if (channel == self->thumbnail_channel) return &self->thumbnail_listening;
+  return nullptr;
+}
+
+static gboolean send_event_cb(gpointer user_data) {
+  PendingEvent* pending = static_cast<PendingEvent*>(user_data);
+  gboolean* listening = get_listening_flag(pending->plugin, pending->channel);
+  if (listening != nullptr && *listening) {
+    fl_event_channel_send(pending->channel, pending->value, nullptr, nullptr);
+  }
+  g_object_unref(pending->plugin);
+  fl_value_unref(pending->value);
+  g_free(pending);
+  return G_SOURCE_REMOVE;
+}
+
+// Events are posted in order, so they reach Dart before the response of
+// the method call that produced them. Takes ownership of |value|: FlValue
+// reference counts are not atomic, so the worker must neither keep nor
+// release a reference that the main thread releases concurrently.
+static void send_event_on_main_thread(ProVideoEditorPlugin* self,
+                                      FlEventChannel* channel,
+                                      FlValue* value) {
+  PendingEvent* pending = g_new0(PendingEvent, 1);
+  pending->plugin = PRO_VIDEO_EDITOR_PLUGIN(g_object_ref(self));
+  pending->channel = channel;
+  pending->value = value;
+  g_main_context_invoke(nullptr, send_event_cb, pending);
+}
+
+static FlMethodErrorResponse* event_listen_cb(FlEventChannel* channel,
+                                              FlValue* args,
+                                              gpointer user_data) {
+  gboolean* listening =
+      get_listening_flag(PRO_VIDEO_EDITOR_PLUGIN(user_data), channel);
+  if (listening != nullptr) *listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* event_cancel_cb(FlEventChannel* channel,
+                                              FlValue* args,
+                                              gpointer user_data) {
+  gboolean* listening =
+      get_listening_flag(PRO_VIDEO_EDITOR_PLUGIN(user_data), channel);
+  if (listening != nullptr) *listening = FALSE;
+  return nullptr;
+}
+
+// A range of a Dart-side video requested by a worker thread.
+struct PendingRangeRead {
+  ProVideoEditorPlugin* plugin;
+  int64_t reader_id;
+  int64_t offset;
+  int64_t length;
+  std::promise<std::optional<std::vector<uint8_t>>> result;
+};
+
+// Gives up on Dart readers that never answer, e.g. a stalled download.
+constexpr std::chrono::seconds kRangeReadTimeout(60);
+
+static void range_read_response_cb(GObject* object, GAsyncResult* result,
+                                   gpointer user_data) {
+  PendingRangeRead* pending = static_cast<PendingRangeRead*>(user_data);
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(FlMethodResponse) response = fl_method_channel_invoke_method_finish(
+      FL_METHOD_CHANNEL(object), result, &error);
+  FlValue* value =
+      response ? fl_method_response_get_result(response, &error) : nullptr;
+
+  std::optional<std::vector<uint8_t>> bytes;
+  if (value != nullptr && fl_value_get_type(value) == FL_VALUE_TYPE_UINT8_LIST) {
+    const uint8_t* data = fl_value_get_uint8_list(value);
+    bytes.emplace(data, data + fl_value_get_length(value));
+  }
+  pending->result.set_value(std::move(bytes));
+  g_object_unref(pending->plugin);
+  delete pending;
+}
+
+static gboolean invoke_range_read_cb(gpointer user_data) {
+  PendingRangeRead* pending = static_cast<PendingRangeRead*>(user_data);
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "readerId", fl_value_new_int(pending->reader_id));
+  fl_value_set_string_take(args, "offset", fl_value_new_int(pending->offset));
+  fl_value_set_string_take(args, "length", fl_value_new_int(pending->length));
+  fl_method_channel_invoke_method(pending->plugin->method_channel,
+                                  "readVideoRange", args, nullptr,
+                                  range_read_response_cb, pending);
+  return G_SOURCE_REMOVE;
+}
+
+// Reads a range of a Dart-side video. Method channels may only be used on
+// the main thread, so the request is posted there while the calling worker
+// waits for the answer.
+static int64_t read_range_from_dart(ProVideoEditorPlugin* self,
+                                    int64_t reader_id, int64_t offset,
+                                    uint8_t* buffer, size_t size) {
+  PendingRangeRead* pending = new PendingRangeRead{
+      PRO_VIDEO_EDITOR_PLUGIN(g_object_ref(self)), reader_id, offset,
+      static_cast<int64_t>(size), {}};
+  std::future<std::optional<std::vector<uint8_t>>> result =
+      pending->result.get_future();
+  g_main_context_invoke(nullptr, invoke_range_read_cb, pending);
+
+  if (result.wait_for(kRangeReadTimeout) != std::future_status::ready) {
+    return -1;
+  }
+  std::optional<std::vector<uint8_t>> bytes = result.get();
+  if (!bytes) return -1;
+  size_t count = std::min(size, bytes->size());
+  std::memcpy(buffer, bytes->data(), count);
+  return static_cast<int64_t>(count);
+}
+
 static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
                            gpointer user_data) {
   ProVideoEditorPlugin* plugin = PRO_VIDEO_EDITOR_PLUGIN(user_data);
@@ -51,91 +256,123 @@ FlMethodResponse* get_platform_version() {
   return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
 }
 
-// Utility to convert FlValue* to EncodableValue
-flutter::EncodableValue ConvertFlValueToEncodable(FlValue* value);
+using MethodHandler =
+    std::function<FlMethodResponse*(const pro_video_editor::MethodArgs&)>;
 
-// Utility to convert EncodableValue to FlValue*
-FlValue* ConvertEncodableToFlValue(const flutter::EncodableValue& value);
+// Runs |handler| on |executor| and responds on the main thread. The
+// handler reads the arguments in place; `videoBytes` stays in the FlValue
+// the engine decoded it into.
+static void dispatch_method_call(
+    ProVideoEditorPlugin* self,
+    FlMethodCall* method_call,
+    MethodHandler handler,
+    pro_video_editor::ThreadPool& executor = method_executor()) {
+  g_object_ref(self);
+  g_object_ref(method_call);
+  run_on_executor(
+      executor,
+      [method_call, handler = std::move(handler)]() -> FlMethodResponse* {
+        pro_video_editor::MethodArgs args(fl_method_call_get_args(method_call));
+        if (!args.IsMap()) {
+          return pro_video_editor::ErrorResponse("InvalidArgument",
+                                                 "Expected a map");
+        }
+        return handler(args);
+      },
+      [self, method_call](FlMethodResponse* response) {
+        fl_method_call_respond(method_call, response, nullptr);
+        g_object_unref(method_call);
+        g_object_unref(self);
+      });
+}
 
 static void pro_video_editor_plugin_handle_method_call(
     ProVideoEditorPlugin* self,
     FlMethodCall* method_call) {
-  g_autoptr(FlMethodResponse) response = nullptr;
   const gchar* method = fl_method_call_get_name(method_call);
 
-  FlValue* args = fl_method_call_get_args(method_call);
-  flutter::EncodableValue encodable_args = ConvertFlValueToEncodable(args);
+  if (strcmp(method, "getPlatformVersion") == 0) {
+    g_autoptr(FlMethodResponse) response = get_platform_version();
+    fl_method_call_respond(method_call, response, nullptr);
 
-  if (!std::holds_alternative<flutter::EncodableMap>(encodable_args)) {
-    response = FL_METHOD_RESPONSE(fl_method_error_response_new(
-        "InvalidArgument", "Expected a map", nullptr));
+  } else if (strcmp(method, "getThumbnailCacheStats") == 0) {
+    g_autoptr(FlMethodResponse) response =
+        pro_video_editor::HandleGetThumbnailCacheStats();
     fl_method_call_respond(method_call, response, nullptr);
-    return;
-  }
 
-  auto args_map = std::get<flutter::EncodableMap>(encodable_args);
+  } else if (strcmp(method, "openVideo") == 0) {
+    dispatch_method_call(self, method_call, pro_video_editor::HandleOpenVideo);
 
-  if (strcmp(method, "getPlatformVersion") == 0) {
-    response = get_platform_version();
+  } else if (strcmp(method, "closeVideo") == 0) {
+    dispatch_method_call(self, method_call,
+                         pro_video_editor::HandleCloseVideo);
 
   } else if (strcmp(method, "getVideoInformation") == 0) {
-    pro_video_editor::HandleGetVideoInformation(
-        args_map,
-        std::make_unique<flutter::MethodResultFunctions<flutter::EncodableValue>>(
-            // onSuccess
-            [method_call](const flutter::EncodableValue* result) {
-              FlValue* fl_result = ConvertEncodableToFlValue(*result);
-              g_autoptr(FlMethodResponse) response =
-                  FL_METHOD_RESPONSE(fl_method_success_response_new(fl_result));
-              fl_method_call_respond(method_call, response, nullptr);
-            },
-            // onError
-            [method_call](const std::string& code,
-                          const std::string& message,
-                          const flutter::EncodableValue* details) {
-              g_autoptr(FlMethodResponse) response =
-                  FL_METHOD_RESPONSE(fl_method_error_response_new(code.c_str(), message.c_str(), nullptr));
-              fl_method_call_respond(method_call, response, nullptr);
-            },
-            // onNotImplemented
-            [method_call]() {
-              g_autoptr(FlMethodResponse) response =
-                  FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
-              fl_method_call_respond(method_call, response, nullptr);
-            }));
-
-    return;  // Don't respond here — async will handle it
+    int64_t reader_id = 0;
+    bool uses_reader =
+        pro_video_editor::MethodArgs(fl_method_call_get_args(method_call))
+            .GetInt("readerId", &reader_id);
+    dispatch_method_call(
+        self, method_call,
+        [self](const pro_video_editor::MethodArgs& args) {
+          return pro_video_editor::HandleGetVideoInformation(
+              args, [self](int64_t reader_id, int64_t offset, uint8_t* buffer,
+                           size_t size) {
+                return read_range_from_dart(self, reader_id, offset, buffer,
+                                            size);
+              });
+        },
+        uses_reader ? range_reader_executor() : method_executor());
+
+  } else if (strcmp(method, "getVideoInformationBatch") == 0) {
+    dispatch_method_call(self, method_call,
+                         pro_video_editor::HandleGetVideoInformationBatch);
 
   } else if (strcmp(method, "createVideoThumbnails") == 0) {
-    pro_video_editor::HandleGenerateThumbnails(
-        args_map,
-        std::make_unique<flutter::MethodResultFunctions<flutter::EncodableValue>>(
-            [method_call](const flutter::EncodableValue* result) {
-              FlValue* fl_result = ConvertEncodableToFlValue(*result);
-              g_autoptr(FlMethodResponse) response =
-                  FL_METHOD_RESPONSE(fl_method_success_response_new(fl_result));
-              fl_method_call_respond(method_call, response, nullptr);
-            },
-            [method_call](const std::string& code,
-                          const std::string& message,
-                          const flutter::EncodableValue* details) {
-              g_autoptr(FlMethodResponse) response =
-                  FL_METHOD_RESPONSE(fl_method_error_response_new(code.c_str(), message.c_str(), nullptr));
-              fl_method_call_respond(method_call, response, nullptr);
-            },
-            [method_call]() {
-              g_autoptr(FlMethodResponse) response =
-                  FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
-              fl_method_call_respond(method_call, response, nullptr);
-            }));
-
-    return;
+    dispatch_method_call(
+        self, method_call, [](const pro_video_editor::MethodArgs& args) {
+          return pro_video_editor::HandleGenerateThumbnails(args);
+        });
+
+  } else if (strcmp(method, "createVideoThumbnailsStream") == 0) {
+    // Thumbnails are delivered while the others are still being decoded.
+    dispatch_method_call(
+        self, method_call,
+        [self](const pro_video_editor::MethodArgs& args) {
+          int64_t request_id = 0;
+          args.GetInt("requestId", &request_id);
+
+          return pro_video_editor::HandleGenerateThumbnails(
+              args, [self, request_id](FlValue* event) {
+                fl_value_set_string_take(event, "requestId",
+                                         fl_value_new_int(request_id));
+                send_event_on_main_thread(self, self->thumbnail_channel,
+                                          event);
+              });
+        },
+        long_task_executor());
+
+  } else if (strcmp(method, "createThumbnailSpriteSheet") == 0) {
+    dispatch_method_call(self, method_call,
+                         pro_video_editor::HandleCreateThumbnailSpriteSheet);
+
+  } else if (strcmp(method, "exportVideo") == 0) {
+    dispatch_method_call(
+        self, method_call,
+        [self](const pro_video_editor::MethodArgs& args) {
+          return pro_video_editor::HandleExportVideo(
+              args, [self](double progress) {
+                send_event_on_main_thread(self, self->progress_channel,
+                                          fl_value_new_float(progress));
+              });
+        },
+        long_task_executor());
 
   } else {
-    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+    g_autoptr(FlMethodResponse) response =
+        FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+    fl_method_call_respond(method_call, response, nullptr);
   }
-
-  fl_method_call_respond(method_call, response, nullptr);
 }
 
 void pro_video_editor_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
@@ -143,13 +380,30 @@ void pro_video_editor_plugin_register_with_registrar(FlPluginRegistrar* registra
       g_object_new(pro_video_editor_plugin_get_type(), nullptr));
 
   g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
-  g_autoptr(FlMethodChannel) channel =
+  plugin->method_channel =
       fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
                             "pro_video_editor",
                             FL_METHOD_CODEC(codec));
-  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+  fl_method_channel_set_method_call_handler(plugin->method_channel,
+                                            method_call_cb,
                                             g_object_ref(plugin),
                                             g_object_unref);
 
+  plugin->progress_channel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           "pro_video_editor_progress",
+                           FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->progress_channel,
+                                       event_listen_cb, event_cancel_cb,
+                                       plugin, nullptr);
+
+  plugin->thumbnail_channel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           "pro_video_editor_thumbnails",
+                           FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->thumbnail_channel,
+                                       event_listen_cb, event_cancel_cb,
+                                       plugin, nullptr);
+
   g_object_unref(plugin);
 }
@@ -1,5 +1,7 @@
 #include <flutter_linux/flutter_linux.h>
 
+#include <functional>
+
 #include "include/pro_video_editor/pro_video_editor_plugin.h"
 
 // This file exposes some plugin internals for unit testing. See
@@ -8,3 +10,9 @@
 
 // Handles the getPlatformVersion method call.
 FlMethodResponse *get_platform_version();
+
+// Runs |work| on the background method executor and passes the response it
+// returns to |on_done| on the main thread. Method calls are handled this way
+// so the GTK main loop never waits for video work.
+void run_on_background_thread(std::function<FlMethodResponse*()> work,
+                              std::function<void(FlMethodResponse*)> on_done);
@@ -0,0 +1,48 @@
+#include "av_utils.h"
+
+extern "C" {
+// avformat.h only pulls in the major version of libavcodec since FFmpeg
+// 5.1; the side data check below needs the full one.
+#include <libavcodec/version.h>
+#include <libavformat/avformat.h>
+#include <libavutil/display.h>
+}
+
+#include <cmath>
+
+namespace pro_video_editor {
+
+std::string AvErrorToString(int errnum) {
+    char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(errnum, buffer, sizeof(buffer));
+    return buffer;
+}
+
+int FindVideoStreamIndex(AVFormatContext* format_ctx) {
+    int index = av_find_best_stream(format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    return index < 0 ? -1 : index;
+}
+
+int GetDisplayRotation(const AVStream* stream) {
+    const uint8_t* matrix = nullptr;
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(60, 31, 102)
+    const AVPacketSideData* side_data = av_packet_side_data_get(
+        stream->codecpar->coded_side_data,
+        stream->codecpar->nb_coded_side_data,
+        AV_PKT_DATA_DISPLAYMATRIX);
+    if (side_data) matrix = side_data->data;
+#else
+    matrix = av_stream_get_side_data(stream, AV_PKT_DATA_DISPLAYMATRIX, nullptr);
+#endif
+    if (!matrix) return 0;
+
+    // The display matrix stores a counter-clockwise angle.
+    double theta = -av_display_rotation_get(reinterpret_cast<const int32_t*>(matrix));
+    if (std::isnan(theta)) return 0;
+
+    int degrees = static_cast<int>(std::lround(theta)) % 360;
+    if (degrees < 0) degrees += 360;
+    return ((degrees + 45) / 90 % 4) * 90;
+}
+
+}  // namespace pro_video_editor
@@ -0,0 +1,23 @@
+// src/av_utils.h
+#pragma once
+
+#include <string>
+
+struct AVFormatContext;
+struct AVStream;
+
+namespace pro_video_editor {
+
+// Returns a readable message for an FFmpeg error code.
+std::string AvErrorToString(int errnum);
+
+// Returns the index of the best video stream in |format_ctx|, or -1 if the
+// input has none.
+int FindVideoStreamIndex(AVFormatContext* format_ctx);
+
+// Returns the clockwise display rotation of |stream| in degrees, normalized
+// to 0, 90, 180 or 270. This is the rotation the ffmpeg CLI applies when it
+// autorotates.
+int GetDisplayRotation(const AVStream* stream);
+
+}  // namespace pro_video_editor
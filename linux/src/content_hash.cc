@@ -0,0 +1,160 @@
+#include "content_hash.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace pro_video_editor {
+
+namespace {
+
+constexpr size_t kSampleCount = 32;
+constexpr size_t kSampleSize = 16 * 1024;
+
+constexpr uint64_t kPrime1 = 11400714785074694791ULL;
+constexpr uint64_t kPrime2 = 14029467366897019727ULL;
+constexpr uint64_t kPrime3 = 1609587929392839161ULL;
+constexpr uint64_t kPrime4 = 9650029242287828579ULL;
+constexpr uint64_t kPrime5 = 2870177450012600261ULL;
+
+uint64_t RotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t Read64(const uint8_t* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t Read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = RotateLeft(acc, 31);
+    return acc * kPrime1;
+}
+
+uint64_t MergeRound(uint64_t acc, uint64_t value) {
+    acc ^= Round(0, value);
+    return acc * kPrime1 + kPrime4;
+}
+
+struct Block {
+    size_t offset;
+    size_t length;
+};
+
+// The sampled blocks of an input of |size| bytes. Small inputs are hashed
+// completely.
+std::vector<Block> SampleBlocks(size_t size) {
+    if (size <= kSampleCount * kSampleSize) return {{0, size}};
+
+    std::vector<Block> blocks;
+    size_t last = size - kSampleSize;
+    for (size_t i = 0; i < kSampleCount; ++i) {
+        blocks.push_back({last / (kSampleCount - 1) * i, kSampleSize});
+    }
+    blocks.back().offset = last;
+    return blocks;
+}
+
+}  // namespace
+
+// Little-endian XXH64, see https://github.com/Cyan4973/xxHash.
+uint64_t XXHash64(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+        }
+        hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+        hash = MergeRound(hash, v1);
+        hash = MergeRound(hash, v2);
+        hash = MergeRound(hash, v3);
+        hash = MergeRound(hash, v4);
+    } else {
+        hash = seed + kPrime5;
+    }
+
+    hash += size;
+    for (; p + 8 <= end; p += 8) {
+        hash ^= Round(0, Read64(p));
+        hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= static_cast<uint64_t>(Read32(p)) * kPrime1;
+        hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= *p * kPrime5;
+        hash = RotateLeft(hash, 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+bool ComputeContentHash(const MediaSource& source, uint64_t* hash, std::string* error) {
+    std::vector<uint8_t> samples;
+    size_t size = source.size;
+
+    if (!source.path.empty()) {
+        int fd = open(source.path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            if (fd >= 0) close(fd);
+            if (error) *error = "Could not open video file: " + source.path;
+            return false;
+        }
+
+        size = static_cast<size_t>(info.st_size);
+        for (const Block& block : SampleBlocks(size)) {
+            size_t start = samples.size();
+            samples.resize(start + block.length);
+            ssize_t read = pread(fd, samples.data() + start, block.length, static_cast<off_t>(block.offset));
+            if (read != static_cast<ssize_t>(block.length)) {
+                close(fd);
+                if (error) *error = "Could not read video file: " + source.path;
+                return false;
+            }
+        }
+        close(fd);
+    } else if (source.data) {
+        for (const Block& block : SampleBlocks(size)) {
+            samples.insert(samples.end(), source.data + block.offset, source.data + block.offset + block.length);
+        }
+    } else {
+        if (error) *error = "The source has no data";
+        return false;
+    }
+
+    // The size seeds the hash, so truncated copies differ as well.
+    *hash = XXHash64(samples.data(), samples.size(), size);
+    return true;
+}
+
+}  // namespace pro_video_editor
@@ -0,0 +1,24 @@
+// src/content_hash.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "media_input.h"
+
+namespace pro_video_editor {
+
+// XXH64 of |size| bytes at |data|.
+uint64_t XXHash64(const void* data, size_t size, uint64_t seed = 0);
+
+// Fingerprints the encoded video of |source| without reading all of it.
+//
+// Hashes the total size plus evenly spread blocks, including the first and
+// last one, which hold the container headers and index. Two files that only
+// differ between the sampled blocks collide; for video files, where any
+// re-encode or edit changes the headers and most blocks, that is accepted
+// in exchange for hashing a few hundred KB instead of gigabytes.
+bool ComputeContentHash(const MediaSource& source, uint64_t* hash, std::string* error);
+
+}  // namespace pro_video_editor
@@ -0,0 +1,55 @@
+#include "decoder_threading.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+namespace pro_video_editor {
+
+namespace {
+
+std::mutex policyMutex;
+DecoderThreadingPolicy policy;
+
+}  // namespace
+
+DecoderThreadingPolicy GetDecoderThreadingPolicy() {
+    std::lock_guard<std::mutex> lock(policyMutex);
+    return policy;
+}
+
+void SetDecoderThreadingPolicy(const DecoderThreadingPolicy& newPolicy) {
+    std::lock_guard<std::mutex> lock(policyMutex);
+    policy = newPolicy;
+}
+
+DecoderThreading DecoderThreadingFor(DecodeWorkload workload, int concurrentDecoders) {
+    DecoderThreadingPolicy current = GetDecoderThreadingPolicy();
+    DecoderThreading threading = workload == DecodeWorkload::Export ? current.exportVideo : current.thumbnails;
+    if (threading.threadCount <= 0) {
+        int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        threading.threadCount = std::max(1, cores / std::max(1, concurrentDecoders));
+    }
+    return threading;
+}
+
+void ApplyDecoderThreading(AVCodecContext* codec_ctx, const DecoderThreading& threading) {
+    codec_ctx->thread_count = threading.threadCount;
+    switch (threading.threadType) {
+        case DecoderThreadType::Slice:
+            codec_ctx->thread_type = FF_THREAD_SLICE;
+            break;
+        case DecoderThreadType::Frame:
+            codec_ctx->thread_type = FF_THREAD_FRAME;
+            break;
+        case DecoderThreadType::FrameAndSlice:
+            codec_ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+            break;
+    }
+}
+
+}  // namespace pro_video_editor
@@ -0,0 +1,54 @@
+// src/decoder_threading.h
+#pragma once
+
+struct AVCodecContext;
+
+namespace pro_video_editor {
+
+// How a decoder splits its work over threads (AVCodecContext::thread_type).
+enum class DecoderThreadType {
+    // Slices of one frame in parallel. No extra latency, so a seek costs
+    // no more than single-threaded; the speedup depends on the encoder
+    // having written several slices.
+    Slice,
+    // Consecutive frames in parallel. Scales with any stream, but every
+    // thread adds a frame of latency, which is paid again after each seek.
+    Frame,
+    // Frame threads where the codec supports them, slices otherwise.
+    FrameAndSlice,
+};
+
+struct DecoderThreading {
+    // Threads per decoder. 0 splits the cores among the decoders that run
+    // at once.
+    int threadCount = 0;
+    DecoderThreadType threadType = DecoderThreadType::Slice;
+};
+
+// The kinds of decoding jobs with their own threading.
+enum class DecodeWorkload {
+    // Few frames around many seek points, usually several decoders at once.
+    Thumbnails,
+    // One long sequential pass.
+    Export,
+};
+
+// Threading per workload, process-wide.
+struct DecoderThreadingPolicy {
+    DecoderThreading thumbnails{0, DecoderThreadType::Slice};
+    DecoderThreading exportVideo{0, DecoderThreadType::FrameAndSlice};
+};
+
+DecoderThreadingPolicy GetDecoderThreadingPolicy();
+
+// Applies to decoders opened afterwards.
+void SetDecoderThreadingPolicy(const DecoderThreadingPolicy& policy);
+
+// Returns the threading of one decoder for |workload| while
+// |concurrentDecoders| decoders run at once, with the thread count resolved.
+DecoderThreading DecoderThreadingFor(DecodeWorkload workload, int concurrentDecoders = 1);
+
+// Sets thread_count and thread_type. Call before avcodec_open2.
+void ApplyDecoderThreading(AVCodecContext* codec_ctx, const DecoderThreading& threading);
+
+}  // namespace pro_video_editor
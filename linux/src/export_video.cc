@@ -0,0 +1,1865 @@
+#include "export_video.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavfilter/avfilter.h>
+#include <libavfilter/buffersink.h>
+#include <libavfilter/buffersrc.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/mem.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "av_utils.h"
+#include "decoder_threading.h"
+#include "h264_bitstream.h"
+#include "scratch_storage.h"
+
+namespace pro_video_editor {
+
+namespace {
+
+constexpr AVRational kMicroseconds{1, AV_TIME_BASE};
+
+// Level 8 gives a 512x512 Hald CLUT image holding a 64^3 color cube, which
+// is more precise than the 33^3 .cube file written on Android.
+constexpr int kHaldClutLevel = 8;
+
+constexpr int kIoBufferSize = 64 * 1024;
+
+// Parallel segments are at least this long, so the extra keyframe at every
+// join and the rate control warm-up of each encoder stay negligible.
+constexpr int64_t kMinSegmentUs = 10 * AV_TIME_BASE;
+
+// Cores per segment when the count is picked automatically. The encoders
+// keep using frame threads within their share of the cores.
+constexpr int kCoresPerSegment = 4;
+
+// Encoder and muxer settings parsed from ffmpeg CLI style arguments.
+struct CodecOptions {
+    std::string videoCodec;
+    std::string audioCodec;
+    std::string pixelFormat;
+    bool disableAudio = false;
+    int qscale = -1;
+    AVDictionary* videoOptions = nullptr;
+    AVDictionary* audioOptions = nullptr;
+    AVDictionary* formatOptions = nullptr;
+
+    ~CodecOptions() {
+        av_dict_free(&videoOptions);
+        av_dict_free(&audioOptions);
+        av_dict_free(&formatOptions);
+    }
+};
+
+// Translates `-key[:stream] value` pairs into codec and muxer options.
+// Options without a stream specifier are offered to every encoder and to
+// the muxer; each one only consumes the options it knows.
+void ParseCodecArgs(const std::vector<std::string>& args, CodecOptions* options) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (arg.size() < 2 || arg[0] != '-') continue;
+        if (arg == "-an") {
+            options->disableAudio = true;
+            continue;
+        }
+        if (i + 1 >= args.size()) break;
+        const std::string& value = args[++i];
+
+        std::string key = arg.substr(1);
+        std::string specifier;
+        size_t colon = key.find(':');
+        if (colon != std::string::npos) {
+            specifier = key.substr(colon + 1);
+            key = key.substr(0, colon);
+        }
+
+        if (key == "c" || key == "codec") {
+            if (specifier == "v") options->videoCodec = value;
+            if (specifier == "a") options->audioCodec = value;
+        } else if (key == "vcodec") {
+            options->videoCodec = value;
+        } else if (key == "acodec") {
+            options->audioCodec = value;
+        } else if (key == "pix_fmt") {
+            options->pixelFormat = value;
+        } else if (key == "qscale" || key == "q") {
+            if (specifier != "a") options->qscale = std::atoi(value.c_str());
+        } else {
+            if (specifier.empty() || specifier == "v") av_dict_set(&options->videoOptions, key.c_str(), value.c_str(), 0);
+            if (specifier.empty() || specifier == "a") av_dict_set(&options->audioOptions, key.c_str(), value.c_str(), 0);
+            if (specifier.empty()) av_dict_set(&options->formatOptions, key.c_str(), value.c_str(), 0);
+        }
+    }
+}
+
+std::vector<double> MultiplyColorMatrices(const std::vector<double>& m1, const std::vector<double>& m2) {
+    std::vector<double> result(20, 0.0);
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 5; ++j) {
+            result[i * 5 + j] =
+                m1[i * 5 + 0] * m2[0 + j] +
+                m1[i * 5 + 1] * m2[5 + j] +
+                m1[i * 5 + 2] * m2[10 + j] +
+                m1[i * 5 + 3] * m2[15 + j] +
+                (j == 4 ? m1[i * 5 + 4] : 0.0);
+        }
+    }
+    return result;
+}
+
+std::vector<double> CombineColorMatrices(const std::vector<std::vector<double>>& matrices) {
+    std::vector<double> result = matrices[0];
+    for (size_t i = 1; i < matrices.size(); ++i) {
+        // Multiply subsequent matrices on the left
+        result = MultiplyColorMatrices(matrices[i], result);
+    }
+    return result;
+}
+
+// Builds the color lookup of |matrix| as a Hald CLUT image for the
+// `haldclut` filter, so no .cube file has to be written.
+AVFrame* CreateHaldClutFrame(const std::vector<double>& matrix) {
+    const int cubeSize = kHaldClutLevel * kHaldClutLevel;
+    const int imageSize = cubeSize * kHaldClutLevel;
+
+    AVFrame* frame = av_frame_alloc();
+    if (!frame) return nullptr;
+    frame->format = AV_PIX_FMT_RGB24;
+    frame->width = imageSize;
+    frame->height = imageSize;
+    frame->pts = 0;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        av_frame_free(&frame);
+        return nullptr;
+    }
+
+    auto toByte = [](double value) {
+        return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0, 1.0) * 255.0));
+    };
+
+    // Red changes fastest, then green, then blue.
+    int index = 0;
+    for (int b = 0; b < cubeSize; ++b) {
+        for (int g = 0; g < cubeSize; ++g) {
+            for (int r = 0; r < cubeSize; ++r, ++index) {
+                double rf = r / static_cast<double>(cubeSize - 1);
+                double gf = g / static_cast<double>(cubeSize - 1);
+                double bf = b / static_cast<double>(cubeSize - 1);
+
+                // Include alpha terms (matrix[3], matrix[8], matrix[13])
+                double rr = matrix[0] * rf + matrix[1] * gf + matrix[2] * bf + matrix[3] + matrix[4] / 255.0;
+                double gg = matrix[5] * rf + matrix[6] * gf + matrix[7] * bf + matrix[8] + matrix[9] / 255.0;
+                double bb = matrix[10] * rf + matrix[11] * gf + matrix[12] * bf + matrix[13] + matrix[14] / 255.0;
+
+                uint8_t* pixel = frame->data[0] + (index / imageSize) * frame->linesize[0] + (index % imageSize) * 3;
+                pixel[0] = toByte(rr);
+                pixel[1] = toByte(gg);
+                pixel[2] = toByte(bb);
+            }
+        }
+    }
+    return frame;
+}
+
+// Decodes a single PNG image held in memory.
+AVFrame* DecodeImage(const uint8_t* data, size_t size) {
+    const AVCodec* decoder = avcodec_find_decoder(AV_CODEC_ID_PNG);
+    if (!decoder) return nullptr;
+
+    AVCodecContext* ctx = avcodec_alloc_context3(decoder);
+    AVPacket* packet = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    bool success = false;
+
+    // av_new_packet adds the input padding the decoder requires.
+    if (ctx && packet && frame &&
+        avcodec_open2(ctx, decoder, nullptr) >= 0 &&
+        av_new_packet(packet, static_cast<int>(size)) >= 0) {
+        std::memcpy(packet->data, data, size);
+        if (avcodec_send_packet(ctx, packet) >= 0) {
+            avcodec_send_packet(ctx, nullptr);
+            success = avcodec_receive_frame(ctx, frame) >= 0;
+        }
+    }
+
+    av_packet_free(&packet);
+    avcodec_free_context(&ctx);
+    if (!success) av_frame_free(&frame);
+    else frame->pts = 0;
+    return frame;
+}
+
+// Filters that apply the display rotation, like the ffmpeg CLI does before
+// any user filter.
+std::string RotationFilter(int rotation) {
+    switch (rotation) {
+        case 90: return "transpose=clock,";
+        case 180: return "hflip,vflip,";
+        case 270: return "transpose=cclock,";
+        default: return "";
+    }
+}
+
+AVPixelFormat SelectPixelFormat(const AVCodec* codec, const std::string& requested) {
+    if (!requested.empty()) {
+        AVPixelFormat format = av_get_pix_fmt(requested.c_str());
+        if (format != AV_PIX_FMT_NONE) return format;
+    }
+    if (!codec->pix_fmts) return AV_PIX_FMT_YUV420P;
+    for (const AVPixelFormat* p = codec->pix_fmts; *p != AV_PIX_FMT_NONE; ++p) {
+        if (*p == AV_PIX_FMT_YUV420P) return *p;
+    }
+    return codec->pix_fmts[0];
+}
+
+bool IsValidRate(AVRational rate) {
+    return rate.num > 0 && rate.den > 0;
+}
+
+// True if every pixel of |frame| is fully transparent. The editor always
+// sends its layers as an overlay, even when nothing was drawn.
+bool IsFullyTransparent(const AVFrame* frame) {
+    int alphaOffset;
+    int pixelSize;
+    switch (frame->format) {
+        case AV_PIX_FMT_RGBA:
+            alphaOffset = 3;
+            pixelSize = 4;
+            break;
+        case AV_PIX_FMT_YA8:
+            alphaOffset = 1;
+            pixelSize = 2;
+            break;
+        default:
+            return false;
+    }
+    for (int y = 0; y < frame->height; ++y) {
+        const uint8_t* row = frame->data[0] + y * frame->linesize[0];
+        for (int x = 0; x < frame->width; ++x) {
+            if (row[x * pixelSize + alphaOffset] != 0) return false;
+        }
+    }
+    return true;
+}
+
+// True if the output of |requestedEncoder| (or of the muxer's
+// |defaultCodec| when none is requested) is |sourceCodec| already, so the
+// stream can be copied. "copy" is accepted like on the ffmpeg CLI.
+bool ProducesCodec(const std::string& requestedEncoder, AVCodecID defaultCodec, AVCodecID sourceCodec) {
+    if (requestedEncoder.empty()) return defaultCodec == sourceCodec;
+    if (requestedEncoder == "copy") return true;
+    const AVCodec* codec = avcodec_find_encoder_by_name(requestedEncoder.c_str());
+    return codec && codec->id == sourceCodec;
+}
+
+bool SupportsPixelFormat(const AVCodec* codec, int format) {
+    if (!codec->pix_fmts) return false;
+    for (const AVPixelFormat* p = codec->pix_fmts; *p != AV_PIX_FMT_NONE; ++p) {
+        if (*p == format) return true;
+    }
+    return false;
+}
+
+// libx264 profile name of an H.264 profile_idc, or null.
+const char* X264ProfileName(int profile) {
+    switch (profile & 0xff) {
+        case 66: return "baseline";
+        case 77: return "main";
+        case 100: return "high";
+        case 110: return "high10";
+        case 122: return "high422";
+        case 244: return "high444";
+        default: return nullptr;
+    }
+}
+
+// Copies the display matrix and other stream side data. Newer FFmpeg keeps
+// it in the codec parameters, which avcodec_parameters_copy already copies.
+void CopyStreamSideData(const AVStream* in, AVStream* out) {
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(60, 31, 102)
+    for (int i = 0; i < in->nb_side_data; ++i) {
+        const AVPacketSideData& sideData = in->side_data[i];
+        uint8_t* data = av_stream_new_side_data(out, sideData.type, sideData.size);
+        if (data) std::memcpy(data, sideData.data, sideData.size);
+    }
+#else
+    (void)in;
+    (void)out;
+#endif
+}
+
+// How the export of one parallel segment differs from a single pass.
+struct SegmentSettings {
+    // Whether the final container wants global headers; the segments are
+    // muxed to NUT first, which would decide otherwise.
+    bool globalHeader = false;
+    // Segments exported at the same time, which share the cores.
+    int concurrentSegments = 1;
+};
+
+// Runs a single export. Owns every FFmpeg object it creates.
+class Exporter {
+public:
+    Exporter(const ExportVideoOptions& options,
+             const ExportProgressCallback& onProgress,
+             const SegmentSettings* segment = nullptr)
+        : options_(options), on_progress_(onProgress), segment_(segment) {
+        ParseCodecArgs(options.codecArgs, &codec_options_);
+    }
+
+    ~Exporter();
+
+    bool Run(std::vector<uint8_t>* output, std::string* error);
+
+private:
+    bool OpenInput(std::string* error);
+    bool OpenDecoder(int streamIndex, AVCodecContext** decoder, std::string* error);
+    bool OpenOutput(std::vector<uint8_t>* output, std::string* error);
+    bool OpenOutputFile(std::string* error);
+    bool WriteHeader(std::string* error);
+    const AVCodec* FindVideoEncoder() const;
+    bool SetupVideo(std::string* error);
+    bool ConfigureVideoFilters(AVPixelFormat pixelFormat, std::string* error);
+    bool SetupAudio(std::string* error);
+    bool ConfigureAudioFilters(std::string* error);
+    bool Transcode(std::string* error);
+
+    bool DecodeVideo(const AVPacket* packet, std::string* error);
+    bool DecodeAudio(const AVPacket* packet, std::string* error);
+    bool FilterVideoFrame(AVFrame* frame, std::string* error);
+    bool FilterAudioFrame(AVFrame* frame, std::string* error);
+    bool FinishVideo(std::string* error);
+    bool FinishAudio(std::string* error);
+    bool EncodeFrame(AVCodecContext* encoder, AVStream* stream, AVFrame* frame, std::string* error);
+
+    // Stream copy, see ExportVideoOptions::allowStreamCopy.
+    bool CanStreamCopy();
+    bool SetupStreamCopy(std::string* error);
+    bool StreamCopy(std::string* error);
+    bool FlushGop(std::string* error);
+    bool CopyGop(std::string* error);
+    bool ReencodeGop(std::string* error);
+    bool OpenBoundaryEncoder(std::string* error);
+    bool EncodeBoundaryFrame(AVFrame* frame, std::string* error);
+    bool CopyAudioPacket(AVPacket* packet, std::string* error);
+    bool WriteVideoPacket(AVPacket* packet, AVRational timeBase, std::string* error);
+    void FreeGop();
+
+    // Parallel segments, see ExportVideoOptions::parallelSegments.
+    std::vector<int64_t> PlanSegments();
+    int64_t KeyframePresentationTime(int64_t indexTimestamp);
+    bool RunSegmented(const std::vector<int64_t>& segmentStarts, std::string* error);
+    bool MergeSegments(
+        const std::vector<std::unique_ptr<ScratchFile>>& files,
+        const std::vector<int64_t>& segmentStarts,
+        std::string* error);
+    bool WriteHeldAudioPacket(AVPacket* packet, std::string* error);
+
+    // Returns the position of |pts| relative to the trim start, in
+    // microseconds.
+    int64_t RelativeTime(int64_t pts, const AVStream* stream) const;
+    void ReportProgress(int64_t relativeUs);
+
+    static int WritePacket(void* opaque,
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+                           const
+#endif
+                           uint8_t* buffer, int bufferSize);
+    static int64_t SeekOutput(void* opaque, int64_t offset, int whence);
+    int WriteToFile(const uint8_t* buffer, int bufferSize);
+    size_t output_size() const;
+
+    const ExportVideoOptions& options_;
+    const ExportProgressCallback& on_progress_;
+    // Set when this exporter renders one segment of a parallel export.
+    const SegmentSettings* segment_;
+    CodecOptions codec_options_;
+
+    std::unique_ptr<MediaInput> input_;
+    AVFormatContext* in_ctx_ = nullptr;
+    int video_index_ = -1;
+    int audio_index_ = -1;
+    AVCodecContext* video_decoder_ = nullptr;
+    AVCodecContext* audio_decoder_ = nullptr;
+
+    AVFormatContext* out_ctx_ = nullptr;
+    AVIOContext* out_io_ = nullptr;
+    std::vector<uint8_t>* output_ = nullptr;
+    size_t output_position_ = 0;
+    // Set when writing to a file or descriptor instead of |output_|.
+    int output_fd_ = -1;
+    size_t output_file_size_ = 0;
+    bool owns_output_fd_ = false;
+    bool export_succeeded_ = false;
+
+    AVCodecContext* video_encoder_ = nullptr;
+    AVCodecContext* audio_encoder_ = nullptr;
+    AVStream* video_stream_ = nullptr;
+    AVStream* audio_stream_ = nullptr;
+
+    AVFilterGraph* video_graph_ = nullptr;
+    AVFilterContext* video_src_ = nullptr;
+    AVFilterContext* overlay_src_ = nullptr;
+    AVFilterContext* clut_src_ = nullptr;
+    AVFilterContext* video_sink_ = nullptr;
+    AVFilterGraph* audio_graph_ = nullptr;
+    AVFilterContext* audio_src_ = nullptr;
+    AVFilterContext* audio_sink_ = nullptr;
+
+    AVFrame* overlay_frame_ = nullptr;
+    AVFrame* clut_frame_ = nullptr;
+    AVPacket* packet_ = nullptr;
+    AVPacket* out_packet_ = nullptr;
+    AVFrame* frame_ = nullptr;
+    AVFrame* filtered_frame_ = nullptr;
+
+    int64_t start_us_ = 0;
+    int64_t end_us_ = INT64_MAX;
+    int64_t duration_us_ = 0;
+    int64_t last_video_pts_ = INT64_MIN;
+    bool video_done_ = false;
+    bool audio_done_ = true;
+    double last_progress_ = -1;
+
+    bool stream_copy_ = false;
+    // The video packets of the GOP being read, keyframe first.
+    std::vector<AVPacket*> gop_;
+    // Cut points in the video stream time base.
+    int64_t copy_start_ts_ = 0;
+    int64_t copy_end_ts_ = INT64_MAX;
+    // pts - dts of the copied keyframes; re-encoded packets get the same
+    // offset so decoding timestamps stay increasing across the joins.
+    int64_t copy_dts_delay_ = -1;
+    int64_t last_video_dts_ = INT64_MIN;
+    AvcDecoderConfig avc_config_;
+    int boundary_parameter_set_id_ = -1;
+    std::vector<uint8_t> nal_buffer_;
+
+    // While the segments are encoded, the audio is encoded alongside and
+    // kept here in the encoder time base until the video can be muxed.
+    // Compressed audio is small next to the video, even for long exports.
+    bool hold_audio_ = false;
+    std::vector<AVPacket*> held_audio_;
+};
+
+Exporter::~Exporter() {
+    avfilter_graph_free(&video_graph_);
+    avfilter_graph_free(&audio_graph_);
+    avcodec_free_context(&video_decoder_);
+    avcodec_free_context(&audio_decoder_);
+    avcodec_free_context(&video_encoder_);
+    avcodec_free_context(&audio_encoder_);
+    av_frame_free(&overlay_frame_);
+    av_frame_free(&clut_frame_);
+    av_frame_free(&frame_);
+    av_frame_free(&filtered_frame_);
+    av_packet_free(&packet_);
+    av_packet_free(&out_packet_);
+    FreeGop();
+    for (AVPacket* packet : held_audio_) av_packet_free(&packet);
+    if (out_ctx_) avformat_free_context(out_ctx_);
+    if (out_io_) {
+        av_freep(&out_io_->buffer);
+        avio_context_free(&out_io_);
+    }
+    if (owns_output_fd_) {
+        close(output_fd_);
+        // Do not leave a truncated video behind.
+        if (!export_succeeded_) unlink(options_.outputPath.c_str());
+    }
+}
+
+bool Exporter::Run(std::vector<uint8_t>* output, std::string* error) {
+    packet_ = av_packet_alloc();
+    out_packet_ = av_packet_alloc();
+    frame_ = av_frame_alloc();
+    filtered_frame_ = av_frame_alloc();
+    if (!packet_ || !out_packet_ || !frame_ || !filtered_frame_) {
+        *error = "Out of memory";
+        return false;
+    }
+
+    if (!OpenInput(error)) return false;
+
+    if (options_.imageData && options_.imageSize > 0) {
+        overlay_frame_ = DecodeImage(options_.imageData, options_.imageSize);
+        if (!overlay_frame_) {
+            *error = "Failed to decode the overlay image";
+            return false;
+        }
+        // Drawing nothing over every frame is not worth a filter.
+        if (IsFullyTransparent(overlay_frame_)) av_frame_free(&overlay_frame_);
+    }
+
+    if (!options_.colorMatrices.empty()) {
+        for (const auto& matrix : options_.colorMatrices) {
+            if (matrix.size() != 20) {
+                *error = "Matrix must be 4x5 (20 elements)";
+                return false;
+            }
+        }
+        clut_frame_ = CreateHaldClutFrame(CombineColorMatrices(options_.colorMatrices));
+        if (!clut_frame_) {
+            *error = "Out of memory";
+            return false;
+        }
+    }
+
+    if (!OpenOutput(output, error)) return false;
+    stream_copy_ = CanStreamCopy();
+    std::vector<int64_t> segmentStarts;
+    if (!stream_copy_) segmentStarts = PlanSegments();
+
+    bool ok;
+    if (segmentStarts.size() > 1) {
+        ok = RunSegmented(segmentStarts, error);
+    } else if (stream_copy_) {
+        ok = SetupStreamCopy(error) && WriteHeader(error) && StreamCopy(error);
+    } else {
+        ok = SetupVideo(error) && SetupAudio(error) && WriteHeader(error) && Transcode(error);
+    }
+    if (!ok) return false;
+
+    int ret = av_write_trailer(out_ctx_);
+    if (ret < 0) {
+        *error = "Failed to finish the output: " + AvErrorToString(ret);
+        return false;
+    }
+    avio_flush(out_ctx_->pb);
+    if (out_ctx_->pb->error < 0) {
+        *error = "Failed to write the output: " + AvErrorToString(out_ctx_->pb->error);
+        return false;
+    }
+    if (owns_output_fd_ && fsync(output_fd_) != 0 && errno != EINVAL) {
+        *error = std::string("Failed to write the output: ") + std::strerror(errno);
+        return false;
+    }
+
+    export_succeeded_ = true;
+    if (on_progress_) on_progress_(1.0);
+    return true;
+}
+
+bool Exporter::OpenInput(std::string* error) {
+    input_ = MediaInput::Open(options_.source, error);
+    if (!input_) return false;
+    in_ctx_ = input_->format_context();
+
+    video_index_ = FindVideoStreamIndex(in_ctx_);
+    if (video_index_ < 0) {
+        *error = "No video stream found";
+        return false;
+    }
+    if (!OpenDecoder(video_index_, &video_decoder_, error)) return false;
+
+    if (!codec_options_.disableAudio) {
+        int index = av_find_best_stream(in_ctx_, AVMEDIA_TYPE_AUDIO, -1, video_index_, nullptr, 0);
+        if (index >= 0 && OpenDecoder(index, &audio_decoder_, nullptr)) audio_index_ = index;
+    }
+
+    for (unsigned i = 0; i < in_ctx_->nb_streams; ++i) {
+        if (static_cast<int>(i) != video_index_ && static_cast<int>(i) != audio_index_) {
+            in_ctx_->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    // Same trimmed duration as the Android implementation. Without any
+    // known duration, the progress follows the input position instead.
+    int64_t durationUs = options_.videoDurationMs > 0 ? options_.videoDurationMs * 1000 : in_ctx_->duration;
+    AVStream* video = in_ctx_->streams[video_index_];
+    if (durationUs <= 0 && video->duration > 0) {
+        durationUs = av_rescale_q(video->duration, video->time_base, kMicroseconds);
+    }
+    if (options_.startTime >= 0) start_us_ = std::llround(options_.startTime * AV_TIME_BASE);
+    if (options_.endTime >= 0) end_us_ = std::llround(options_.endTime * AV_TIME_BASE);
+    if (durationUs > 0) {
+        duration_us_ = std::min(end_us_, durationUs) - start_us_;
+    } else if (end_us_ != INT64_MAX) {
+        duration_us_ = end_us_ - start_us_;
+    }
+    return true;
+}
+
+bool Exporter::OpenDecoder(int streamIndex, AVCodecContext** decoder, std::string* error) {
+    AVStream* stream = in_ctx_->streams[streamIndex];
+    const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!codec) {
+        if (error) *error = "No decoder available for stream " + std::to_string(streamIndex);
+        return false;
+    }
+
+    *decoder = avcodec_alloc_context3(codec);
+    int ret = -1;
+    if (!*decoder ||
+        avcodec_parameters_to_context(*decoder, stream->codecpar) < 0 ||
+        (ApplyDecoderThreading(*decoder, DecoderThreadingFor(
+             DecodeWorkload::Export, segment_ ? segment_->concurrentSegments : 1)),
+         (*decoder)->pkt_timebase = stream->time_base,
+         (ret = avcodec_open2(*decoder, codec, nullptr)) < 0)) {
+        if (error) *error = "Failed to open decoder: " + AvErrorToString(ret);
+        avcodec_free_context(decoder);
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::OpenOutput(std::vector<uint8_t>* output, std::string* error) {
+    // Let libavformat pick the muxer from the extension, so "mkv" maps to
+    // matroska just like an output file name would.
+    std::string name = "output." + options_.outputFormat;
+    int ret = avformat_alloc_output_context2(&out_ctx_, nullptr, nullptr, name.c_str());
+    if (ret < 0 || !out_ctx_) {
+        *error = "Unsupported output format: " + options_.outputFormat;
+        return false;
+    }
+
+    output_position_ = 0;
+    if (!options_.outputPath.empty() || options_.outputFd >= 0) {
+        if (!OpenOutputFile(error)) return false;
+    } else if (output) {
+        output_ = output;
+        output_->clear();
+    } else {
+        *error = "No output given";
+        return false;
+    }
+
+    auto* buffer = static_cast<unsigned char*>(av_malloc(kIoBufferSize));
+    if (!buffer) {
+        *error = "Out of memory";
+        return false;
+    }
+    out_io_ = avio_alloc_context(buffer, kIoBufferSize, 1, this, nullptr, &Exporter::WritePacket, &Exporter::SeekOutput);
+    if (!out_io_) {
+        av_free(buffer);
+        *error = "Out of memory";
+        return false;
+    }
+    out_ctx_->pb = out_io_;
+    out_ctx_->flags |= AVFMT_FLAG_CUSTOM_IO;
+    return true;
+}
+
+bool Exporter::OpenOutputFile(std::string* error) {
+    if (!options_.outputPath.empty()) {
+        output_fd_ = open(options_.outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (output_fd_ < 0) {
+            *error = "Failed to open " + options_.outputPath + ": " + std::strerror(errno);
+            return false;
+        }
+        owns_output_fd_ = true;
+        return true;
+    }
+
+    // Write at absolute offsets from 0, like the in-memory output, so the
+    // caller's file offset does not matter.
+    output_fd_ = options_.outputFd;
+    struct stat info;
+    if (fstat(output_fd_, &info) != 0) {
+        *error = std::string("Invalid output descriptor: ") + std::strerror(errno);
+        return false;
+    }
+    if (S_ISREG(info.st_mode) && ftruncate(output_fd_, 0) != 0) {
+        *error = std::string("Failed to truncate the output: ") + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::WriteHeader(std::string* error) {
+    int ret = avformat_write_header(out_ctx_, &codec_options_.formatOptions);
+    if (ret < 0) {
+        *error = "Failed to write the output header: " + AvErrorToString(ret);
+        return false;
+    }
+    return true;
+}
+
+const AVCodec* Exporter::FindVideoEncoder() const {
+    return codec_options_.videoCodec.empty()
+        ? avcodec_find_encoder(out_ctx_->oformat->video_codec)
+        : avcodec_find_encoder_by_name(codec_options_.videoCodec.c_str());
+}
+
+bool Exporter::SetupVideo(std::string* error) {
+    const AVCodec* codec = FindVideoEncoder();
+    if (!codec) {
+        *error = "Video encoder not found: " +
+            (codec_options_.videoCodec.empty() ? std::string("default") : codec_options_.videoCodec);
+        return false;
+    }
+
+    if (!ConfigureVideoFilters(SelectPixelFormat(codec, codec_options_.pixelFormat), error)) return false;
+
+    video_encoder_ = avcodec_alloc_context3(codec);
+    if (!video_encoder_) {
+        *error = "Out of memory";
+        return false;
+    }
+
+    AVRational frameRate = av_buffersink_get_frame_rate(video_sink_);
+    if (!IsValidRate(frameRate)) frameRate = av_guess_frame_rate(in_ctx_, in_ctx_->streams[video_index_], nullptr);
+
+    video_encoder_->width = av_buffersink_get_w(video_sink_);
+    video_encoder_->height = av_buffersink_get_h(video_sink_);
+    video_encoder_->pix_fmt = static_cast<AVPixelFormat>(av_buffersink_get_format(video_sink_));
+    video_encoder_->sample_aspect_ratio = av_buffersink_get_sample_aspect_ratio(video_sink_);
+    video_encoder_->time_base = IsValidRate(frameRate)
+        ? av_inv_q(frameRate)
+        : av_buffersink_get_time_base(video_sink_);
+    if (IsValidRate(frameRate)) video_encoder_->framerate = frameRate;
+    video_encoder_->thread_count = 0;
+    if (segment_) {
+        int cores = static_cast<int>(std::thread::hardware_concurrency());
+        video_encoder_->thread_count = std::max(cores / segment_->concurrentSegments, 1);
+    }
+    if (codec_options_.qscale >= 0) {
+        video_encoder_->flags |= AV_CODEC_FLAG_QSCALE;
+        video_encoder_->global_quality = FF_QP2LAMBDA * codec_options_.qscale;
+    }
+    if (segment_ ? segment_->globalHeader : (out_ctx_->oformat->flags & AVFMT_GLOBALHEADER) != 0) {
+        video_encoder_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    int ret = avcodec_open2(video_encoder_, codec, &codec_options_.videoOptions);
+    if (ret < 0) {
+        *error = "Failed to open video encoder: " + AvErrorToString(ret);
+        return false;
+    }
+
+    video_stream_ = avformat_new_stream(out_ctx_, nullptr);
+    if (!video_stream_ || avcodec_parameters_from_context(video_stream_->codecpar, video_encoder_) < 0) {
+        *error = "Failed to create the video stream";
+        return false;
+    }
+    video_stream_->time_base = video_encoder_->time_base;
+    return true;
+}
+
+bool Exporter::ConfigureVideoFilters(AVPixelFormat pixelFormat, std::string* error) {
+    video_graph_ = avfilter_graph_alloc();
+    if (!video_graph_) {
+        *error = "Out of memory";
+        return false;
+    }
+
+    AVStream* stream = in_ctx_->streams[video_index_];
+    AVRational frameRate = av_guess_frame_rate(in_ctx_, stream, nullptr);
+    AVRational sar = video_decoder_->sample_aspect_ratio;
+
+    char args[512];
+    std::snprintf(args, sizeof(args),
+                  "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
+                  video_decoder_->width, video_decoder_->height, video_decoder_->pix_fmt,
+                  stream->time_base.num, stream->time_base.den,
+                  sar.num, std::max(sar.den, 1));
+    std::string srcArgs = args;
+    if (IsValidRate(frameRate)) {
+        srcArgs += ":frame_rate=" + std::to_string(frameRate.num) + "/" + std::to_string(frameRate.den);
+    }
+
+    int ret = avfilter_graph_create_filter(&video_src_, avfilter_get_by_name("buffer"), "in", srcArgs.c_str(), nullptr, video_graph_);
+    if (ret >= 0) {
+        ret = avfilter_graph_create_filter(&video_sink_, avfilter_get_by_name("buffersink"), "out", nullptr, nullptr, video_graph_);
+    }
+    if (ret >= 0) {
+        AVPixelFormat pixelFormats[] = {pixelFormat, AV_PIX_FMT_NONE};
+        ret = av_opt_set_int_list(video_sink_, "pix_fmts", pixelFormats, AV_PIX_FMT_NONE, AV_OPT_SEARCH_CHILDREN);
+    }
+    if (ret >= 0 && overlay_frame_) {
+        std::snprintf(args, sizeof(args), "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=1/1",
+                      overlay_frame_->width, overlay_frame_->height, overlay_frame_->format,
+                      stream->time_base.num, stream->time_base.den);
+        ret = avfilter_graph_create_filter(&overlay_src_, avfilter_get_by_name("buffer"), "img", args, nullptr, video_graph_);
+    }
+    if (ret >= 0 && clut_frame_) {
+        std::snprintf(args, sizeof(args), "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=1/1",
+                      clut_frame_->width, clut_frame_->height, clut_frame_->format,
+                      stream->time_base.num, stream->time_base.den);
+        ret = avfilter_graph_create_filter(&clut_src_, avfilter_get_by_name("buffer"), "clut", args, nullptr, video_graph_);
+    }
+    if (ret < 0) {
+        *error = "Failed to create the video filters: " + AvErrorToString(ret);
+        return false;
+    }
+
+    // Same graph as on Android: convert to RGB to match Flutter's color
+    // processing, apply the color matrices and filters, then draw the
+    // overlay image scaled to the video size.
+    std::string description = "[in]" + RotationFilter(GetDisplayRotation(stream)) + "format=rgb24";
+    if (clut_src_) description += "[rgb];[rgb][clut]haldclut";
+    if (!options_.filters.empty()) description += "," + options_.filters;
+    if (overlay_src_) {
+        description += "[vid];[img][vid]scale2ref=w=iw:h=ih[ovr][base];[base][ovr]overlay=0:0";
+    }
+    description += "[out]";
+
+    AVFilterInOut* outputs = nullptr;
+    auto addOutput = [&outputs](const char* name, AVFilterContext* ctx) {
+        AVFilterInOut* io = avfilter_inout_alloc();
+        if (!io) return;
+        io->name = av_strdup(name);
+        io->filter_ctx = ctx;
+        io->pad_idx = 0;
+        io->next = outputs;
+        outputs = io;
+    };
+    addOutput("in", video_src_);
+    if (overlay_src_) addOutput("img", overlay_src_);
+    if (clut_src_) addOutput("clut", clut_src_);
+
+    AVFilterInOut* inputs = avfilter_inout_alloc();
+    if (inputs) {
+        inputs->name = av_strdup("out");
+        inputs->filter_ctx = video_sink_;
+        inputs->pad_idx = 0;
+        inputs->next = nullptr;
+    }
+
+    ret = avfilter_graph_parse_ptr(video_graph_, description.c_str(), &inputs, &outputs, nullptr);
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    if (ret >= 0) ret = avfilter_graph_config(video_graph_, nullptr);
+    if (ret < 0) {
+        *error = "Invalid filter graph \"" + description + "\": " + AvErrorToString(ret);
+        return false;
+    }
+
+    // The overlay and the color lookup are single images; the filters
+    // repeat the last frame for the whole video.
+    if (overlay_src_) {
+        av_buffersrc_add_frame_flags(overlay_src_, overlay_frame_, AV_BUFFERSRC_FLAG_KEEP_REF);
+        av_buffersrc_add_frame(overlay_src_, nullptr);
+    }
+    if (clut_src_) {
+        av_buffersrc_add_frame_flags(clut_src_, clut_frame_, AV_BUFFERSRC_FLAG_KEEP_REF);
+        av_buffersrc_add_frame(clut_src_, nullptr);
+    }
+    return true;
+}
+
+bool Exporter::SetupAudio(std::string* error) {
+    if (audio_index_ < 0) return true;
+
+    const AVCodec* codec = codec_options_.audioCodec.empty()
+        ? avcodec_find_encoder(out_ctx_->oformat->audio_codec)
+        : avcodec_find_encoder_by_name(codec_options_.audioCodec.c_str());
+    if (!codec) {
+        // E.g. GIF output has no audio.
+        if (codec_options_.audioCodec.empty()) return true;
+        *error = "Audio encoder not found: " + codec_options_.audioCodec;
+        return false;
+    }
+
+    audio_encoder_ = avcodec_alloc_context3(codec);
+    if (!audio_encoder_) {
+        *error = "Out of memory";
+        return false;
+    }
+
+    int sampleRate = audio_decoder_->sample_rate;
+    if (codec->supported_samplerates) {
+        const int* rate = codec->supported_samplerates;
+        while (*rate && *rate != sampleRate) ++rate;
+        if (!*rate) sampleRate = codec->supported_samplerates[0];
+    }
+    audio_encoder_->sample_rate = sampleRate;
+    audio_encoder_->sample_fmt = codec->sample_fmts ? codec->sample_fmts[0] : audio_decoder_->sample_fmt;
+    audio_encoder_->time_base = AVRational{1, sampleRate};
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 24, 100)
+    if (audio_decoder_->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC) {
+        av_channel_layout_default(&audio_encoder_->ch_layout, std::max(audio_decoder_->ch_layout.nb_channels, 1));
+    } else {
+        av_channel_layout_copy(&audio_encoder_->ch_layout, &audio_decoder_->ch_layout);
+    }
+#else
+    audio_encoder_->channel_layout = audio_decoder_->channel_layout
+        ? audio_decoder_->channel_layout
+        : av_get_default_channel_layout(std::max(audio_decoder_->channels, 1));
+    audio_encoder_->channels = av_get_channel_layout_nb_channels(audio_encoder_->channel_layout);
+#endif
+    if (out_ctx_->oformat->flags & AVFMT_GLOBALHEADER) {
+        audio_encoder_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    int ret = avcodec_open2(audio_encoder_, codec, &codec_options_.audioOptions);
+    if (ret < 0) {
+        *error = "Failed to open audio encoder: " + AvErrorToString(ret);
+        return false;
+    }
+
+    audio_stream_ = avformat_new_stream(out_ctx_, nullptr);
+    if (!audio_stream_ || avcodec_parameters_from_context(audio_stream_->codecpar, audio_encoder_) < 0) {
+        *error = "Failed to create the audio stream";
+        return false;
+    }
+    audio_stream_->time_base = audio_encoder_->time_base;
+
+    if (!ConfigureAudioFilters(error)) return false;
+    audio_done_ = false;
+    return true;
+}
+
+bool Exporter::ConfigureAudioFilters(std::string* error) {
+    audio_graph_ = avfilter_graph_alloc();
+    if (!audio_graph_) {
+        *error = "Out of memory";
+        return false;
+    }
+
+    AVStream* stream = in_ctx_->streams[audio_index_];
+    char inLayout[256] = {0};
+    char outLayout[256] = {0};
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 24, 100)
+    AVChannelLayout decoderLayout{};
+    if (audio_decoder_->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC) {
+        av_channel_layout_default(&decoderLayout, std::max(audio_decoder_->ch_layout.nb_channels, 1));
+    } else {
+        av_channel_layout_copy(&decoderLayout, &audio_decoder_->ch_layout);
+    }
+    av_channel_layout_describe(&decoderLayout, inLayout, sizeof(inLayout));
+    av_channel_layout_uninit(&decoderLayout);
+    av_channel_layout_describe(&audio_encoder_->ch_layout, outLayout, sizeof(outLayout));
+#else
+    uint64_t decoderLayout = audio_decoder_->channel_layout
+        ? audio_decoder_->channel_layout
+        : av_get_default_channel_layout(std::max(audio_decoder_->channels, 1));
+    std::snprintf(inLayout, sizeof(inLayout), "0x%llx", static_cast<unsigned long long>(decoderLayout));
+    std::snprintf(outLayout, sizeof(outLayout), "0x%llx", static_cast<unsigned long long>(audio_encoder_->channel_layout));
+#endif
+
+    char args[512];
+    std::snprintf(args, sizeof(args), "time_base=%d/%d:sample_rate=%d:sample_fmt=%s:channel_layout=%s",
+                  stream->time_base.num, stream->time_base.den, audio_decoder_->sample_rate,
+                  av_get_sample_fmt_name(audio_decoder_->sample_fmt), inLayout);
+    int ret = avfilter_graph_create_filter(&audio_src_, avfilter_get_by_name("abuffer"), "in", args, nullptr, audio_graph_);
+    if (ret >= 0) {
+        ret = avfilter_graph_create_filter(&audio_sink_, avfilter_get_by_name("abuffersink"), "out", nullptr, nullptr, audio_graph_);
+    }
+    if (ret < 0) {
+        *error = "Failed to create the audio filters: " + AvErrorToString(ret);
+        return false;
+    }
+
+    std::snprintf(args, sizeof(args), "aresample,aformat=sample_fmts=%s:sample_rates=%d:channel_layouts=%s",
+                  av_get_sample_fmt_name(audio_encoder_->sample_fmt), audio_encoder_->sample_rate, outLayout);
+
+    AVFilterInOut* outputs = avfilter_inout_alloc();
+    AVFilterInOut* inputs = avfilter_inout_alloc();
+    if (outputs && inputs) {
+        outputs->name = av_strdup("in");
+        outputs->filter_ctx = audio_src_;
+        outputs->pad_idx = 0;
+        outputs->next = nullptr;
+        inputs->name = av_strdup("out");
+        inputs->filter_ctx = audio_sink_;
+        inputs->pad_idx = 0;
+        inputs->next = nullptr;
+        ret = avfilter_graph_parse_ptr(audio_graph_, args, &inputs, &outputs, nullptr);
+    } else {
+        ret = AVERROR(ENOMEM);
+    }
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    if (ret >= 0) ret = avfilter_graph_config(audio_graph_, nullptr);
+    if (ret < 0) {
+        *error = "Failed to configure the audio filters: " + AvErrorToString(ret);
+        return false;
+    }
+
+    // Encoders like AAC need fixed-size frames.
+    if (audio_encoder_->frame_size > 0 &&
+        !(audio_encoder_->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)) {
+        av_buffersink_set_frame_size(audio_sink_, audio_encoder_->frame_size);
+    }
+    return true;
+}
+
+bool Exporter::Transcode(std::string* error) {
+    if (start_us_ > 0) {
+        int64_t startTime = in_ctx_->start_time != AV_NOPTS_VALUE ? in_ctx_->start_time : 0;
+        av_seek_frame(in_ctx_, -1, startTime + start_us_, AVSEEK_FLAG_BACKWARD);
+    }
+
+    while (!video_done_ || !audio_done_) {
+        int ret = av_read_frame(in_ctx_, packet_);
+        if (ret == AVERROR_EOF) break;
+        if (ret < 0) {
+            *error = "Failed to read the input: " + AvErrorToString(ret);
+            return false;
+        }
+
+        bool ok = true;
+        if (packet_->stream_index == video_index_ && !video_done_) {
+            ok = DecodeVideo(packet_, error);
+        } else if (packet_->stream_index == audio_index_ && !audio_done_) {
+            ok = DecodeAudio(packet_, error);
+        }
+        av_packet_unref(packet_);
+        if (!ok) return false;
+    }
+
+    // Drain the decoders, then the filters and encoders.
+    if (!video_done_ && !DecodeVideo(nullptr, error)) return false;
+    if (!audio_done_ && !DecodeAudio(nullptr, error)) return false;
+    return FinishVideo(error) && FinishAudio(error);
+}
+
+int64_t Exporter::RelativeTime(int64_t pts, const AVStream* stream) const {
+    int64_t startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    return av_rescale_q(pts - startTime, stream->time_base, kMicroseconds) - start_us_;
+}
+
+bool Exporter::DecodeVideo(const AVPacket* packet, std::string* error) {
+    int ret = avcodec_send_packet(video_decoder_, packet);
+    if (ret < 0 && ret != AVERROR_EOF) {
+        *error = "Failed to decode video: " + AvErrorToString(ret);
+        return false;
+    }
+
+    AVStream* stream = in_ctx_->streams[video_index_];
+    while ((ret = avcodec_receive_frame(video_decoder_, frame_)) == 0) {
+        int64_t pts = frame_->best_effort_timestamp;
+        int64_t relativeUs = pts == AV_NOPTS_VALUE ? 0 : RelativeTime(pts, stream);
+
+        if (relativeUs < 0) {
+            av_frame_unref(frame_);
+            continue;
+        }
+        if (start_us_ + relativeUs >= end_us_) {
+            av_frame_unref(frame_);
+            return FinishVideo(error);
+        }
+
+        frame_->pts = av_rescale_q(relativeUs, kMicroseconds, stream->time_base);
+        if (!FilterVideoFrame(frame_, error)) return false;
+    }
+    if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+        *error = "Failed to decode video: " + AvErrorToString(ret);
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::DecodeAudio(const AVPacket* packet, std::string* error) {
+    int ret = avcodec_send_packet(audio_decoder_, packet);
+    if (ret < 0 && ret != AVERROR_EOF) {
+        // A broken audio packet should not fail the whole export.
+        return true;
+    }
+
+    AVStream* stream = in_ctx_->streams[audio_index_];
+    while ((ret = avcodec_receive_frame(audio_decoder_, frame_)) == 0) {
+        int64_t pts = frame_->best_effort_timestamp;
+        int64_t relativeUs = pts == AV_NOPTS_VALUE ? 0 : RelativeTime(pts, stream);
+
+        if (relativeUs < 0) {
+            av_frame_unref(frame_);
+            continue;
+        }
+        if (start_us_ + relativeUs >= end_us_) {
+            av_frame_unref(frame_);
+            return FinishAudio(error);
+        }
+
+        frame_->pts = av_rescale_q(relativeUs, kMicroseconds, stream->time_base);
+        if (!FilterAudioFrame(frame_, error)) return false;
+    }
+    return true;
+}
+
+bool Exporter::FilterVideoFrame(AVFrame* frame, std::string* error) {
+    int ret = av_buffersrc_add_frame(video_src_, frame);
+    if (ret < 0) {
+        *error = "Failed to filter video: " + AvErrorToString(ret);
+        return false;
+    }
+
+    AVRational sinkTimeBase = av_buffersink_get_time_base(video_sink_);
+    while ((ret = av_buffersink_get_frame(video_sink_, filtered_frame_)) >= 0) {
+        int64_t relativeUs = av_rescale_q(filtered_frame_->pts, sinkTimeBase, kMicroseconds);
+
+        // Keep timestamps strictly increasing after rounding to the
+        // encoder's frame based time base.
+        int64_t pts = av_rescale_q(filtered_frame_->pts, sinkTimeBase, video_encoder_->time_base);
+        if (pts <= last_video_pts_) pts = last_video_pts_ + 1;
+        last_video_pts_ = pts;
+        filtered_frame_->pts = pts;
+        filtered_frame_->pict_type = AV_PICTURE_TYPE_NONE;
+
+        bool ok = EncodeFrame(video_encoder_, video_stream_, filtered_frame_, error);
+        av_frame_unref(filtered_frame_);
+        if (!ok) return false;
+        ReportProgress(relativeUs);
+    }
+    if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+        *error = "Failed to filter video: " + AvErrorToString(ret);
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::FilterAudioFrame(AVFrame* frame, std::string* error) {
+    int ret = av_buffersrc_add_frame(audio_src_, frame);
+    if (ret < 0) {
+        *error = "Failed to filter audio: " + AvErrorToString(ret);
+        return false;
+    }
+
+    AVRational sinkTimeBase = av_buffersink_get_time_base(audio_sink_);
+    while ((ret = av_buffersink_get_frame(audio_sink_, filtered_frame_)) >= 0) {
+        filtered_frame_->pts = av_rescale_q(filtered_frame_->pts, sinkTimeBase, audio_encoder_->time_base);
+        bool ok = EncodeFrame(audio_encoder_, audio_stream_, filtered_frame_, error);
+        av_frame_unref(filtered_frame_);
+        if (!ok) return false;
+    }
+    if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+        *error = "Failed to filter audio: " + AvErrorToString(ret);
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::FinishVideo(std::string* error) {
+    if (video_done_) return true;
+    video_done_ = true;
+    return FilterVideoFrame(nullptr, error) &&
+           EncodeFrame(video_encoder_, video_stream_, nullptr, error);
+}
+
+bool Exporter::FinishAudio(std::string* error) {
+    if (audio_done_) return true;
+    audio_done_ = true;
+    return FilterAudioFrame(nullptr, error) &&
+           EncodeFrame(audio_encoder_, audio_stream_, nullptr, error);
+}
+
+bool Exporter::EncodeFrame(AVCodecContext* encoder, AVStream* stream, AVFrame* frame, std::string* error) {
+    int ret = avcodec_send_frame(encoder, frame);
+    if (ret < 0 && ret != AVERROR_EOF) {
+        *error = "Failed to encode: " + AvErrorToString(ret);
+        return false;
+    }
+
+    while ((ret = avcodec_receive_packet(encoder, out_packet_)) == 0) {
+        if (hold_audio_ && stream == audio_stream_) {
+            AVPacket* held = av_packet_alloc();
+            if (!held) {
+                *error = "Out of memory";
+                return false;
+            }
+            av_packet_move_ref(held, out_packet_);
+            held_audio_.push_back(held);
+            continue;
+        }
+        av_packet_rescale_ts(out_packet_, encoder->time_base, stream->time_base);
+        out_packet_->stream_index = stream->index;
+        ret = av_interleaved_write_frame(out_ctx_, out_packet_);
+        if (ret < 0) {
+            *error = "Failed to write the output: " + AvErrorToString(ret);
+            return false;
+        }
+    }
+    if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+        *error = "Failed to encode: " + AvErrorToString(ret);
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::CanStreamCopy() {
+    if (!options_.allowStreamCopy || overlay_frame_ || clut_frame_ || !options_.filters.empty()) return false;
+
+    const AVOutputFormat* format = out_ctx_->oformat;
+    const AVCodecParameters* video = in_ctx_->streams[video_index_]->codecpar;
+    // The encoding configs always name a pixel format; only a conversion
+    // rules the copy out.
+    if (!codec_options_.pixelFormat.empty() &&
+        av_get_pix_fmt(codec_options_.pixelFormat.c_str()) != video->format) {
+        return false;
+    }
+    if (!ProducesCodec(codec_options_.videoCodec, format->video_codec, video->codec_id) ||
+        avformat_query_codec(format, video->codec_id, FF_COMPLIANCE_NORMAL) != 1) {
+        return false;
+    }
+    if (audio_index_ >= 0) {
+        const AVCodecParameters* audio = in_ctx_->streams[audio_index_]->codecpar;
+        if (!ProducesCodec(codec_options_.audioCodec, format->audio_codec, audio->codec_id) ||
+            avformat_query_codec(format, audio->codec_id, FF_COMPLIANCE_NORMAL) != 1) {
+            return false;
+        }
+    }
+
+    bool trimmed = start_us_ > 0 ||
+        (end_us_ != INT64_MAX && (in_ctx_->duration <= 0 || end_us_ < in_ctx_->duration));
+    if (!trimmed) return true;
+
+    // Cut points inside a GOP need re-encoded frames that decoders of the
+    // copied stream accept. That is solved for H.264 with length-prefixed
+    // NAL units, as in MP4 and Matroska: libx264 sends its own parameter
+    // sets in-band under an id the copied stream does not use.
+    const AVCodec* x264 = avcodec_find_encoder_by_name("libx264");
+    if (video->codec_id != AV_CODEC_ID_H264 || !x264 || !SupportsPixelFormat(x264, video->format)) return false;
+    if (!ParseAvcDecoderConfig(video->extradata, video->extradata_size, &avc_config_)) return false;
+    boundary_parameter_set_id_ = UnusedParameterSetId(avc_config_);
+    if (boundary_parameter_set_id_ < 0) return false;
+
+    std::string muxer = format->name;
+    return muxer == "mp4" || muxer == "mov" || muxer == "matroska";
+}
+
+bool Exporter::SetupStreamCopy(std::string* error) {
+    for (int index : {video_index_, audio_index_}) {
+        if (index < 0) continue;
+        AVStream* in = in_ctx_->streams[index];
+        AVStream* out = avformat_new_stream(out_ctx_, nullptr);
+        if (!out || avcodec_parameters_copy(out->codecpar, in->codecpar) < 0) {
+            *error = "Failed to create the output streams";
+            return false;
+        }
+        // The tag of the source container may not exist in the output.
+        out->codecpar->codec_tag = 0;
+        out->time_base = in->time_base;
+        CopyStreamSideData(in, out);
+        (index == video_index_ ? video_stream_ : audio_stream_) = out;
+    }
+    audio_done_ = audio_stream_ == nullptr;
+
+    AVStream* in = in_ctx_->streams[video_index_];
+    int64_t startTime = in->start_time != AV_NOPTS_VALUE ? in->start_time : 0;
+    copy_start_ts_ = startTime + av_rescale_q(start_us_, kMicroseconds, in->time_base);
+    if (end_us_ != INT64_MAX) copy_end_ts_ = startTime + av_rescale_q(end_us_, kMicroseconds, in->time_base);
+    return true;
+}
+
+bool Exporter::StreamCopy(std::string* error) {
+    if (start_us_ > 0) {
+        int64_t startTime = in_ctx_->start_time != AV_NOPTS_VALUE ? in_ctx_->start_time : 0;
+        av_seek_frame(in_ctx_, -1, startTime + start_us_, AVSEEK_FLAG_BACKWARD);
+    }
+
+    // Video is collected one GOP at a time, since whether a GOP can be
+    // copied depends on where it ends.
+    while (!video_done_ || !audio_done_) {
+        int ret = av_read_frame(in_ctx_, packet_);
+        if (ret == AVERROR_EOF) break;
+        if (ret < 0) {
+            *error = "Failed to read the input: " + AvErrorToString(ret);
+            return false;
+        }
+
+        bool ok = true;
+        if (packet_->stream_index == video_index_ && !video_done_) {
+            bool keyframe = packet_->flags & AV_PKT_FLAG_KEY;
+            if (keyframe && !gop_.empty()) ok = FlushGop(error);
+            // Packets before the first keyframe cannot be decoded.
+            if (ok && !video_done_ && (keyframe || !gop_.empty())) {
+                AVPacket* clone = av_packet_clone(packet_);
+                if (!clone) {
+                    *error = "Out of memory";
+                    ok = false;
+                } else {
+                    gop_.push_back(clone);
+                }
+            }
+        } else if (packet_->stream_index == audio_index_ && !audio_done_) {
+            ok = CopyAudioPacket(packet_, error);
+        }
+        av_packet_unref(packet_);
+        if (!ok) return false;
+    }
+
+    if (!video_done_ && !gop_.empty() && !FlushGop(error)) return false;
+    video_done_ = true;
+    return true;
+}
+
+bool Exporter::FlushGop(std::string* error) {
+    int64_t first = INT64_MAX;
+    int64_t last = INT64_MIN;
+    for (const AVPacket* packet : gop_) {
+        int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+        if (pts == AV_NOPTS_VALUE) continue;
+        first = std::min(first, pts);
+        last = std::max(last, pts);
+    }
+    if (copy_dts_delay_ < 0) {
+        const AVPacket* keyframe = gop_.front();
+        copy_dts_delay_ = keyframe->pts != AV_NOPTS_VALUE && keyframe->dts != AV_NOPTS_VALUE
+            ? std::max<int64_t>(keyframe->pts - keyframe->dts, 0)
+            : 0;
+    }
+
+    // Without cut points there is nothing to re-encode.
+    bool canReencode = boundary_parameter_set_id_ >= 0;
+    bool ok = true;
+    if (first == INT64_MAX) {
+        ok = canReencode ? ReencodeGop(error) : CopyGop(error);
+    } else if (last < copy_start_ts_) {
+        // Entirely before the cut.
+    } else if (first >= copy_end_ts_) {
+        video_done_ = true;
+    } else if (!canReencode || (first >= copy_start_ts_ && last < copy_end_ts_)) {
+        ok = CopyGop(error);
+    } else {
+        ok = ReencodeGop(error);
+    }
+    FreeGop();
+    return ok;
+}
+
+bool Exporter::CopyGop(std::string* error) {
+    for (AVPacket* packet : gop_) {
+        if (packet->pts != AV_NOPTS_VALUE) packet->pts -= copy_start_ts_;
+        if (packet->dts != AV_NOPTS_VALUE) packet->dts -= copy_start_ts_;
+        if (!WriteVideoPacket(packet, in_ctx_->streams[video_index_]->time_base, error)) return false;
+    }
+    return true;
+}
+
+bool Exporter::ReencodeGop(std::string* error) {
+    if (!OpenBoundaryEncoder(error)) return false;
+
+    // The GOP is decoded on its own; the decoder is flushed afterwards so
+    // the next boundary starts clean.
+    for (size_t i = 0; i <= gop_.size(); ++i) {
+        int ret = avcodec_send_packet(video_decoder_, i < gop_.size() ? gop_[i] : nullptr);
+        if (ret < 0 && ret != AVERROR_EOF) {
+            *error = "Failed to decode video: " + AvErrorToString(ret);
+            return false;
+        }
+        while ((ret = avcodec_receive_frame(video_decoder_, frame_)) == 0) {
+            int64_t pts = frame_->best_effort_timestamp;
+            bool keep = pts != AV_NOPTS_VALUE && pts >= copy_start_ts_ && pts < copy_end_ts_;
+            if (pts != AV_NOPTS_VALUE && pts >= copy_end_ts_) video_done_ = true;
+            if (!keep) {
+                av_frame_unref(frame_);
+                continue;
+            }
+            frame_->pts = pts - copy_start_ts_;
+            frame_->pict_type = AV_PICTURE_TYPE_NONE;
+            bool ok = EncodeBoundaryFrame(frame_, error);
+            av_frame_unref(frame_);
+            if (!ok) return false;
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+            *error = "Failed to decode video: " + AvErrorToString(ret);
+            return false;
+        }
+    }
+    avcodec_flush_buffers(video_decoder_);
+
+    bool ok = EncodeBoundaryFrame(nullptr, error);
+    avcodec_free_context(&video_encoder_);
+    return ok;
+}
+
+bool Exporter::OpenBoundaryEncoder(std::string* error) {
+    const AVCodec* codec = avcodec_find_encoder_by_name("libx264");
+    avcodec_free_context(&video_encoder_);
+    video_encoder_ = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if (!video_encoder_) {
+        *error = "Failed to open the libx264 encoder";
+        return false;
+    }
+
+    AVStream* in = in_ctx_->streams[video_index_];
+    const AVCodecParameters* par = in->codecpar;
+    AVRational frameRate = av_guess_frame_rate(in_ctx_, in, nullptr);
+    video_encoder_->width = par->width;
+    video_encoder_->height = par->height;
+    video_encoder_->pix_fmt = static_cast<AVPixelFormat>(par->format);
+    video_encoder_->sample_aspect_ratio = par->sample_aspect_ratio;
+    video_encoder_->color_range = par->color_range;
+    video_encoder_->color_primaries = par->color_primaries;
+    video_encoder_->color_trc = par->color_trc;
+    video_encoder_->colorspace = par->color_space;
+    video_encoder_->chroma_sample_location = par->chroma_location;
+    video_encoder_->time_base = in->time_base;
+    if (IsValidRate(frameRate)) video_encoder_->framerate = frameRate;
+    video_encoder_->thread_count = 0;
+    // Presentation order equals decoding order, so the re-encoded frames
+    // fit between the copied ones without reordering across the joins.
+    video_encoder_->max_b_frames = 0;
+    if (codec_options_.qscale >= 0) {
+        video_encoder_->flags |= AV_CODEC_FLAG_QSCALE;
+        video_encoder_->global_quality = FF_QP2LAMBDA * codec_options_.qscale;
+    }
+    // No AV_CODEC_FLAG_GLOBAL_HEADER: the parameter sets go in-band, as the
+    // output keeps the avcC record of the source.
+
+    AVDictionary* encoderOptions = nullptr;
+    av_dict_copy(&encoderOptions, codec_options_.videoOptions, 0);
+    std::string x264Params = "sps-id=" + std::to_string(boundary_parameter_set_id_);
+    if (const AVDictionaryEntry* params = av_dict_get(encoderOptions, "x264-params", nullptr, 0)) {
+        x264Params = std::string(params->value) + ":" + x264Params;
+    }
+    av_dict_set(&encoderOptions, "x264-params", x264Params.c_str(), 0);
+    const char* profile = X264ProfileName(par->profile);
+    if (profile && !av_dict_get(encoderOptions, "profile", nullptr, 0)) {
+        av_dict_set(&encoderOptions, "profile", profile, 0);
+    }
+
+    int ret = avcodec_open2(video_encoder_, codec, &encoderOptions);
+    av_dict_free(&encoderOptions);
+    if (ret < 0) {
+        *error = "Failed to open video encoder: " + AvErrorToString(ret);
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::EncodeBoundaryFrame(AVFrame* frame, std::string* error) {
+    int ret = avcodec_send_frame(video_encoder_, frame);
+    if (ret < 0 && ret != AVERROR_EOF) {
+        *error = "Failed to encode: " + AvErrorToString(ret);
+        return false;
+    }
+
+    while ((ret = avcodec_receive_packet(video_encoder_, out_packet_)) == 0) {
+        // libx264 writes Annex B; the copied stream uses length prefixes.
+        if (!AnnexBToLengthPrefixed(out_packet_->data, out_packet_->size, avc_config_.nalLengthSize, &nal_buffer_)) {
+            *error = "Failed to convert the re-encoded video";
+            return false;
+        }
+        int64_t pts = out_packet_->pts;
+        int flags = out_packet_->flags;
+        av_packet_unref(out_packet_);
+        if (av_new_packet(out_packet_, static_cast<int>(nal_buffer_.size())) < 0) {
+            *error = "Out of memory";
+            return false;
+        }
+        std::memcpy(out_packet_->data, nal_buffer_.data(), nal_buffer_.size());
+        out_packet_->pts = pts;
+        out_packet_->dts = pts - copy_dts_delay_;
+        out_packet_->flags = flags;
+        if (!WriteVideoPacket(out_packet_, in_ctx_->streams[video_index_]->time_base, error)) return false;
+    }
+    if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+        *error = "Failed to encode: " + AvErrorToString(ret);
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::CopyAudioPacket(AVPacket* packet, std::string* error) {
+    AVStream* in = in_ctx_->streams[audio_index_];
+    if (packet->pts == AV_NOPTS_VALUE) return true;
+    int64_t relativeUs = RelativeTime(packet->pts, in);
+    if (relativeUs < 0) return true;
+    if (start_us_ + relativeUs >= end_us_) {
+        audio_done_ = true;
+        return true;
+    }
+
+    int64_t startTime = in->start_time != AV_NOPTS_VALUE ? in->start_time : 0;
+    int64_t offset = startTime + av_rescale_q(start_us_, kMicroseconds, in->time_base);
+    packet->pts -= offset;
+    if (packet->dts != AV_NOPTS_VALUE) packet->dts -= offset;
+    packet->stream_index = audio_stream_->index;
+    packet->pos = -1;
+    av_packet_rescale_ts(packet, in->time_base, audio_stream_->time_base);
+    int ret = av_interleaved_write_frame(out_ctx_, packet);
+    if (ret < 0) {
+        *error = "Failed to write the output: " + AvErrorToString(ret);
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::WriteVideoPacket(AVPacket* packet, AVRational timeBase, std::string* error) {
+    // Both timestamps are relative to the cut, in |timeBase|.
+    if (packet->dts != AV_NOPTS_VALUE) {
+        if (last_video_dts_ != INT64_MIN && packet->dts <= last_video_dts_) packet->dts = last_video_dts_ + 1;
+        if (packet->pts != AV_NOPTS_VALUE && packet->pts < packet->dts) packet->pts = packet->dts;
+        last_video_dts_ = packet->dts;
+    }
+    int64_t relativeUs = packet->pts != AV_NOPTS_VALUE
+        ? av_rescale_q(packet->pts, timeBase, kMicroseconds)
+        : -1;
+
+    packet->stream_index = video_stream_->index;
+    packet->pos = -1;
+    av_packet_rescale_ts(packet, timeBase, video_stream_->time_base);
+    int ret = av_interleaved_write_frame(out_ctx_, packet);
+    if (ret < 0) {
+        *error = "Failed to write the output: " + AvErrorToString(ret);
+        return false;
+    }
+    if (relativeUs >= 0) ReportProgress(relativeUs);
+    return true;
+}
+
+void Exporter::FreeGop() {
+    for (AVPacket* packet : gop_) av_packet_free(&packet);
+    gop_.clear();
+}
+
+std::vector<int64_t> Exporter::PlanSegments() {
+    int cores = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    int64_t count = options_.parallelSegments > 0 ? options_.parallelSegments : cores / kCoresPerSegment;
+    // Every segment gets its own thread, so there are never more than cores.
+    count = std::min<int64_t>(count, cores);
+    if (duration_us_ > 0) count = std::min(count, duration_us_ / kMinSegmentUs);
+    if (count <= 1) return {};
+
+    // Range readers are not known to be safe to call from several threads,
+    // and GIF frames share a palette setup that cannot be joined.
+    const AVCodec* codec = FindVideoEncoder();
+    if (options_.source.read || !codec || codec->id == AV_CODEC_ID_GIF) return {};
+
+    // The candidates are taken from the demuxer index, which MP4 and
+    // Matroska always have. Its timestamps are decoding times in MP4, so
+    // they only pick the cuts.
+    AVStream* stream = in_ctx_->streams[video_index_];
+    int64_t startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    std::vector<std::pair<int64_t, int64_t>> entries;
+    int entryCount = avformat_index_get_entries_count(stream);
+    for (int i = 0; i < entryCount; ++i) {
+        const AVIndexEntry* entry = avformat_index_get_entry(stream, i);
+        if (!entry || !(entry->flags & AVINDEX_KEYFRAME)) continue;
+        int64_t us = av_rescale_q_rnd(entry->timestamp - startTime, stream->time_base, kMicroseconds, AV_ROUND_DOWN);
+        if (us > start_us_ && us < start_us_ + duration_us_) entries.emplace_back(us, entry->timestamp);
+    }
+    std::sort(entries.begin(), entries.end());
+    std::vector<int64_t> keyframes;
+    for (const auto& entry : entries) keyframes.push_back(entry.first);
+    std::vector<int64_t> cuts =
+        SplitAtKeyframes(keyframes, start_us_, duration_us_, static_cast<int>(count), kMinSegmentUs);
+
+    // The workers split the frames by presentation time, and with B-frames
+    // a keyframe is shown after the frames decoded just before it. So every
+    // cut moves to when its keyframe is shown: the previous segment decodes
+    // the frames in between anyway. Rounding down keeps the keyframe in the
+    // segment that seeks to it.
+    std::vector<int64_t> starts = {start_us_};
+    for (size_t i = 1; i < cuts.size(); ++i) {
+        auto entry = std::lower_bound(entries.begin(), entries.end(), std::make_pair(cuts[i], INT64_MIN));
+        int64_t pts = KeyframePresentationTime(entry->second);
+        if (pts == AV_NOPTS_VALUE) break;
+        int64_t us = av_rescale_q_rnd(pts - startTime, stream->time_base, kMicroseconds, AV_ROUND_DOWN);
+        if (us > starts.back() && us < start_us_ + duration_us_) starts.push_back(us);
+    }
+    int64_t formatStart = in_ctx_->start_time != AV_NOPTS_VALUE ? in_ctx_->start_time : 0;
+    av_seek_frame(in_ctx_, -1, formatStart, AVSEEK_FLAG_BACKWARD);
+    return starts;
+}
+
+// Seeks to the keyframe at |indexTimestamp| of the video index and returns
+// its presentation timestamp, or AV_NOPTS_VALUE if it cannot be read.
+int64_t Exporter::KeyframePresentationTime(int64_t indexTimestamp) {
+    if (av_seek_frame(in_ctx_, video_index_, indexTimestamp, AVSEEK_FLAG_BACKWARD) < 0) return AV_NOPTS_VALUE;
+    while (av_read_frame(in_ctx_, packet_) >= 0) {
+        if (packet_->stream_index != video_index_) {
+            av_packet_unref(packet_);
+            continue;
+        }
+        bool keyframe = packet_->flags & AV_PKT_FLAG_KEY;
+        int64_t pts = packet_->pts;
+        av_packet_unref(packet_);
+        return keyframe ? pts : AV_NOPTS_VALUE;
+    }
+    return AV_NOPTS_VALUE;
+}
+
+bool Exporter::RunSegmented(const std::vector<int64_t>& segmentStarts, std::string* error) {
+    size_t count = segmentStarts.size();
+    // Only the segment workers decode video.
+    avcodec_free_context(&video_decoder_);
+
+    // The video stream comes first, like in a single pass; its parameters
+    // are known once the segments are encoded.
+    video_stream_ = avformat_new_stream(out_ctx_, nullptr);
+    if (!video_stream_) {
+        *error = "Failed to create the video stream";
+        return false;
+    }
+
+    SegmentSettings settings;
+    settings.globalHeader = (out_ctx_->oformat->flags & AVFMT_GLOBALHEADER) != 0;
+    settings.concurrentSegments = static_cast<int>(count);
+
+    // The workers hold references to their options and callbacks, so all
+    // of them are created before the first worker starts.
+    std::vector<std::unique_ptr<ScratchFile>> files(count);
+    std::vector<ExportVideoOptions> segmentOptions(count, options_);
+    std::vector<ExportProgressCallback> callbacks(count);
+    std::vector<int64_t> lengths(count);
+    std::vector<double> progress(count, 0.0);
+    std::mutex progressMutex;
+    for (size_t i = 0; i < count; ++i) {
+        files[i] = ScratchFile::Create("export-segment", error);
+        if (!files[i]) return false;
+
+        // NUT keeps the encoder time base and any codec, so the packets
+        // come back out exactly as they were encoded.
+        ExportVideoOptions& segment = segmentOptions[i];
+        segment.startTime = segmentStarts[i] / static_cast<double>(AV_TIME_BASE);
+        if (i + 1 < count) segment.endTime = segmentStarts[i + 1] / static_cast<double>(AV_TIME_BASE);
+        segment.codecArgs.push_back("-an");
+        segment.outputFormat = "nut";
+        segment.outputPath.clear();
+        segment.outputFd = files[i]->fd();
+        segment.allowStreamCopy = false;
+        segment.parallelSegments = 1;
+
+        lengths[i] = (i + 1 < count ? segmentStarts[i + 1] : start_us_ + duration_us_) - segmentStarts[i];
+        if (on_progress_) {
+            callbacks[i] = [&, i](double value) {
+                std::lock_guard<std::mutex> lock(progressMutex);
+                progress[i] = value;
+                double doneUs = 0;
+                for (size_t j = 0; j < count; ++j) doneUs += progress[j] * lengths[j];
+                ReportProgress(static_cast<int64_t>(doneUs));
+            };
+        }
+    }
+
+    std::vector<std::string> errors(count);
+    std::vector<char> succeeded(count, 0);
+    std::vector<std::thread> workers;
+    workers.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        workers.emplace_back([&, i]() {
+            Exporter exporter(segmentOptions[i], callbacks[i], &settings);
+            succeeded[i] = exporter.Run(nullptr, &errors[i]);
+        });
+    }
+
+    // Meanwhile the audio is encoded on this thread.
+    in_ctx_->streams[video_index_]->discard = AVDISCARD_ALL;
+    video_done_ = true;
+    hold_audio_ = true;
+    bool ok = SetupAudio(error) && Transcode(error);
+    hold_audio_ = false;
+    for (std::thread& worker : workers) worker.join();
+    if (!ok) return false;
+    for (size_t i = 0; i < count; ++i) {
+        if (!succeeded[i]) {
+            *error = "Segment " + std::to_string(i + 1) + " failed: " + errors[i];
+            return false;
+        }
+    }
+
+    return MergeSegments(files, segmentStarts, error);
+}
+
+bool Exporter::MergeSegments(
+    const std::vector<std::unique_ptr<ScratchFile>>& files,
+    const std::vector<int64_t>& segmentStarts,
+    std::string* error) {
+    std::vector<std::unique_ptr<MediaInput>> inputs;
+    for (const auto& file : files) {
+        MediaSource source;
+        source.path = file->path();
+        source.extension = ".nut";
+        std::unique_ptr<MediaInput> input = MediaInput::Open(source, error);
+        if (!input) return false;
+        if (input->format_context()->nb_streams != 1) {
+            *error = "Unexpected streams in an encoded segment";
+            return false;
+        }
+        inputs.push_back(std::move(input));
+    }
+
+    // Every segment was encoded with the same settings, so the stream
+    // header of the first one describes them all. Joining is only lossless
+    // if that holds.
+    const AVStream* first = inputs[0]->format_context()->streams[0];
+    for (const auto& input : inputs) {
+        const AVCodecParameters* par = input->format_context()->streams[0]->codecpar;
+        if (par->codec_id != first->codecpar->codec_id ||
+            par->width != first->codecpar->width ||
+            par->height != first->codecpar->height ||
+            par->extradata_size != first->codecpar->extradata_size ||
+            (par->extradata_size > 0 &&
+             std::memcmp(par->extradata, first->codecpar->extradata, par->extradata_size) != 0)) {
+            *error = "The encoded segments have different stream headers";
+            return false;
+        }
+    }
+    if (avcodec_parameters_copy(video_stream_->codecpar, first->codecpar) < 0) {
+        *error = "Failed to create the video stream";
+        return false;
+    }
+    video_stream_->codecpar->codec_tag = 0;
+    video_stream_->time_base = first->time_base;
+    if (!WriteHeader(error)) return false;
+
+    // Each segment starts at 0; it is shifted to where it was cut from the
+    // source. The held audio is written in between by decoding timestamp.
+    AVRational timeBase = first->time_base;
+    size_t nextAudio = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        AVFormatContext* ctx = inputs[i]->format_context();
+        AVRational segmentTimeBase = ctx->streams[0]->time_base;
+        int64_t offset = av_rescale_q(segmentStarts[i] - start_us_, kMicroseconds, timeBase);
+
+        int ret;
+        while ((ret = av_read_frame(ctx, packet_)) >= 0) {
+            av_packet_rescale_ts(packet_, segmentTimeBase, timeBase);
+            if (packet_->pts != AV_NOPTS_VALUE) packet_->pts += offset;
+            if (packet_->dts != AV_NOPTS_VALUE) packet_->dts += offset;
+
+            int64_t videoTs = packet_->dts != AV_NOPTS_VALUE ? packet_->dts : packet_->pts;
+            bool ok = true;
+            while (ok && nextAudio < held_audio_.size() &&
+                   (videoTs == AV_NOPTS_VALUE ||
+                    av_compare_ts(held_audio_[nextAudio]->dts, audio_encoder_->time_base, videoTs, timeBase) <= 0)) {
+                ok = WriteHeldAudioPacket(held_audio_[nextAudio++], error);
+            }
+            ok = ok && WriteVideoPacket(packet_, timeBase, error);
+            av_packet_unref(packet_);
+            if (!ok) return false;
+        }
+        if (ret != AVERROR_EOF) {
+            *error = "Failed to read an encoded segment: " + AvErrorToString(ret);
+            return false;
+        }
+    }
+    while (nextAudio < held_audio_.size()) {
+        if (!WriteHeldAudioPacket(held_audio_[nextAudio++], error)) return false;
+    }
+    return true;
+}
+
+bool Exporter::WriteHeldAudioPacket(AVPacket* packet, std::string* error) {
+    av_packet_rescale_ts(packet, audio_encoder_->time_base, audio_stream_->time_base);
+    packet->stream_index = audio_stream_->index;
+    int ret = av_interleaved_write_frame(out_ctx_, packet);
+    if (ret < 0) {
+        *error = "Failed to write the output: " + AvErrorToString(ret);
+        return false;
+    }
+    return true;
+}
+
+void Exporter::ReportProgress(int64_t relativeUs) {
+    if (!on_progress_) return;
+
+    double progress;
+    if (duration_us_ > 0) {
+        progress = std::clamp(static_cast<double>(relativeUs) / duration_us_, 0.0, 1.0);
+    } else {
+        // Unknown duration: report how much of the input was read.
+        int64_t position = in_ctx_->pb ? avio_tell(in_ctx_->pb) : -1;
+        if (position < 0 || input_->size() <= 0) return;
+        progress = std::clamp(static_cast<double>(position) / input_->size(), 0.0, 1.0);
+    }
+    // Every frame is measured, but only changes of 0.1% are reported so
+    // long exports do not flood the event channel.
+    if (progress - last_progress_ < 0.001) return;
+    last_progress_ = progress;
+    on_progress_(progress);
+}
+
+int Exporter::WritePacket(void* opaque,
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+                          const
+#endif
+                          uint8_t* buffer, int bufferSize) {
+    auto* self = static_cast<Exporter*>(opaque);
+    if (self->output_fd_ >= 0) return self->WriteToFile(buffer, bufferSize);
+
+    size_t end = self->output_position_ + static_cast<size_t>(bufferSize);
+    if (end > self->output_->size()) self->output_->resize(end);
+    std::memcpy(self->output_->data() + self->output_position_, buffer, bufferSize);
+    self->output_position_ = end;
+    return bufferSize;
+}
+
+int Exporter::WriteToFile(const uint8_t* buffer, int bufferSize) {
+    int written = 0;
+    while (written < bufferSize) {
+        ssize_t ret = pwrite(output_fd_, buffer + written, bufferSize - written,
+                             static_cast<off_t>(output_position_ + written));
+        if (ret < 0 && errno == EINTR) continue;
+        // Pipes and sockets cannot pwrite; fall back to sequential writes,
+        // which works as long as the muxer never seeks back.
+        if (ret < 0 && errno == ESPIPE) ret = write(output_fd_, buffer + written, bufferSize - written);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) return AVERROR(ret < 0 ? errno : EIO);
+        written += static_cast<int>(ret);
+    }
+    output_position_ += written;
+    output_file_size_ = std::max(output_file_size_, output_position_);
+    return written;
+}
+
+size_t Exporter::output_size() const {
+    return output_fd_ >= 0 ? output_file_size_ : output_->size();
+}
+
+int64_t Exporter::SeekOutput(void* opaque, int64_t offset, int whence) {
+    auto* self = static_cast<Exporter*>(opaque);
+    whence &= ~AVSEEK_FORCE;
+    int64_t size = static_cast<int64_t>(self->output_size());
+    if (whence == AVSEEK_SIZE) return size;
+
+    int64_t target;
+    switch (whence) {
+        case SEEK_SET: target = offset; break;
+        case SEEK_CUR: target = static_cast<int64_t>(self->output_position_) + offset; break;
+        case SEEK_END: target = size + offset; break;
+        default: return AVERROR(EINVAL);
+    }
+    if (target < 0) return AVERROR(EINVAL);
+
+    self->output_position_ = static_cast<size_t>(target);
+    return target;
+}
+
+}  // namespace
+
+std::vector<int64_t> SplitAtKeyframes(
+    const std::vector<int64_t>& keyframesUs,
+    int64_t startUs,
+    int64_t durationUs,
+    int count,
+    int64_t minSegmentUs) {
+    std::vector<int64_t> segmentStarts{startUs};
+    for (int i = 1; i < count && !keyframesUs.empty(); ++i) {
+        int64_t target = startUs + durationUs * i / count;
+        auto next = std::lower_bound(keyframesUs.begin(), keyframesUs.end(), target);
+        if (next == keyframesUs.end() || (next != keyframesUs.begin() && target - *(next - 1) < *next - target)) {
+            --next;
+        }
+        if (*next - segmentStarts.back() < minSegmentUs / 2 || startUs + durationUs - *next < minSegmentUs / 2) {
+            continue;
+        }
+        segmentStarts.push_back(*next);
+    }
+    return segmentStarts;
+}
+
+bool ExportVideo(
+    const ExportVideoOptions& options,
+    std::vector<uint8_t>* output,
+    const ExportProgressCallback& onProgress,
+    std::string* error) {
+    Exporter exporter(options, onProgress);
+    return exporter.Run(output, error);
+}
+
+}  // namespace pro_video_editor
@@ -0,0 +1,103 @@
+// src/export_video.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "media_input.h"
+
+namespace pro_video_editor {
+
+// Everything an export needs, mirroring the arguments of the `exportVideo`
+// method call.
+struct ExportVideoOptions {
+    // The video to render.
+    MediaSource source;
+
+    // PNG drawn over every frame, scaled to the video size. Not owned.
+    const uint8_t* imageData = nullptr;
+    size_t imageSize = 0;
+
+    // Encoder and muxer options in ffmpeg CLI syntax, e.g. `-c:v libx264`.
+    std::vector<std::string> codecArgs;
+
+    // Output container, e.g. "mp4", "mkv" or "gif".
+    std::string outputFormat = "mp4";
+
+    // Trim range in seconds. Negative values mean "not set".
+    double startTime = -1;
+    double endTime = -1;
+
+    // Duration of the source video, used to compute the progress.
+    int64_t videoDurationMs = 0;
+
+    // Extra libavfilter chain applied after the color matrices.
+    std::string filters;
+
+    // 4x5 color matrices (20 values each), applied in order.
+    std::vector<std::vector<double>> colorMatrices;
+
+    // Lets exports that only trim or remux copy the encoded video instead of
+    // re-encoding it: every GOP inside the cut is copied as is and only the
+    // partial GOPs at the two cut points are re-encoded, so the cut stays
+    // frame accurate. Used when there are no filters, color matrices or
+    // visible overlay and the requested codecs and pixel format match the
+    // source. The copied part keeps the source encoding: quality and
+    // bitrate options such as -crf, -preset, -b:v and -qscale only apply
+    // to the re-encoded boundary frames and are otherwise ignored, which
+    // is why copying has to be asked for.
+    bool allowStreamCopy = false;
+
+    // Splits the export at source keyframes into this many segments that
+    // are decoded, filtered and encoded at the same time, then joins the
+    // encoded segments into the output without re-encoding them. 0 picks
+    // a count from the CPU cores, 1 exports in a single pass; larger counts
+    // are limited to the number of cores. Segments are at least 10 seconds
+    // long, and each one starts with a keyframe and its own rate control,
+    // so bitrate targets apply per segment.
+    int parallelSegments = 1;
+
+    // Writes the result to this file instead of memory. The file is created
+    // or truncated, and removed again if the export fails.
+    std::string outputPath;
+
+    // Writes the result to this open, writable descriptor instead of memory.
+    // Used when |outputPath| is empty; the descriptor is not closed and
+    // should be seekable for containers that rewrite their header (mp4).
+    int outputFd = -1;
+};
+
+// Picks the starts of the parallel segments of [startUs, startUs +
+// durationUs): the keyframe closest to each of |count| even splits, skipping
+// keyframes that would leave a segment under half of |minSegmentUs|.
+// |keyframesUs| must be sorted. The first start is always |startUs|.
+std::vector<int64_t> SplitAtKeyframes(
+    const std::vector<int64_t>& keyframesUs,
+    int64_t startUs,
+    int64_t durationUs,
+    int count,
+    int64_t minSegmentUs);
+
+// Receives the export progress from 0.0 to 1.0.
+using ExportProgressCallback = std::function<void(double)>;
+
+// Renders |options| in-process: decode -> filter graph -> encode -> mux.
+//
+// The same filter graph as the Android implementation is built (color
+// matrices, custom filters and the overlay image), but no temp files are
+// written; the result is muxed into |output|, or straight to
+// |options.outputPath| / |options.outputFd| when one is set, in which case
+// |output| may be null and memory use does not grow with the video length.
+// |onProgress| is called after every encoded video frame, from the calling
+// thread or, with |options.parallelSegments|, from the segment workers (one
+// at a time).
+bool ExportVideo(
+    const ExportVideoOptions& options,
+    std::vector<uint8_t>* output,
+    const ExportProgressCallback& onProgress,
+    std::string* error);
+
+}  // namespace pro_video_editor
@@ -0,0 +1,171 @@
+#include "ffmpeg_cli_thumbnailer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <string>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace pro_video_editor {
+
+namespace {
+
+// Descriptor the input is mapped to in the child.
+constexpr int kChildInputFd = 3;
+
+// Minimum size of the buffer the image is read into. Most thumbnails fit, so
+// the buffer is rarely grown while reading.
+constexpr size_t kMinImageCapacity = 64 * 1024;
+constexpr size_t kMaxExpectedImageSize = 1024 * 1024;
+
+// image2pipe cannot infer the encoder from a file name.
+std::string ImageCodecFor(const std::string& imageExt) {
+    std::string ext = imageExt.empty() || imageExt[0] != '.' ? imageExt : imageExt.substr(1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext == "jpg" || ext == "jpeg") return "mjpeg";
+    if (ext == "webp") return "libwebp";
+    if (ext == "tif") return "tiff";
+    return ext;
+}
+
+// Owns the descriptors and spawn actions of one ffmpeg run.
+class SpawnedFFmpeg {
+public:
+    ~SpawnedFFmpeg() {
+        if (read_fd_ >= 0) close(read_fd_);
+        if (write_fd_ >= 0) close(write_fd_);
+        if (input_dup_ >= 0) close(input_dup_);
+        if (actions_initialized_) posix_spawn_file_actions_destroy(&actions_);
+        if (pid_ > 0) Wait();
+    }
+
+    bool Start(const FFmpegCliInput& input, std::vector<std::string> args) {
+        // O_CLOEXEC keeps the pipe out of other concurrently spawned
+        // children; otherwise their copy of the write end delays EOF here.
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) != 0) return false;
+        read_fd_ = fds[0];
+        write_fd_ = fds[1];
+
+        if (posix_spawn_file_actions_init(&actions_) != 0) return false;
+        actions_initialized_ = true;
+        posix_spawn_file_actions_addopen(&actions_, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_adddup2(&actions_, write_fd_, STDOUT_FILENO);
+        posix_spawn_file_actions_addopen(&actions_, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+        std::string inputPath = input.path;
+        if (input.fd >= 0) {
+            // dup2 onto a different number clears FD_CLOEXEC in the child,
+            // so only this child sees the input.
+            int fd = input.fd;
+            if (fd == kChildInputFd || fd == STDOUT_FILENO) {
+                input_dup_ = fcntl(fd, F_DUPFD_CLOEXEC, kChildInputFd + 1);
+                if (input_dup_ < 0) return false;
+                fd = input_dup_;
+            }
+            posix_spawn_file_actions_adddup2(&actions_, fd, kChildInputFd);
+            inputPath = "/proc/self/fd/" + std::to_string(kChildInputFd);
+        }
+
+        for (std::string& arg : args) {
+            if (arg == "{input}") arg = inputPath;
+        }
+        std::vector<char*> argv;
+        for (std::string& arg : args) argv.push_back(&arg[0]);
+        argv.push_back(nullptr);
+
+        if (posix_spawnp(&pid_, argv[0], &actions_, nullptr, argv.data(), environ) != 0) {
+            pid_ = -1;
+            return false;
+        }
+        close(write_fd_);
+        write_fd_ = -1;
+        return true;
+    }
+
+    // Reads stdout until EOF. |output| keeps its capacity between reads.
+    bool ReadOutput(std::vector<uint8_t>* output, size_t expectedSize) {
+        output->resize(std::max(expectedSize, kMinImageCapacity));
+        size_t size = 0;
+        while (true) {
+            if (size == output->size()) output->resize(output->size() * 2);
+            ssize_t ret = read(read_fd_, output->data() + size, output->size() - size);
+            if (ret < 0 && errno == EINTR) continue;
+            if (ret < 0) {
+                output->clear();
+                return false;
+            }
+            if (ret == 0) break;
+            size += static_cast<size_t>(ret);
+        }
+        output->resize(size);
+        return true;
+    }
+
+    // Returns true if the child exited with status 0.
+    bool Wait() {
+        int status = 0;
+        pid_t ret;
+        do {
+            ret = waitpid(pid_, &status, 0);
+        } while (ret < 0 && errno == EINTR);
+        pid_ = -1;
+        return ret > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+private:
+    posix_spawn_file_actions_t actions_;
+    bool actions_initialized_ = false;
+    int read_fd_ = -1;
+    int write_fd_ = -1;
+    int input_dup_ = -1;
+    pid_t pid_ = -1;
+};
+
+}  // namespace
+
+bool ExtractThumbnailWithFFmpegCli(
+    const FFmpegCliInput& input,
+    int64_t timestampMs,
+    int width,
+    const std::string& imageExt,
+    std::vector<uint8_t>* imageBytes) {
+
+    char timestamp[32];
+    std::snprintf(timestamp, sizeof(timestamp), "%.3f", timestampMs / 1000.0);
+
+    // Assume `ffmpeg` is in system PATH on Linux
+    std::vector<std::string> args = {
+        "ffmpeg", "-nostdin", "-loglevel", "error",
+        "-ss", timestamp,
+        "-i", "{input}",
+        "-frames:v", "1",
+        "-vf", "scale=" + std::to_string(width) + ":-2",
+        "-f", "image2pipe",
+        "-c:v", ImageCodecFor(imageExt),
+        "pipe:1",
+    };
+
+    SpawnedFFmpeg ffmpeg;
+    if (!ffmpeg.Start(input, std::move(args))) return false;
+
+    // A quarter byte per pixel of a square frame covers most compressed
+    // images, so the buffer is usually allocated once.
+    size_t side = static_cast<size_t>(std::max(width, 1));
+    size_t expectedSize = std::min(side * side / 4, kMaxExpectedImageSize);
+    bool read = ffmpeg.ReadOutput(imageBytes, expectedSize);
+    bool exited = ffmpeg.Wait();
+    if (!read || !exited) {
+        imageBytes->clear();
+        return false;
+    }
+    return !imageBytes->empty();
+}
+
+}  // namespace pro_video_editor
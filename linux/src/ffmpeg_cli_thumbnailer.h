@@ -0,0 +1,34 @@
+// src/ffmpeg_cli_thumbnailer.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pro_video_editor {
+
+// The video handed to the `ffmpeg` executable: a file |path|, or an open
+// descriptor |fd| (e.g. a memfd holding the video bytes) that the child
+// reads through /proc/self/fd. |fd| wins when both are set; it is not
+// closed.
+struct FFmpegCliInput {
+    std::string path;
+    int fd = -1;
+};
+
+// Extracts a single thumbnail by spawning the `ffmpeg` executable found in
+// PATH. This is the fallback for inputs or image formats that the in-process
+// ThumbnailEngine cannot handle.
+//
+// No shell is involved and nothing is written to disk: the encoded image is
+// read from the child's stdout (`-f image2pipe`) straight into |imageBytes|.
+// |imageExt| is the output extension including the dot (e.g. ".jpeg") and
+// selects the image encoder.
+bool ExtractThumbnailWithFFmpegCli(
+    const FFmpegCliInput& input,
+    int64_t timestampMs,
+    int width,
+    const std::string& imageExt,
+    std::vector<uint8_t>* imageBytes);
+
+}  // namespace pro_video_editor
@@ -0,0 +1,148 @@
+#include "h264_bitstream.h"
+
+#include <algorithm>
+
+namespace pro_video_editor {
+
+namespace {
+
+// Reads Exp-Golomb codes from the start of a NAL unit payload, skipping
+// emulation prevention bytes.
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            if (i >= 2 && data[i] == 3 && data[i - 1] == 0 && data[i - 2] == 0) continue;
+            bytes_.push_back(data[i]);
+        }
+    }
+
+    bool ReadBit(int* bit) {
+        if (position_ >= bytes_.size() * 8) return false;
+        *bit = (bytes_[position_ / 8] >> (7 - position_ % 8)) & 1;
+        ++position_;
+        return true;
+    }
+
+    bool ReadUnsignedExpGolomb(int* value) {
+        int zeros = 0;
+        int bit = 0;
+        while (ReadBit(&bit) && bit == 0) {
+            if (++zeros > 31) return false;
+        }
+        if (bit != 1) return false;
+        uint32_t result = 1;
+        for (int i = 0; i < zeros; ++i) {
+            if (!ReadBit(&bit)) return false;
+            result = (result << 1) | bit;
+        }
+        *value = static_cast<int>(result - 1);
+        return true;
+    }
+
+private:
+    std::vector<uint8_t> bytes_;
+    size_t position_ = 0;
+};
+
+// Reads |count| NAL units with a 2 byte length each, passing the payload
+// after the NAL header to |onUnit|.
+template <typename OnUnit>
+bool ReadParameterSets(const uint8_t* data, size_t size, size_t* offset, int count, OnUnit onUnit) {
+    for (int i = 0; i < count; ++i) {
+        if (*offset + 2 > size) return false;
+        size_t length = (data[*offset] << 8) | data[*offset + 1];
+        *offset += 2;
+        if (length < 1 || *offset + length > size) return false;
+        if (!onUnit(data + *offset + 1, length - 1)) return false;
+        *offset += length;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool ParseAvcDecoderConfig(const uint8_t* data, size_t size, AvcDecoderConfig* config) {
+    // configurationVersion is always 1; Annex B starts with a start code.
+    if (!data || size < 7 || data[0] != 1) return false;
+
+    AvcDecoderConfig result;
+    result.nalLengthSize = (data[4] & 0x03) + 1;
+    if (result.nalLengthSize == 3) return false;
+
+    size_t offset = 5;
+    int spsCount = data[offset++] & 0x1f;
+    // The SPS id follows profile_idc, the constraint flags and level_idc.
+    bool ok = ReadParameterSets(data, size, &offset, spsCount, [&](const uint8_t* payload, size_t length) {
+        if (length < 4) return false;
+        BitReader reader(payload + 3, length - 3);
+        int id = 0;
+        if (!reader.ReadUnsignedExpGolomb(&id)) return false;
+        result.spsIds.push_back(id);
+        return true;
+    });
+    if (!ok || offset >= size) return false;
+
+    int ppsCount = data[offset++];
+    ok = ReadParameterSets(data, size, &offset, ppsCount, [&](const uint8_t* payload, size_t length) {
+        BitReader reader(payload, length);
+        int id = 0;
+        if (!reader.ReadUnsignedExpGolomb(&id)) return false;
+        result.ppsIds.push_back(id);
+        return true;
+    });
+    if (!ok) return false;
+
+    *config = std::move(result);
+    return true;
+}
+
+int UnusedParameterSetId(const AvcDecoderConfig& config) {
+    for (int id = 0; id < 32; ++id) {
+        if (std::find(config.spsIds.begin(), config.spsIds.end(), id) == config.spsIds.end() &&
+            std::find(config.ppsIds.begin(), config.ppsIds.end(), id) == config.ppsIds.end()) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+bool AnnexBToLengthPrefixed(
+    const uint8_t* data,
+    size_t size,
+    int nalLengthSize,
+    std::vector<uint8_t>* output) {
+    output->clear();
+    if (nalLengthSize != 1 && nalLengthSize != 2 && nalLengthSize != 4) return false;
+
+    // Returns the offset of the next 00 00 01 at or after |from|, or |size|.
+    auto findStartCode = [&](size_t from) {
+        for (size_t i = from; i + 3 <= size; ++i) {
+            if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) return i;
+        }
+        return size;
+    };
+
+    size_t start = findStartCode(0);
+    if (start == size) return false;
+    while (start < size) {
+        size_t unitStart = start + 3;
+        size_t next = findStartCode(unitStart);
+        // Trailing zeros belong to the next 4 byte start code.
+        size_t unitEnd = next;
+        while (unitEnd > unitStart && data[unitEnd - 1] == 0) --unitEnd;
+
+        size_t length = unitEnd - unitStart;
+        if (length > 0) {
+            if (nalLengthSize < 4 && length >= (size_t{1} << (8 * nalLengthSize))) return false;
+            for (int i = nalLengthSize - 1; i >= 0; --i) {
+                output->push_back(static_cast<uint8_t>(length >> (8 * i)));
+            }
+            output->insert(output->end(), data + unitStart, data + unitEnd);
+        }
+        start = next;
+    }
+    return !output->empty();
+}
+
+}  // namespace pro_video_editor
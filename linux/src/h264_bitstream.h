@@ -0,0 +1,36 @@
+// src/h264_bitstream.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pro_video_editor {
+
+// H.264 as stored in MP4 and Matroska: parameter sets in an avcC record
+// (ISO/IEC 14496-15) and NAL units prefixed with their length.
+struct AvcDecoderConfig {
+    // Bytes of every NAL unit length prefix (1, 2 or 4).
+    int nalLengthSize = 4;
+    std::vector<int> spsIds;
+    std::vector<int> ppsIds;
+};
+
+// Parses an avcC record. Returns false for Annex B extradata or a
+// malformed record.
+bool ParseAvcDecoderConfig(const uint8_t* data, size_t size, AvcDecoderConfig* config);
+
+// Returns the lowest id (0-31) used by neither an SPS nor a PPS of
+// |config|, or -1. Parameter sets sent in-band under that id cannot replace
+// the ones of the copied stream.
+int UnusedParameterSetId(const AvcDecoderConfig& config);
+
+// Rewrites Annex B NAL units (start code delimited, as encoders emit them)
+// as units prefixed with a |nalLengthSize| byte big-endian length.
+bool AnnexBToLengthPrefixed(
+    const uint8_t* data,
+    size_t size,
+    int nalLengthSize,
+    std::vector<uint8_t>* output);
+
+}  // namespace pro_video_editor
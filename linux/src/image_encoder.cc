@@ -0,0 +1,201 @@
+#include "image_encoder.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+
+namespace pro_video_editor {
+
+namespace {
+
+struct ImageEncoderSpec {
+    AVCodecID codec_id;
+    AVPixelFormat pix_fmt;
+};
+
+bool GetImageEncoderSpec(const std::string& format, ImageEncoderSpec* spec) {
+    if (format == "jpeg" || format == "jpg") {
+        *spec = {AV_CODEC_ID_MJPEG, AV_PIX_FMT_YUVJ420P};
+    } else if (format == "png") {
+        *spec = {AV_CODEC_ID_PNG, AV_PIX_FMT_RGB24};
+    } else if (format == "webp") {
+        *spec = {AV_CODEC_ID_WEBP, AV_PIX_FMT_YUV420P};
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Maps a 1-100 JPEG quality to the MJPEG quantizer (2 = best, 31 = worst).
+int JpegQuantizer(int quality) {
+    if (quality == ImageEncoder::kDefaultQuality) return 3;
+    quality = std::clamp(quality, 1, 100);
+    return 2 + (100 - quality) * 29 / 99;
+}
+
+}  // namespace
+
+ImageEncoder::ImageEncoder() {
+    packet_ = av_packet_alloc();
+}
+
+ImageEncoder::~ImageEncoder() {
+    Reset();
+    sws_freeContext(scale_ctx_);
+    av_packet_free(&packet_);
+}
+
+bool ImageEncoder::Supports(const std::string& format) {
+    ImageEncoderSpec spec;
+    return GetImageEncoderSpec(format, &spec) && avcodec_find_encoder(spec.codec_id) != nullptr;
+}
+
+void ImageEncoder::Reset() {
+    avcodec_free_context(&codec_ctx_);
+    av_frame_free(&frame_);
+    format_.clear();
+    width_ = 0;
+    height_ = 0;
+    quality_ = kDefaultQuality;
+    next_pts_ = 0;
+}
+
+bool ImageEncoder::Prepare(const std::string& format, int width, int height, int quality) {
+    if (codec_ctx_ && format == format_ && width == width_ && height == height_ && quality == quality_) {
+        return true;
+    }
+    Reset();
+
+    ImageEncoderSpec spec;
+    if (!packet_ || !GetImageEncoderSpec(format, &spec)) return false;
+    const AVCodec* encoder = avcodec_find_encoder(spec.codec_id);
+    if (!encoder) return false;
+
+    codec_ctx_ = avcodec_alloc_context3(encoder);
+    frame_ = av_frame_alloc();
+    if (!codec_ctx_ || !frame_) {
+        Reset();
+        return false;
+    }
+
+    codec_ctx_->width = width;
+    codec_ctx_->height = height;
+    codec_ctx_->pix_fmt = spec.pix_fmt;
+    codec_ctx_->time_base = AVRational{1, 25};
+    if (spec.codec_id == AV_CODEC_ID_MJPEG) {
+        // Fixed quantizer instead of the default 200 kb/s bitrate, which is
+        // far too low for a single image.
+        codec_ctx_->color_range = AVCOL_RANGE_JPEG;
+        codec_ctx_->flags |= AV_CODEC_FLAG_QSCALE;
+        codec_ctx_->global_quality = FF_QP2LAMBDA * JpegQuantizer(quality);
+    } else if (spec.codec_id == AV_CODEC_ID_WEBP && quality != kDefaultQuality) {
+        av_opt_set_double(codec_ctx_->priv_data, "quality", std::clamp(quality, 1, 100), 0);
+    }
+    if (avcodec_open2(codec_ctx_, encoder, nullptr) < 0) {
+        Reset();
+        return false;
+    }
+
+    frame_->format = spec.pix_fmt;
+    frame_->width = width;
+    frame_->height = height;
+    if (av_frame_get_buffer(frame_, 0) < 0) {
+        Reset();
+        return false;
+    }
+
+    format_ = format;
+    width_ = width;
+    height_ = height;
+    quality_ = quality;
+    return true;
+}
+
+bool ImageEncoder::Convert(
+    const uint8_t* const srcData[],
+    const int srcLinesize[],
+    int srcWidth,
+    int srcHeight,
+    int srcFormat) {
+    // The encoder may still reference the previous image.
+    if (av_frame_make_writable(frame_) < 0) return false;
+
+    scale_ctx_ = sws_getCachedContext(
+        scale_ctx_,
+        srcWidth, srcHeight, static_cast<AVPixelFormat>(srcFormat),
+        width_, height_, codec_ctx_->pix_fmt,
+        SWS_BICUBIC, nullptr, nullptr, nullptr);
+    if (!scale_ctx_) return false;
+    sws_scale(scale_ctx_, srcData, srcLinesize, 0, srcHeight, frame_->data, frame_->linesize);
+    return true;
+}
+
+bool ImageEncoder::Encode(std::vector<uint8_t>* imageBytes) {
+    frame_->pts = next_pts_++;
+    frame_->quality = codec_ctx_->global_quality;
+    if (avcodec_send_frame(codec_ctx_, frame_) < 0) {
+        Reset();
+        return false;
+    }
+
+    // Image encoders have no delay, so the packet is ready without
+    // draining, which would end the encoder and defeat reusing it.
+    int ret = avcodec_receive_packet(codec_ctx_, packet_);
+    if (ret < 0) {
+        Reset();
+        return false;
+    }
+
+    // Reuses the capacity of |imageBytes| when the caller passes the same
+    // vector again.
+    imageBytes->assign(packet_->data, packet_->data + packet_->size);
+    av_packet_unref(packet_);
+    return true;
+}
+
+bool ImageEncoder::EncodeFrame(
+    const AVFrame* frame,
+    int width,
+    int height,
+    const std::string& format,
+    int quality,
+    std::vector<uint8_t>* imageBytes) {
+    if (!Prepare(format, width, height, quality)) return false;
+    if (!Convert(frame->data, frame->linesize, frame->width, frame->height, frame->format)) return false;
+    return Encode(imageBytes);
+}
+
+bool ImageEncoder::EncodeRgb(
+    const uint8_t* rgb,
+    int width,
+    int height,
+    const std::string& format,
+    int quality,
+    std::vector<uint8_t>* imageBytes) {
+    if (!Prepare(format, width, height, quality)) return false;
+    const uint8_t* srcData[4] = {rgb, nullptr, nullptr, nullptr};
+    int srcLinesize[4] = {width * 3, 0, 0, 0};
+    if (!Convert(srcData, srcLinesize, width, height, AV_PIX_FMT_RGB24)) return false;
+    return Encode(imageBytes);
+}
+
+bool ImageEncoder::EncodeRgba(
+    const uint8_t* rgba,
+    int width,
+    int height,
+    const std::string& format,
+    int quality,
+    std::vector<uint8_t>* imageBytes) {
+    if (!Prepare(format, width, height, quality)) return false;
+    const uint8_t* srcData[4] = {rgba, nullptr, nullptr, nullptr};
+    int srcLinesize[4] = {width * 4, 0, 0, 0};
+    if (!Convert(srcData, srcLinesize, width, height, AV_PIX_FMT_RGBA)) return false;
+    return Encode(imageBytes);
+}
+
+}  // namespace pro_video_editor
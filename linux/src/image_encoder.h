@@ -0,0 +1,88 @@
+// src/image_encoder.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+namespace pro_video_editor {
+
+// Encodes single images ("jpeg", "png" or "webp") with libavcodec.
+//
+// The encoder context, its input frame, the output packet and the scaler
+// stay open between images and are only reopened when the format, size or
+// quality changes, so a strip of thumbnails pays the encoder setup once.
+// Not thread-safe; every ThumbnailEngine owns one, which makes it one per
+// pool worker in practice.
+class ImageEncoder {
+public:
+    // Lets the encoder pick its default quality.
+    static constexpr int kDefaultQuality = -1;
+
+    ImageEncoder();
+    ~ImageEncoder();
+
+    ImageEncoder(const ImageEncoder&) = delete;
+    ImageEncoder& operator=(const ImageEncoder&) = delete;
+
+    // Returns true if |format| has an encoder in this FFmpeg build.
+    static bool Supports(const std::string& format);
+
+    // Scales |frame| to |width| x |height| straight into the encoder's
+    // pixel format and encodes it. |quality| ranges from 1 to 100 and is
+    // ignored by lossless formats.
+    bool EncodeFrame(
+        const AVFrame* frame,
+        int width,
+        int height,
+        const std::string& format,
+        int quality,
+        std::vector<uint8_t>* imageBytes);
+
+    // Encodes a tightly packed RGB24 image of |width| x |height|.
+    bool EncodeRgb(
+        const uint8_t* rgb,
+        int width,
+        int height,
+        const std::string& format,
+        int quality,
+        std::vector<uint8_t>* imageBytes);
+
+    // Encodes a tightly packed RGBA8888 image of |width| x |height|. Formats
+    // without alpha drop it.
+    bool EncodeRgba(
+        const uint8_t* rgba,
+        int width,
+        int height,
+        const std::string& format,
+        int quality,
+        std::vector<uint8_t>* imageBytes);
+
+private:
+    bool Prepare(const std::string& format, int width, int height, int quality);
+    bool Convert(
+        const uint8_t* const srcData[],
+        const int srcLinesize[],
+        int srcWidth,
+        int srcHeight,
+        int srcFormat);
+    bool Encode(std::vector<uint8_t>* imageBytes);
+    void Reset();
+
+    AVCodecContext* codec_ctx_ = nullptr;
+    AVFrame* frame_ = nullptr;
+    AVPacket* packet_ = nullptr;
+    SwsContext* scale_ctx_ = nullptr;
+    std::string format_;
+    int width_ = 0;
+    int height_ = 0;
+    int quality_ = kDefaultQuality;
+    int64_t next_pts_ = 0;
+};
+
+}  // namespace pro_video_editor
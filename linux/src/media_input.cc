@@ -0,0 +1,267 @@
+#include "media_input.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/mem.h>
+}
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "av_utils.h"
+
+namespace pro_video_editor {
+
+namespace {
+
+constexpr int kIoBufferSize = 64 * 1024;
+
+// Limits of the analysis of a fast probe whose headers were incomplete.
+constexpr int64_t kFastProbeSize = 256 * 1024;
+constexpr int64_t kFastAnalyzeDuration = AV_TIME_BASE / 2;
+
+// True if the video stream tells its size and the input its duration.
+bool HasVideoInformation(const AVFormatContext* format_ctx) {
+    const AVStream* video = nullptr;
+    for (unsigned i = 0; i < format_ctx->nb_streams && !video; ++i) {
+        if (format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) video = format_ctx->streams[i];
+    }
+    return video && video->codecpar->width > 0 && video->codecpar->height > 0 &&
+           (format_ctx->duration > 0 || video->duration > 0);
+}
+
+// True if avformat_open_input failed with |ret| because the demuxer opens
+// files by name, which custom IO cannot serve: demuxers without AVIOContext
+// support (AVFMT_NOFILE) or that open sibling files. Broken or unsupported
+// data fails with other errors, which a real file would not fix.
+bool NeedsRealFile(int ret) {
+    return ret == AVERROR(ENOENT) || ret == AVERROR(ENOSYS);
+}
+
+}  // namespace
+
+MediaProbe ParseMediaProbe(const std::string& name) {
+    return name == "fast" ? MediaProbe::Fast : MediaProbe::Full;
+}
+
+std::unique_ptr<MediaInput> MediaInput::Open(const MediaSource& source, std::string* error, MediaProbe probe) {
+    if (probe == MediaProbe::Fast) {
+        std::unique_ptr<MediaInput> input = OpenWithProbe(source, MediaProbe::Fast, nullptr);
+        if (input && HasVideoInformation(input->format_ctx_)) return input;
+    }
+    return OpenWithProbe(source, MediaProbe::Full, error);
+}
+
+std::unique_ptr<MediaInput> MediaInput::OpenWithProbe(
+    const MediaSource& source,
+    MediaProbe probe,
+    std::string* error) {
+    std::unique_ptr<MediaInput> input(new MediaInput());
+    input->probe_ = probe;
+
+    if (!source.path.empty()) {
+        if (input->OpenFromFile(source.path, error)) return input;
+        return nullptr;
+    }
+    if (source.read) {
+        if (input->OpenFromReader(source.read, source.size, "reader" + source.extension, error)) return input;
+        return nullptr;
+    }
+
+    if (input->OpenFromMemory(source.data, source.size, "memory" + source.extension, error)) {
+        return input;
+    }
+    if (!NeedsRealFile(input->open_error_)) return nullptr;
+
+    // Copy the bytes to a scratch file only for demuxers that need one.
+    input->Close();
+    if (error) error->clear();
+    if (input->OpenFromScratchFile(source, error)) return input;
+    return nullptr;
+}
+
+MediaInput::~MediaInput() {
+    Close();
+}
+
+void MediaInput::Close() {
+    if (format_ctx_) avformat_close_input(&format_ctx_);
+    if (io_ctx_) {
+        av_freep(&io_ctx_->buffer);
+        avio_context_free(&io_ctx_);
+    }
+    if (mapping_) {
+        munmap(mapping_, size_);
+        mapping_ = nullptr;
+    }
+    scratch_.reset();
+    data_ = nullptr;
+    reader_ = nullptr;
+    size_ = 0;
+    position_ = 0;
+}
+
+bool MediaInput::OpenFromFile(const std::string& path, std::string* error) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (error) *error = "Could not open video file: " + path;
+        return false;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        if (error) *error = "The video file is empty: " + path;
+        return false;
+    }
+
+    // Map the file so that only the pages the demuxer actually touches are
+    // read from disk. The mapping stays valid after the descriptor closes.
+    void* mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        // E.g. special files that cannot be mapped; let libavformat read them.
+        size_ = static_cast<size_t>(st.st_size);
+        int ret = avformat_open_input(&format_ctx_, path.c_str(), nullptr, nullptr);
+        if (ret < 0) {
+            if (error) *error = "Could not open video file: " + AvErrorToString(ret);
+            return false;
+        }
+        return FindStreamInfo(error);
+    }
+
+    mapping_ = mapping;
+    size_ = static_cast<size_t>(st.st_size);
+    return OpenFromMemory(static_cast<const uint8_t*>(mapping), size_, path, error);
+}
+
+bool MediaInput::OpenFromMemory(const uint8_t* data, size_t size, const std::string& hint, std::string* error) {
+    if (!data || size == 0) {
+        if (error) *error = "The video is empty";
+        return false;
+    }
+    data_ = data;
+    size_ = size;
+    position_ = 0;
+    return OpenCustomIo(hint, error);
+}
+
+bool MediaInput::OpenFromReader(const RangeReader& reader, size_t size, const std::string& hint, std::string* error) {
+    if (size == 0) {
+        if (error) *error = "The video is empty";
+        return false;
+    }
+    reader_ = reader;
+    size_ = size;
+    position_ = 0;
+    return OpenCustomIo(hint, error);
+}
+
+bool MediaInput::OpenCustomIo(const std::string& hint, std::string* error) {
+    auto* buffer = static_cast<unsigned char*>(av_malloc(kIoBufferSize));
+    if (!buffer) {
+        if (error) *error = "Out of memory";
+        return false;
+    }
+    io_ctx_ = avio_alloc_context(buffer, kIoBufferSize, 0, this, &MediaInput::ReadPacket, nullptr, &MediaInput::Seek);
+    if (!io_ctx_) {
+        av_free(buffer);
+        if (error) *error = "Out of memory";
+        return false;
+    }
+
+    format_ctx_ = avformat_alloc_context();
+    if (!format_ctx_) {
+        if (error) *error = "Out of memory";
+        return false;
+    }
+    format_ctx_->pb = io_ctx_;
+    format_ctx_->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    // The file name is only a probing hint for the demuxer.
+    int ret = avformat_open_input(&format_ctx_, hint.c_str(), nullptr, nullptr);
+    if (ret < 0) {
+        // avformat_open_input frees the context on failure.
+        open_error_ = ret;
+        if (error) *error = "Could not open video file: " + AvErrorToString(ret);
+        return false;
+    }
+    return FindStreamInfo(error);
+}
+
+bool MediaInput::OpenFromScratchFile(const MediaSource& source, std::string* error) {
+    scratch_ = ScratchFile::CreateWithData("vid" + source.extension, source.data, source.size, error);
+    if (!scratch_) return false;
+    size_ = source.size;
+
+    // The demuxer probes the content, since the path has no extension.
+    int ret = avformat_open_input(&format_ctx_, scratch_->path().c_str(), nullptr, nullptr);
+    if (ret < 0) {
+        if (error) *error = "Could not open video file: " + AvErrorToString(ret);
+        return false;
+    }
+    return FindStreamInfo(error);
+}
+
+bool MediaInput::FindStreamInfo(std::string* error) {
+    if (probe_ == MediaProbe::Fast) {
+        // The headers of most MP4 and Matroska files already have all of it.
+        if (HasVideoInformation(format_ctx_)) return true;
+        format_ctx_->probesize = kFastProbeSize;
+        format_ctx_->max_analyze_duration = kFastAnalyzeDuration;
+    }
+
+    int ret = avformat_find_stream_info(format_ctx_, nullptr);
+    if (ret < 0) {
+        if (error) *error = "Failed to find stream info: " + AvErrorToString(ret);
+        return false;
+    }
+    return true;
+}
+
+int MediaInput::ReadPacket(void* opaque, uint8_t* buffer, int bufferSize) {
+    auto* self = static_cast<MediaInput*>(opaque);
+    size_t remaining = self->size_ - self->position_;
+    if (remaining == 0) return AVERROR_EOF;
+
+    size_t count = std::min(remaining, static_cast<size_t>(bufferSize));
+    if (self->reader_) {
+        int64_t read = self->reader_(static_cast<int64_t>(self->position_), buffer, count);
+        if (read < 0) return AVERROR(EIO);
+        if (read == 0) return AVERROR_EOF;
+        count = std::min(count, static_cast<size_t>(read));
+    } else {
+        std::memcpy(buffer, self->data_ + self->position_, count);
+    }
+    self->position_ += count;
+    self->bytes_read_ += count;
+    return static_cast<int>(count);
+}
+
+int64_t MediaInput::Seek(void* opaque, int64_t offset, int whence) {
+    auto* self = static_cast<MediaInput*>(opaque);
+    whence &= ~AVSEEK_FORCE;
+    if (whence == AVSEEK_SIZE) return static_cast<int64_t>(self->size_);
+
+    int64_t target;
+    switch (whence) {
+        case SEEK_SET: target = offset; break;
+        case SEEK_CUR: target = static_cast<int64_t>(self->position_) + offset; break;
+        case SEEK_END: target = static_cast<int64_t>(self->size_) + offset; break;
+        default: return AVERROR(EINVAL);
+    }
+    if (target < 0 || target > static_cast<int64_t>(self->size_)) return AVERROR(EINVAL);
+
+    self->position_ = static_cast<size_t>(target);
+    return target;
+}
+
+}  // namespace pro_video_editor
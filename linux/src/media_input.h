@@ -0,0 +1,123 @@
+// src/media_input.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "scratch_storage.h"
+
+struct AVFormatContext;
+struct AVIOContext;
+
+namespace pro_video_editor {
+
+// Reads up to |size| bytes at |offset| of a video into |buffer|. Returns
+// the number of bytes read, 0 at the end or a negative value on error.
+using RangeReader = std::function<int64_t(int64_t offset, uint8_t* buffer, size_t size)>;
+
+// Describes where an encoded video is read from.
+struct MediaSource {
+    // Local file to read the video from. Takes precedence over |read| and
+    // |data|.
+    std::string path;
+
+    // Reads the video on demand, so only the ranges the demuxer seeks to
+    // are transferred. |size| holds the total size. Takes precedence over
+    // |data|.
+    RangeReader read;
+
+    // Encoded video bytes. Not owned, they must outlive every MediaInput
+    // opened on this source.
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    // Container extension including the dot (e.g. ".mp4"). Used as a probing
+    // hint.
+    std::string extension;
+};
+
+// How much of the input is analyzed when opening it.
+enum class MediaProbe {
+    // avformat_find_stream_info with the default limits, which may decode
+    // seconds of frames. Needed before decoding.
+    Full,
+    // Trusts the container headers (MP4 moov, Matroska Segment Info) when
+    // they already tell the size and duration of the video, and otherwise
+    // analyzes at most a few hundred KB. Falls back to Full when fields are
+    // still missing. Enough for metadata.
+    Fast,
+};
+
+// Parses the Dart enum name ("full" or "fast"). Unknown names are Full.
+MediaProbe ParseMediaProbe(const std::string& name);
+
+// A demuxer opened and probed on a MediaSource.
+//
+// The bytes are demuxed in place through a custom read/seek AVIOContext, so
+// they are never written to disk. Local files are memory-mapped and read the
+// same way, and range readers are asked for each buffer the demuxer reads. Only if
+// libavformat cannot open in-memory bytes are they copied to a ScratchFile,
+// which is freed again when the MediaInput is destroyed.
+class MediaInput {
+public:
+    static std::unique_ptr<MediaInput> Open(
+        const MediaSource& source,
+        std::string* error,
+        MediaProbe probe = MediaProbe::Full);
+
+    ~MediaInput();
+
+    MediaInput(const MediaInput&) = delete;
+    MediaInput& operator=(const MediaInput&) = delete;
+
+    AVFormatContext* format_context() const { return format_ctx_; }
+
+    // Size of the encoded input in bytes.
+    int64_t size() const { return static_cast<int64_t>(size_); }
+
+    // Bytes the demuxer read so far. A probe of a file with its index up
+    // front reads far less than size().
+    uint64_t bytes_read() const { return bytes_read_; }
+
+    // True if the input had to be copied to a scratch file.
+    bool uses_temp_file() const { return scratch_ != nullptr; }
+
+    // The probe the input was opened with; Full if a Fast probe fell back.
+    MediaProbe probe() const { return probe_; }
+
+private:
+    MediaInput() = default;
+
+    static std::unique_ptr<MediaInput> OpenWithProbe(
+        const MediaSource& source,
+        MediaProbe probe,
+        std::string* error);
+    bool OpenFromFile(const std::string& path, std::string* error);
+    bool OpenFromMemory(const uint8_t* data, size_t size, const std::string& hint, std::string* error);
+    bool OpenFromReader(const RangeReader& reader, size_t size, const std::string& hint, std::string* error);
+    bool OpenCustomIo(const std::string& hint, std::string* error);
+    bool OpenFromScratchFile(const MediaSource& source, std::string* error);
+    bool FindStreamInfo(std::string* error);
+    void Close();
+
+    static int ReadPacket(void* opaque, uint8_t* buffer, int bufferSize);
+    static int64_t Seek(void* opaque, int64_t offset, int whence);
+
+    AVFormatContext* format_ctx_ = nullptr;
+    AVIOContext* io_ctx_ = nullptr;
+    const uint8_t* data_ = nullptr;
+    RangeReader reader_;
+    size_t size_ = 0;
+    size_t position_ = 0;
+    uint64_t bytes_read_ = 0;
+    void* mapping_ = nullptr;
+    std::unique_ptr<ScratchFile> scratch_;
+    MediaProbe probe_ = MediaProbe::Full;
+    // The avformat_open_input error of the last in-memory open, if any.
+    int open_error_ = 0;
+};
+
+}  // namespace pro_video_editor
@@ -0,0 +1,120 @@
+#include "media_session.h"
+
+#include <utility>
+#include <vector>
+
+#include "content_hash.h"
+
+namespace pro_video_editor {
+
+MediaSession::MediaSession(const MediaSource& source, std::shared_ptr<const void> owner)
+    : source_(source), owner_(std::move(owner)), engines_(source_) {}
+
+bool MediaSession::Warm(std::string* error) {
+    std::unique_ptr<ThumbnailEngine> engine = engines_.Acquire(error);
+    if (!engine) return false;
+    engines_.Release(std::move(engine));
+    return true;
+}
+
+size_t MediaSession::MemoryUsage() const {
+    // Files are memory-mapped per engine and paged in on demand, only
+    // in-memory videos are held by the session itself.
+    size_t owned = source_.path.empty() ? source_.size : 0;
+    return owned + engines_.MemoryUsage();
+}
+
+bool MediaSession::ContentHash(uint64_t* hash) {
+    std::lock_guard<std::mutex> lock(hash_mutex_);
+    if (!has_content_hash_) {
+        has_content_hash_ = ComputeContentHash(source_, &content_hash_, nullptr);
+    }
+    *hash = content_hash_;
+    return has_content_hash_;
+}
+
+MediaSessionCache& MediaSessionCache::Shared() {
+    static MediaSessionCache cache;
+    return cache;
+}
+
+int64_t MediaSessionCache::Add(std::shared_ptr<MediaSession> session) {
+    std::vector<std::shared_ptr<MediaSession>> evicted;
+    int64_t handle;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        handle = next_handle_++;
+        lru_.emplace_front(handle, std::move(session));
+        entries_[handle] = lru_.begin();
+        evicted = TrimLocked();
+    }
+    // Like in Remove, the evicted sessions close outside the lock.
+    return handle;
+}
+
+std::shared_ptr<MediaSession> MediaSessionCache::Get(int64_t handle) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(handle);
+    if (it == entries_.end()) return nullptr;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->second;
+}
+
+bool MediaSessionCache::Remove(int64_t handle) {
+    std::shared_ptr<MediaSession> session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(handle);
+        if (it == entries_.end()) return false;
+        session = std::move(it->second->second);
+        lru_.erase(it->second);
+        entries_.erase(it);
+    }
+    // Closing the decoders can take a moment, do it outside the lock.
+    session.reset();
+    return true;
+}
+
+void MediaSessionCache::Trim() {
+    std::vector<std::shared_ptr<MediaSession>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        evicted = TrimLocked();
+    }
+}
+
+void MediaSessionCache::SetMemoryBudget(size_t bytes) {
+    std::vector<std::shared_ptr<MediaSession>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        budget_ = bytes;
+        evicted = TrimLocked();
+    }
+}
+
+size_t MediaSessionCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lru_.size();
+}
+
+std::vector<std::shared_ptr<MediaSession>> MediaSessionCache::TrimLocked() {
+    // Sessions in use change their usage concurrently, sample it once.
+    std::vector<size_t> usage;
+    size_t total = 0;
+    for (const Entry& entry : lru_) {
+        usage.push_back(entry.second->MemoryUsage());
+        total += usage.back();
+    }
+
+    std::vector<std::shared_ptr<MediaSession>> evicted;
+    while (total > budget_ && lru_.size() > 1) {
+        total -= usage.back();
+        usage.pop_back();
+        entries_.erase(lru_.back().first);
+        evicted.push_back(std::move(lru_.back().second));
+        lru_.pop_back();
+    }
+    return evicted;
+}
+
+}  // namespace pro_video_editor
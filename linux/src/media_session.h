@@ -0,0 +1,104 @@
+// src/media_session.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "media_input.h"
+#include "thumbnail_engine.h"
+
+namespace pro_video_editor {
+
+// A video kept open across method calls (`openVideo` / `closeVideo`).
+//
+// The session keeps the encoded bytes alive and a pool of opened
+// ThumbnailEngines, so repeated thumbnail and information requests skip
+// transferring, probing and opening the decoder again.
+class MediaSession {
+public:
+    // |owner| keeps the bytes of |source| alive as long as the session, it
+    // may be nullptr for files.
+    MediaSession(const MediaSource& source, std::shared_ptr<const void> owner);
+
+    MediaSession(const MediaSession&) = delete;
+    MediaSession& operator=(const MediaSession&) = delete;
+
+    const MediaSource& source() const { return source_; }
+    ThumbnailEnginePool& engines() { return engines_; }
+
+    // Opens one engine up front so the first request finds it warm. Returns
+    // false and sets |error| if the video cannot be decoded.
+    bool Warm(std::string* error);
+
+    // Memory held by the session: bytes it keeps alive plus idle decoders.
+    size_t MemoryUsage() const;
+
+    // ComputeContentHash of the source, computed once per session.
+    bool ContentHash(uint64_t* hash);
+
+private:
+    MediaSource source_;
+    std::shared_ptr<const void> owner_;
+    ThumbnailEnginePool engines_;
+
+    std::mutex hash_mutex_;
+    bool has_content_hash_ = false;
+    uint64_t content_hash_ = 0;
+};
+
+// The open sessions, addressed by the handle returned to Dart.
+//
+// Sessions are evicted least recently used first while the total memory of
+// all sessions exceeds the budget; the most recently used one always stays.
+// Requests hold their own reference, so evicting a session in use only
+// closes it once that request is done.
+class MediaSessionCache {
+public:
+    // 512 MB, roughly a dozen warm 1080p decoders.
+    static constexpr size_t kDefaultMemoryBudget = 512u * 1024 * 1024;
+
+    explicit MediaSessionCache(size_t budget = kDefaultMemoryBudget) : budget_(budget) {}
+
+    static MediaSessionCache& Shared();
+
+    // Adds |session| and returns its handle.
+    int64_t Add(std::shared_ptr<MediaSession> session);
+
+    // Returns the session of |handle| and marks it as recently used, or
+    // nullptr if it was closed or evicted.
+    std::shared_ptr<MediaSession> Get(int64_t handle);
+
+    // Returns false if |handle| is not open.
+    bool Remove(int64_t handle);
+
+    // Evicts sessions until the cache fits into its budget again. Called
+    // after requests, since idle decoders accumulate while they run.
+    void Trim();
+
+    void SetMemoryBudget(size_t bytes);
+
+    size_t size() const;
+
+private:
+    using Entry = std::pair<int64_t, std::shared_ptr<MediaSession>>;
+
+    // Unlinks the sessions over the budget and returns them, so that the
+    // caller closes them after releasing the lock.
+    std::vector<std::shared_ptr<MediaSession>> TrimLocked();
+
+    mutable std::mutex mutex_;
+    size_t budget_;
+    int64_t next_handle_ = 1;
+
+    // Most recently used first.
+    std::list<Entry> lru_;
+    std::unordered_map<int64_t, std::list<Entry>::iterator> entries_;
+};
+
+}  // namespace pro_video_editor
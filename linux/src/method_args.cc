@@ -0,0 +1,103 @@
+#include "method_args.h"
+
+#include <filesystem>
+
+namespace pro_video_editor {
+
+bool MethodArgs::IsMap() const {
+    return args_ != nullptr && fl_value_get_type(args_) == FL_VALUE_TYPE_MAP;
+}
+
+FlValue* MethodArgs::Get(const char* key) const {
+    if (!IsMap()) return nullptr;
+    FlValue* value = fl_value_lookup_string(args_, key);
+    if (value == nullptr || fl_value_get_type(value) == FL_VALUE_TYPE_NULL) return nullptr;
+    return value;
+}
+
+bool MethodArgs::GetString(const char* key, std::string* value) const {
+    FlValue* v = Get(key);
+    if (v == nullptr || fl_value_get_type(v) != FL_VALUE_TYPE_STRING) return false;
+    *value = fl_value_get_string(v);
+    return true;
+}
+
+bool MethodArgs::GetInt(const char* key, int64_t* value) const {
+    FlValue* v = Get(key);
+    if (v == nullptr || fl_value_get_type(v) != FL_VALUE_TYPE_INT) return false;
+    *value = fl_value_get_int(v);
+    return true;
+}
+
+bool MethodArgs::GetBool(const char* key, bool* value) const {
+    FlValue* v = Get(key);
+    if (v == nullptr || fl_value_get_type(v) != FL_VALUE_TYPE_BOOL) return false;
+    *value = fl_value_get_bool(v);
+    return true;
+}
+
+bool MethodArgs::GetDouble(const char* key, double* value) const {
+    FlValue* v = Get(key);
+    return v != nullptr && ReadNumber(v, value);
+}
+
+bool MethodArgs::GetBytes(const char* key, const uint8_t** data, size_t* size) const {
+    FlValue* v = Get(key);
+    if (v == nullptr || fl_value_get_type(v) != FL_VALUE_TYPE_UINT8_LIST) return false;
+    *data = fl_value_get_uint8_list(v);
+    *size = fl_value_get_length(v);
+    return true;
+}
+
+FlValue* MethodArgs::GetList(const char* key) const {
+    FlValue* v = Get(key);
+    if (v == nullptr || fl_value_get_type(v) != FL_VALUE_TYPE_LIST) return nullptr;
+    return v;
+}
+
+bool ReadNumber(FlValue* value, double* number) {
+    switch (fl_value_get_type(value)) {
+        case FL_VALUE_TYPE_INT:
+            *number = static_cast<double>(fl_value_get_int(value));
+            return true;
+        case FL_VALUE_TYPE_FLOAT:
+            *number = fl_value_get_float(value);
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool ReadMediaSource(const MethodArgs& args, MediaSource* source, std::string* error) {
+    std::string extension;
+    args.GetString("extension", &extension);
+
+    if (args.GetString("videoPath", &source->path)) {
+        if (extension.empty()) extension = std::filesystem::path(source->path).extension().string();
+    } else {
+        if (!args.GetBytes("videoBytes", &source->data, &source->size)) {
+            *error = "Missing or invalid videoBytes or videoPath";
+            return false;
+        }
+        if (extension.empty()) {
+            *error = "Missing or invalid extension";
+            return false;
+        }
+    }
+
+    if (!extension.empty() && extension[0] != '.') extension = "." + extension;
+    source->extension = extension;
+    return true;
+}
+
+FlMethodResponse* SuccessResponse(FlValue* result) {
+    FlMethodResponse* response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    if (result != nullptr) fl_value_unref(result);
+    return response;
+}
+
+FlMethodResponse* ErrorResponse(const std::string& code, const std::string& message) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(code.c_str(), message.c_str(), nullptr));
+}
+
+}  // namespace pro_video_editor
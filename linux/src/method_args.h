@@ -0,0 +1,61 @@
+// src/method_args.h
+#pragma once
+
+#include <flutter_linux/flutter_linux.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "media_input.h"
+
+namespace pro_video_editor {
+
+// Read-only view of the argument map of a method call.
+//
+// Values are read from the FlValue tree in place. In particular Uint8List
+// arguments such as `videoBytes` are borrowed, never copied. The view does
+// not take a reference; |args| must outlive it (the FlMethodCall keeps it
+// alive while the call is handled).
+class MethodArgs {
+public:
+    explicit MethodArgs(FlValue* args) : args_(args) {}
+
+    bool IsMap() const;
+
+    // Returns the value of |key|, or nullptr if it is missing or null.
+    FlValue* Get(const char* key) const;
+
+    bool GetString(const char* key, std::string* value) const;
+    bool GetInt(const char* key, int64_t* value) const;
+    bool GetBool(const char* key, bool* value) const;
+
+    // Accepts ints as well, Dart sends whole doubles either way.
+    bool GetDouble(const char* key, double* value) const;
+
+    // Points |data| at the bytes of a Uint8List argument.
+    bool GetBytes(const char* key, const uint8_t** data, size_t* size) const;
+
+    // Returns the list value of |key|, or nullptr if it is not a list.
+    FlValue* GetList(const char* key) const;
+
+private:
+    FlValue* args_;
+};
+
+// Reads |value| as a number, accepting both int and float values.
+bool ReadNumber(FlValue* value, double* number);
+
+// Reads the video input of a method call into |source|.
+//
+// Accepts either `videoPath`, a local file that is read directly, or
+// `videoBytes` with its container `extension`. The bytes stay owned by
+// |args|. Returns false and sets |error| if neither is present.
+bool ReadMediaSource(const MethodArgs& args, MediaSource* source, std::string* error);
+
+// Response helpers. SuccessResponse takes ownership of |result|, which may
+// be nullptr.
+FlMethodResponse* SuccessResponse(FlValue* result);
+FlMethodResponse* ErrorResponse(const std::string& code, const std::string& message);
+
+}  // namespace pro_video_editor
@@ -0,0 +1,105 @@
+#include "scratch_storage.h"
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace pro_video_editor {
+
+namespace {
+
+std::mutex configMutex;
+ScratchStorageConfig config;
+
+int CreateInDirectory(const std::string& directory, const std::string& label) {
+    int fd = open(directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0 || (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL)) return fd;
+
+    // The file system has no O_TMPFILE. mkostemp picks a name nobody else
+    // holds, and unlinking it right away leaves the same anonymous file.
+    std::string path = directory + "/" + label + ".XXXXXX";
+    fd = mkostemp(&path[0], O_CLOEXEC);
+    if (fd >= 0) unlink(path.c_str());
+    return fd;
+}
+
+}  // namespace
+
+ScratchStorageConfig GetScratchStorageConfig() {
+    std::lock_guard<std::mutex> lock(configMutex);
+    return config;
+}
+
+void SetScratchStorageConfig(const ScratchStorageConfig& newConfig) {
+    std::lock_guard<std::mutex> lock(configMutex);
+    config = newConfig;
+}
+
+std::unique_ptr<ScratchFile> ScratchFile::Create(const std::string& label, std::string* error) {
+    ScratchStorageConfig current = GetScratchStorageConfig();
+    int fd = -1;
+    if (current.backing == ScratchBacking::Memory) {
+        fd = memfd_create(label.c_str(), MFD_CLOEXEC);
+    }
+    if (fd < 0) fd = CreateInDirectory(current.directory, label);
+    if (fd < 0) {
+        if (error) *error = std::string("Failed to create a scratch file: ") + std::strerror(errno);
+        return nullptr;
+    }
+    return std::unique_ptr<ScratchFile>(new ScratchFile(fd));
+}
+
+std::unique_ptr<ScratchFile> ScratchFile::CreateWithData(
+    const std::string& label,
+    const uint8_t* data,
+    size_t size,
+    std::string* error) {
+    std::unique_ptr<ScratchFile> file = Create(label, error);
+    if (file && !file->Append(data, size)) {
+        if (error) *error = std::string("Failed to write a scratch file: ") + std::strerror(errno);
+        return nullptr;
+    }
+    return file;
+}
+
+ScratchFile::~ScratchFile() {
+    close(fd_);
+}
+
+std::string ScratchFile::path() const {
+    return "/proc/self/fd/" + std::to_string(fd_);
+}
+
+bool ScratchFile::Append(const uint8_t* data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t ret = pwrite(fd_, data + written, size - written, static_cast<off_t>(size_ + written));
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) return false;
+        written += static_cast<size_t>(ret);
+    }
+    size_ += written;
+    return true;
+}
+
+bool ScratchFile::ReadAll(std::vector<uint8_t>* output) const {
+    output->resize(size_);
+    size_t done = 0;
+    while (done < size_) {
+        ssize_t ret = pread(fd_, output->data() + done, size_ - done, static_cast<off_t>(done));
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) {
+            output->clear();
+            return false;
+        }
+        done += static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+}  // namespace pro_video_editor
@@ -0,0 +1,80 @@
+// src/scratch_storage.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pro_video_editor {
+
+// What backs scratch files.
+enum class ScratchBacking {
+    // Anonymous memory (memfd_create). Stays in the page cache and never
+    // touches a disk unless the system swaps.
+    Memory,
+    // An unnamed file (O_TMPFILE) in ScratchStorageConfig::directory, for
+    // data too large for memory.
+    Directory,
+};
+
+// Scratch storage settings, process-wide.
+struct ScratchStorageConfig {
+    ScratchBacking backing = ScratchBacking::Memory;
+    // Used by Directory, and by Memory when memfd_create is unavailable.
+    std::string directory = "/tmp";
+};
+
+ScratchStorageConfig GetScratchStorageConfig();
+
+// Applies to scratch files created afterwards.
+void SetScratchStorageConfig(const ScratchStorageConfig& config);
+
+// A temporary file that has no name in any directory, so concurrent files
+// can never collide and nothing is left behind after a crash. Destroying it
+// frees the storage.
+//
+// Falls back from memfd to O_TMPFILE to a file created with mkostemp and
+// unlinked right away, depending on what the kernel and file system support.
+// A file is meant for one thread at a time.
+class ScratchFile {
+public:
+    // Creates an empty scratch file. |label| only names it in /proc.
+    static std::unique_ptr<ScratchFile> Create(const std::string& label, std::string* error);
+
+    // Creates a scratch file holding a copy of |data|.
+    static std::unique_ptr<ScratchFile> CreateWithData(
+        const std::string& label,
+        const uint8_t* data,
+        size_t size,
+        std::string* error);
+
+    ~ScratchFile();
+
+    ScratchFile(const ScratchFile&) = delete;
+    ScratchFile& operator=(const ScratchFile&) = delete;
+
+    // Close-on-exec; map it explicitly to hand it to a child process.
+    int fd() const { return fd_; }
+
+    // Opens the file in this process (/proc/self/fd/N), e.g. for libraries
+    // that only take paths.
+    std::string path() const;
+
+    size_t size() const { return size_; }
+
+    // Appends |size| bytes at the end of the file.
+    bool Append(const uint8_t* data, size_t size);
+
+    // Copies the whole file into |output|.
+    bool ReadAll(std::vector<uint8_t>* output) const;
+
+private:
+    explicit ScratchFile(int fd) : fd_(fd) {}
+
+    const int fd_;
+    size_t size_ = 0;
+};
+
+}  // namespace pro_video_editor
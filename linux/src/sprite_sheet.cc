@@ -0,0 +1,59 @@
+#include "sprite_sheet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "thumbnail_engine.h"
+
+namespace pro_video_editor {
+
+int DefaultSpriteSheetColumns(size_t count, int tileWidth) {
+    if (count == 0 || tileWidth <= 0) return 1;
+    int square = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+    int maxColumns = std::max(1, kMaxSpriteSheetWidth / tileWidth);
+    return std::min(square, maxColumns);
+}
+
+bool ComposeSpriteSheet(
+    const std::vector<std::vector<uint8_t>>& thumbnails,
+    int tileWidth,
+    int columns,
+    SpriteSheet* sheet) {
+    if (thumbnails.empty() || tileWidth <= 0 || columns <= 0) return false;
+
+    int cellHeight = 0;
+    for (const auto& thumbnail : thumbnails) {
+        cellHeight = std::max(cellHeight, RawThumbnailHeight(tileWidth, thumbnail.size()));
+    }
+    if (cellHeight == 0) return false;
+
+    columns = std::min(columns, static_cast<int>(thumbnails.size()));
+    int rows = static_cast<int>((thumbnails.size() + columns - 1) / columns);
+    sheet->width = tileWidth * columns;
+    sheet->height = cellHeight * rows;
+    sheet->pixels.assign(static_cast<size_t>(sheet->width) * sheet->height * 4, 0);
+    sheet->tiles.assign(thumbnails.size(), SpriteTile{});
+
+    size_t sheetStride = static_cast<size_t>(sheet->width) * 4;
+    size_t tileStride = static_cast<size_t>(tileWidth) * 4;
+    for (size_t i = 0; i < thumbnails.size(); ++i) {
+        int height = RawThumbnailHeight(tileWidth, thumbnails[i].size());
+        if (height == 0) continue;
+
+        SpriteTile& tile = sheet->tiles[i];
+        tile.x = static_cast<int>(i % columns) * tileWidth;
+        tile.y = static_cast<int>(i / columns) * cellHeight;
+        tile.width = tileWidth;
+        tile.height = height;
+
+        uint8_t* dst = sheet->pixels.data() + tile.y * sheetStride + static_cast<size_t>(tile.x) * 4;
+        const uint8_t* src = thumbnails[i].data();
+        for (int y = 0; y < height; ++y) {
+            std::memcpy(dst + y * sheetStride, src + y * tileStride, tileStride);
+        }
+    }
+    return true;
+}
+
+}  // namespace pro_video_editor
@@ -0,0 +1,46 @@
+// src/sprite_sheet.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pro_video_editor {
+
+// Where one thumbnail sits in a sprite sheet. Empty (all zero) for
+// thumbnails that could not be extracted.
+struct SpriteTile {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// A grid of thumbnails in one RGBA8888 image, so a timeline uploads a
+// single texture instead of one per thumbnail.
+struct SpriteSheet {
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+    // One per input thumbnail, in input order.
+    std::vector<SpriteTile> tiles;
+};
+
+// Keeps the sheet within the texture size every GPU supports.
+constexpr int kMaxSpriteSheetWidth = 4096;
+
+// Returns the columns of a sheet of |count| tiles |tileWidth| pixels wide:
+// close to square, capped at kMaxSpriteSheetWidth.
+int DefaultSpriteSheetColumns(size_t count, int tileWidth);
+
+// Packs raw RGBA thumbnails |tileWidth| pixels wide into rows of |columns|
+// tiles, row by row in input order. Every cell is as high as the highest
+// thumbnail; empty thumbnails leave their cell transparent so the tile of
+// index i always is in cell i. Returns false if nothing could be packed.
+bool ComposeSpriteSheet(
+    const std::vector<std::vector<uint8_t>>& thumbnails,
+    int tileWidth,
+    int columns,
+    SpriteSheet* sheet);
+
+}  // namespace pro_video_editor
@@ -0,0 +1,18 @@
+#include "temp_file_utils.h"
+
+#include <fstream>
+
+namespace pro_video_editor {
+
+bool WriteBytesToFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+    return WriteBytesToFile(path, bytes.data(), bytes.size());
+}
+
+bool WriteBytesToFile(const std::string& path, const uint8_t* data, size_t size) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) return false;
+    out.write(reinterpret_cast<const char*>(data), size);
+    return out.good();
+}
+
+}  // namespace pro_video_editor
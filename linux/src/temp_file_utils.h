@@ -0,0 +1,15 @@
+// src/temp_file_utils.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pro_video_editor {
+
+// Writes |bytes| to |path|, replacing any existing file.
+bool WriteBytesToFile(const std::string& path, const std::vector<uint8_t>& bytes);
+bool WriteBytesToFile(const std::string& path, const uint8_t* data, size_t size);
+
+}  // namespace pro_video_editor
@@ -0,0 +1,116 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace pro_video_editor {
+
+namespace {
+
+// The pool and worker index of the current thread, if it is a worker.
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local int currentWorker = -1;
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    threadCount = std::max<size_t>(threadCount, 1);
+    for (size_t i = 0; i < threadCount; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers_.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) worker.join();
+}
+
+ThreadPool& ThreadPool::Shared() {
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
+
+int ThreadPool::CurrentWorker() const {
+    return currentPool == this ? currentWorker : -1;
+}
+
+void ThreadPool::Push(std::function<void()> task) {
+    int worker = CurrentWorker();
+    size_t index = worker >= 0 ? static_cast<size_t>(worker) : next_queue_++ % queues_.size();
+    // Count the task before it becomes visible, so a worker that takes it
+    // right away never sees the counter drop below zero.
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++pending_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::TryPop(size_t index, std::function<void()>* task) {
+    // Newest task from the own deque first, it is the most likely to still
+    // be in cache.
+    {
+        Queue& own = *queues_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            *task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // Otherwise steal the oldest task of another worker.
+    for (size_t i = 1; i < queues_.size(); ++i) {
+        Queue& other = *queues_[(index + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            *task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::RunPendingTask() {
+    std::function<void()> task;
+    if (!TryPop(static_cast<size_t>(CurrentWorker()), &task)) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --pending_;
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+    currentPool = this;
+    currentWorker = static_cast<int>(index);
+
+    while (true) {
+        std::function<void()> task;
+        if (TryPop(index, &task)) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --pending_;
+            }
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this]() { return stopping_ || pending_ > 0; });
+        if (stopping_ && pending_ == 0) return;
+    }
+}
+
+}  // namespace pro_video_editor
@@ -0,0 +1,82 @@
+// src/thread_pool.h
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace pro_video_editor {
+
+// A fixed-size work-stealing thread pool.
+//
+// Every worker owns a task deque. Tasks submitted from a worker go to its
+// own deque and are taken LIFO, tasks from other threads are spread round
+// robin. Idle workers steal the oldest task of another worker.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // The process-wide pool, sized to the hardware concurrency. Created on
+    // first use and reused by every method call.
+    static ThreadPool& Shared();
+
+    size_t size() const { return workers_.size(); }
+
+    // Runs |fn| on a worker and returns its result.
+    template <typename Fn>
+    auto Submit(Fn&& fn) -> std::future<std::invoke_result_t<Fn>> {
+        using Result = std::invoke_result_t<Fn>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+        std::future<Result> future = task->get_future();
+        Push([task]() { (*task)(); });
+        return future;
+    }
+
+    // Waits for |future|. When called from a worker, runs other tasks while
+    // waiting so nested tasks cannot starve the pool.
+    template <typename T>
+    T Wait(std::future<T>& future) {
+        if (CurrentWorker() >= 0) {
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                if (!RunPendingTask()) future.wait_for(std::chrono::milliseconds(1));
+            }
+        }
+        return future.get();
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void Push(std::function<void()> task);
+    bool TryPop(size_t index, std::function<void()>* task);
+    bool RunPendingTask();
+    void WorkerLoop(size_t index);
+    int CurrentWorker() const;
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> next_queue_{0};
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    size_t pending_ = 0;
+    bool stopping_ = false;
+};
+
+}  // namespace pro_video_editor
@@ -0,0 +1,249 @@
+#include "thumbnail_cache.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <tuple>
+
+#include "temp_file_utils.h"
+
+namespace pro_video_editor {
+
+namespace {
+
+constexpr const char* kTempSuffix = ".tmp";
+
+std::string DefaultCacheDirectory() {
+    std::string base;
+    const char* xdgCacheHome = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    // The XDG spec says to ignore relative paths.
+    if (xdgCacheHome && xdgCacheHome[0] == '/') {
+        base = xdgCacheHome;
+    } else if (home && home[0] != '\0') {
+        base = std::string(home) + "/.cache";
+    } else {
+        return "";
+    }
+    return base + "/pro_video_editor/thumbnails";
+}
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* bytes) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+    bytes->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !in.bad() && !bytes->empty();
+}
+
+bool EndsWith(const std::string& value, const std::string& suffix) {
+    return value.size() >= suffix.size() &&
+        value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+ThumbnailCache::ThumbnailCache(std::string directory, size_t memoryBudget, size_t diskBudget)
+    : directory_(std::move(directory)), memory_budget_(memoryBudget), disk_budget_(diskBudget) {}
+
+ThumbnailCache& ThumbnailCache::Shared() {
+    static ThumbnailCache cache(DefaultCacheDirectory(), kDefaultMemoryBudget, kDefaultDiskBudget);
+    return cache;
+}
+
+std::string ThumbnailCache::MakeKey(
+    uint64_t contentHash,
+    int64_t timestampMs,
+    int width,
+    const std::string& format,
+    ThumbnailExactness exactness,
+    int quality) {
+    // Also the file name of the disk tier.
+    char key[128];
+    std::snprintf(key, sizeof(key), "%016" PRIx64 "_%" PRId64 "_%d_%c_q%d.%s",
+                  contentHash, timestampMs, width,
+                  exactness == ThumbnailExactness::NearestKeyframe ? 'k' : 'e',
+                  quality,
+                  format == "jpg" ? "jpeg" : format.c_str());
+    return key;
+}
+
+std::string ThumbnailCache::PathFor(const std::string& key) const {
+    return directory_ + "/" + key;
+}
+
+bool ThumbnailCache::Lookup(const std::string& key, std::vector<uint8_t>* image) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    auto memoryIt = memory_entries_.find(key);
+    if (memoryIt != memory_entries_.end()) {
+        memory_lru_.splice(memory_lru_.begin(), memory_lru_, memoryIt->second);
+        *image = memoryIt->second->image;
+        ++stats_.memoryHits;
+        return true;
+    }
+
+    if (!directory_.empty()) {
+        lock.unlock();
+        LoadDiskIndex();
+        lock.lock();
+        auto diskIt = disk_entries_.find(key);
+        if (diskIt != disk_entries_.end()) {
+            disk_lru_.splice(disk_lru_.begin(), disk_lru_, diskIt->second);
+            lock.unlock();
+
+            std::string path = PathFor(key);
+            bool read = ReadFile(path, image);
+            if (read) {
+                // Keeps the order for the next run.
+                std::error_code ec;
+                std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+            }
+
+            lock.lock();
+            if (read) {
+                ++stats_.diskHits;
+                StoreInMemoryLocked(key, *image);
+                return true;
+            }
+            // Removed behind our back, forget it.
+            diskIt = disk_entries_.find(key);
+            if (diskIt != disk_entries_.end()) {
+                stats_.diskBytes -= diskIt->second->size;
+                disk_lru_.erase(diskIt->second);
+                disk_entries_.erase(diskIt);
+            }
+        }
+    }
+
+    ++stats_.misses;
+    return false;
+}
+
+void ThumbnailCache::Store(const std::string& key, const std::vector<uint8_t>& image) {
+    if (image.empty()) return;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    StoreInMemoryLocked(key, image);
+    if (directory_.empty()) return;
+
+    lock.unlock();
+    LoadDiskIndex();
+    lock.lock();
+    if (disk_entries_.count(key)) return;
+    std::string path = PathFor(key);
+    std::string tempPath = path + "." + std::to_string(getpid()) + "." + std::to_string(next_temp_id_++) + kTempSuffix;
+    lock.unlock();
+
+    // Written aside and renamed, so readers never see a partial file.
+    if (!WriteBytesToFile(tempPath, image) || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return;
+    }
+
+    lock.lock();
+    if (!disk_entries_.count(key)) {
+        disk_lru_.push_front({key, image.size()});
+        disk_entries_[key] = disk_lru_.begin();
+        stats_.diskBytes += image.size();
+    }
+    std::vector<std::string> evicted = TrimDiskLocked();
+    lock.unlock();
+
+    for (const std::string& evictedPath : evicted) std::remove(evictedPath.c_str());
+}
+
+ThumbnailCache::Stats ThumbnailCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void ThumbnailCache::Clear() {
+    if (!directory_.empty()) LoadDiskIndex();
+
+    std::vector<std::string> paths;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const DiskEntry& entry : disk_lru_) paths.push_back(PathFor(entry.key));
+        memory_lru_.clear();
+        memory_entries_.clear();
+        disk_lru_.clear();
+        disk_entries_.clear();
+        stats_ = Stats();
+    }
+    for (const std::string& path : paths) std::remove(path.c_str());
+}
+
+void ThumbnailCache::LoadDiskIndex() {
+    std::call_once(disk_index_loaded_, [this]() {
+        std::error_code ec;
+        std::filesystem::create_directories(directory_, ec);
+
+        // Oldest first, so pushing to the front leaves the newest in front.
+        std::vector<std::tuple<std::filesystem::file_time_type, std::string, size_t>> files;
+        for (std::filesystem::directory_iterator it(directory_, ec), end; !ec && it != end; it.increment(ec)) {
+            std::error_code entryEc;
+            if (!it->is_regular_file(entryEc)) continue;
+            std::string name = it->path().filename().string();
+            if (EndsWith(name, kTempSuffix)) {
+                // Left over by a crashed writer.
+                std::filesystem::remove(it->path(), entryEc);
+                continue;
+            }
+            auto mtime = it->last_write_time(entryEc);
+            auto size = it->file_size(entryEc);
+            if (!entryEc) files.emplace_back(mtime, name, static_cast<size_t>(size));
+        }
+        std::sort(files.begin(), files.end());
+
+        // Nothing else touches the disk tier before this returns.
+        std::vector<std::string> evicted;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& file : files) {
+                disk_lru_.push_front({std::get<1>(file), std::get<2>(file)});
+                disk_entries_[std::get<1>(file)] = disk_lru_.begin();
+                stats_.diskBytes += std::get<2>(file);
+            }
+            evicted = TrimDiskLocked();
+        }
+        for (const std::string& path : evicted) std::remove(path.c_str());
+    });
+}
+
+void ThumbnailCache::StoreInMemoryLocked(const std::string& key, const std::vector<uint8_t>& image) {
+    auto it = memory_entries_.find(key);
+    if (it != memory_entries_.end()) {
+        stats_.memoryBytes -= it->second->image.size();
+        memory_lru_.erase(it->second);
+        memory_entries_.erase(it);
+    }
+
+    memory_lru_.push_front({key, image});
+    memory_entries_[key] = memory_lru_.begin();
+    stats_.memoryBytes += image.size();
+
+    while (stats_.memoryBytes > memory_budget_ && !memory_lru_.empty()) {
+        stats_.memoryBytes -= memory_lru_.back().image.size();
+        memory_entries_.erase(memory_lru_.back().key);
+        memory_lru_.pop_back();
+    }
+}
+
+std::vector<std::string> ThumbnailCache::TrimDiskLocked() {
+    std::vector<std::string> evicted;
+    while (stats_.diskBytes > disk_budget_ && !disk_lru_.empty()) {
+        stats_.diskBytes -= disk_lru_.back().size;
+        evicted.push_back(PathFor(disk_lru_.back().key));
+        disk_entries_.erase(disk_lru_.back().key);
+        disk_lru_.pop_back();
+    }
+    return evicted;
+}
+
+}  // namespace pro_video_editor
@@ -0,0 +1,105 @@
+// src/thumbnail_cache.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "thumbnail_engine.h"
+
+namespace pro_video_editor {
+
+// Encoded thumbnails keyed by the content of the video and the request, so
+// scrolling back over a timeline is served without decoding.
+//
+// Two tiers, both least recently used first out:
+//  - memory, bounded by |memoryBudget| bytes,
+//  - disk, one file per thumbnail in |directory|, bounded by |diskBudget|
+//    bytes. It survives restarts; the order is kept in the file mtimes.
+// Disk hits are promoted to memory. Thread-safe; file IO runs outside the
+// lock.
+class ThumbnailCache {
+public:
+    struct Stats {
+        uint64_t memoryHits = 0;
+        uint64_t diskHits = 0;
+        uint64_t misses = 0;
+        size_t memoryBytes = 0;
+        size_t diskBytes = 0;
+    };
+
+    static constexpr size_t kDefaultMemoryBudget = 32u * 1024 * 1024;
+    static constexpr size_t kDefaultDiskBudget = 256u * 1024 * 1024;
+
+    // An empty |directory| disables the disk tier.
+    ThumbnailCache(std::string directory, size_t memoryBudget, size_t diskBudget);
+
+    ThumbnailCache(const ThumbnailCache&) = delete;
+    ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+
+    // The cache under $XDG_CACHE_HOME/pro_video_editor/thumbnails.
+    static ThumbnailCache& Shared();
+
+    // Builds the key of one thumbnail. |contentHash| comes from
+    // ComputeContentHash.
+    static std::string MakeKey(
+        uint64_t contentHash,
+        int64_t timestampMs,
+        int width,
+        const std::string& format,
+        ThumbnailExactness exactness,
+        int quality);
+
+    // Copies the thumbnail of |key| into |image|. Counts a hit or a miss.
+    bool Lookup(const std::string& key, std::vector<uint8_t>* image);
+
+    void Store(const std::string& key, const std::vector<uint8_t>& image);
+
+    Stats stats() const;
+
+    // Drops both tiers and resets the counters.
+    void Clear();
+
+private:
+    struct MemoryEntry {
+        std::string key;
+        std::vector<uint8_t> image;
+    };
+    struct DiskEntry {
+        std::string key;
+        size_t size;
+    };
+
+    std::string PathFor(const std::string& key) const;
+
+    // Scans |directory_| once, without holding |mutex_|. Callers that need
+    // the disk tier wait until the first scan is done.
+    void LoadDiskIndex();
+    void StoreInMemoryLocked(const std::string& key, const std::vector<uint8_t>& image);
+
+    // Removes disk entries over budget and returns their paths, to be
+    // deleted outside the lock.
+    std::vector<std::string> TrimDiskLocked();
+
+    const std::string directory_;
+    const size_t memory_budget_;
+    const size_t disk_budget_;
+
+    mutable std::mutex mutex_;
+    Stats stats_;
+
+    // Most recently used first.
+    std::list<MemoryEntry> memory_lru_;
+    std::unordered_map<std::string, std::list<MemoryEntry>::iterator> memory_entries_;
+
+    std::once_flag disk_index_loaded_;
+    std::list<DiskEntry> disk_lru_;
+    std::unordered_map<std::string, std::list<DiskEntry>::iterator> disk_entries_;
+    uint64_t next_temp_id_ = 0;
+};
+
+}  // namespace pro_video_editor
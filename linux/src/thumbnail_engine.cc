@@ -0,0 +1,525 @@
+#include "thumbnail_engine.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include "av_utils.h"
+#include "thread_pool.h"
+
+namespace pro_video_editor {
+
+namespace {
+
+constexpr size_t kMinTimestampsPerDecoder = 4;
+
+// Frames a decoder typically keeps alive: references plus the ones in
+// flight, used to estimate its memory usage.
+constexpr size_t kDecoderFramesEstimate = 8;
+
+// Rotates a tightly packed image with |channels| bytes per pixel clockwise
+// by |rotation| degrees.
+void RotatePixels(
+    const std::vector<uint8_t>& src,
+    int width,
+    int height,
+    int channels,
+    int rotation,
+    std::vector<uint8_t>* dst) {
+    dst->resize(src.size());
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int dx, dy, dstWidth;
+            if (rotation == 90) {
+                dx = height - 1 - y;
+                dy = x;
+                dstWidth = height;
+            } else if (rotation == 180) {
+                dx = width - 1 - x;
+                dy = height - 1 - y;
+                dstWidth = width;
+            } else {
+                dx = y;
+                dy = width - 1 - x;
+                dstWidth = height;
+            }
+            std::memcpy(&(*dst)[(dy * dstWidth + dx) * channels], &src[(y * width + x) * channels], channels);
+        }
+    }
+}
+
+}  // namespace
+
+ThumbnailExactness ParseThumbnailExactness(const std::string& name) {
+    return name == "nearestKeyframe" ? ThumbnailExactness::NearestKeyframe : ThumbnailExactness::Exact;
+}
+
+ThumbnailEngine::ThumbnailEngine() {
+    packet_ = av_packet_alloc();
+    frame_ = av_frame_alloc();
+    decoded_frame_ = av_frame_alloc();
+}
+
+ThumbnailEngine::~ThumbnailEngine() {
+    Close();
+    sws_freeContext(scale_ctx_);
+    av_frame_free(&decoded_frame_);
+    av_frame_free(&frame_);
+    av_packet_free(&packet_);
+}
+
+void ThumbnailEngine::Close() {
+    avcodec_free_context(&codec_ctx_);
+    format_ctx_ = nullptr;
+    input_.reset();
+    stream_index_ = -1;
+    rotation_ = 0;
+    has_decoded_frame_ = false;
+    eof_ = false;
+    keyframe_entry_ = -1;
+    keyframe_interval_ = 0;
+    index_pts_delay_ = 0;
+}
+
+bool ThumbnailEngine::SupportsFormat(const std::string& format) {
+    return format == kRawThumbnailFormat || ImageEncoder::Supports(format);
+}
+
+size_t ThumbnailEngine::MemoryUsage() const {
+    if (!codec_ctx_) return 0;
+    AVPixelFormat pixFmt = codec_ctx_->pix_fmt == AV_PIX_FMT_NONE ? AV_PIX_FMT_YUV420P : codec_ctx_->pix_fmt;
+    int frameSize = av_image_get_buffer_size(pixFmt, codec_ctx_->width, codec_ctx_->height, 1);
+    return frameSize > 0 ? static_cast<size_t>(frameSize) * kDecoderFramesEstimate : 0;
+}
+
+bool ThumbnailEngine::Open(const MediaSource& source, std::string* error, const DecoderThreading& threading) {
+    Close();
+
+    input_ = MediaInput::Open(source, error);
+    if (!input_) return false;
+    format_ctx_ = input_->format_context();
+
+    stream_index_ = FindVideoStreamIndex(format_ctx_);
+    if (stream_index_ < 0) {
+        if (error) *error = "No video stream found";
+        Close();
+        return false;
+    }
+
+    AVStream* stream = format_ctx_->streams[stream_index_];
+    const AVCodec* decoder = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!decoder) {
+        if (error) *error = "No decoder available for the video stream";
+        Close();
+        return false;
+    }
+
+    int ret = 0;
+    codec_ctx_ = avcodec_alloc_context3(decoder);
+    if (codec_ctx_) ApplyDecoderThreading(codec_ctx_, threading);
+    if (!codec_ctx_ ||
+        avcodec_parameters_to_context(codec_ctx_, stream->codecpar) < 0 ||
+        (ret = avcodec_open2(codec_ctx_, decoder, nullptr)) < 0) {
+        if (error) *error = "Failed to open video decoder: " + AvErrorToString(ret);
+        Close();
+        return false;
+    }
+
+    // Other streams are never decoded, so let the demuxer skip them.
+    for (unsigned i = 0; i < format_ctx_->nb_streams; ++i) {
+        if (static_cast<int>(i) != stream_index_) format_ctx_->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    rotation_ = GetDisplayRotation(stream);
+
+    int keyframes = 0;
+    const AVIndexEntry* first = nullptr;
+    int64_t firstKeyframe = 0;
+    int64_t lastKeyframe = 0;
+    int entries = avformat_index_get_entries_count(stream);
+    for (int i = 0; i < entries; ++i) {
+        const AVIndexEntry* entry = avformat_index_get_entry(stream, i);
+        if (!entry || !(entry->flags & AVINDEX_KEYFRAME)) continue;
+        if (keyframes++ == 0) {
+            first = entry;
+            firstKeyframe = entry->timestamp;
+        }
+        lastKeyframe = entry->timestamp;
+    }
+    if (keyframes > 1) keyframe_interval_ = (lastKeyframe - firstKeyframe) / (keyframes - 1);
+
+    // MP4 indexes decoding times, which run ahead of the presentation
+    // times once there are B-frames. The first keyframe tells by how much;
+    // every request seeks first, so reading it costs no position.
+    while (first && av_read_frame(format_ctx_, packet_) >= 0) {
+        if (packet_->stream_index != stream_index_) {
+            av_packet_unref(packet_);
+            continue;
+        }
+        if (packet_->pos == first->pos && packet_->pts != AV_NOPTS_VALUE) {
+            index_pts_delay_ = std::max<int64_t>(packet_->pts - first->timestamp, 0);
+        }
+        av_packet_unref(packet_);
+        break;
+    }
+    return true;
+}
+
+int64_t ThumbnailEngine::ToStreamTimestamp(int64_t timestampMs) const {
+    AVStream* stream = format_ctx_->streams[stream_index_];
+    int64_t startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    return startTime + av_rescale_q(timestampMs, AVRational{1, 1000}, stream->time_base);
+}
+
+bool ThumbnailEngine::ShouldSeek(int64_t target) const {
+    if (!has_decoded_frame_ && !eof_) return true;
+    // Every target up to the decoded frame, down to just after the frame
+    // before it, resolves to that frame again.
+    if (target < reusable_from_) return true;
+    if (eof_) return false;
+
+    // Seeking only pays off if it skips a keyframe, otherwise the decoder
+    // would have to run through the same GOP again. Index entries are
+    // shifted to presentation times first.
+    AVStream* stream = format_ctx_->streams[stream_index_];
+    int index = av_index_search_timestamp(stream, target - index_pts_delay_, AVSEEK_FLAG_BACKWARD);
+    if (index >= 0) {
+        const AVIndexEntry* entry = avformat_index_get_entry(stream, index);
+        if (entry) return entry->timestamp + index_pts_delay_ > decoded_pts_;
+    }
+    return keyframe_interval_ > 0 && target - decoded_pts_ > keyframe_interval_;
+}
+
+void ThumbnailEngine::SeekTo(int64_t target) {
+    AVStream* stream = format_ctx_->streams[stream_index_];
+    int64_t startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    if (av_seek_frame(format_ctx_, stream_index_, target, AVSEEK_FLAG_BACKWARD) < 0) {
+        av_seek_frame(format_ctx_, stream_index_, startTime, AVSEEK_FLAG_BACKWARD);
+    }
+    avcodec_flush_buffers(codec_ctx_);
+    av_frame_unref(decoded_frame_);
+    has_decoded_frame_ = false;
+    eof_ = false;
+    keyframe_entry_ = -1;
+}
+
+bool ThumbnailEngine::DecodeUntil(int64_t target) {
+    // Decode forward until the first frame at or after the target, exactly
+    // like `ffmpeg -ss` does. If the input ends first, the last decoded frame
+    // is used instead.
+    if (has_decoded_frame_ && decoded_pts_ >= target) return true;
+    if (eof_) return has_decoded_frame_;
+
+    while (true) {
+        int ret = av_read_frame(format_ctx_, packet_);
+        if (ret < 0) {
+            eof_ = true;
+            avcodec_send_packet(codec_ctx_, nullptr);
+        } else if (packet_->stream_index != stream_index_) {
+            av_packet_unref(packet_);
+            continue;
+        } else {
+            avcodec_send_packet(codec_ctx_, packet_);
+            av_packet_unref(packet_);
+        }
+
+        while ((ret = avcodec_receive_frame(codec_ctx_, frame_)) == 0) {
+            int64_t pts = frame_->best_effort_timestamp;
+            av_frame_unref(decoded_frame_);
+            av_frame_move_ref(decoded_frame_, frame_);
+            // Right after a seek the frames before this one are unknown.
+            reusable_from_ = has_decoded_frame_ ? decoded_pts_ + 1 : target;
+            has_decoded_frame_ = true;
+            // Frames without a timestamp cannot be placed, take them as is.
+            decoded_pts_ = pts == AV_NOPTS_VALUE ? target : pts;
+            if (decoded_pts_ >= target) return true;
+        }
+        if (eof_ || (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)) break;
+    }
+    eof_ = true;
+    return has_decoded_frame_;
+}
+
+int ThumbnailEngine::FindKeyframeEntry(int64_t target) const {
+    AVStream* stream = format_ctx_->streams[stream_index_];
+    return av_index_search_timestamp(stream, target, AVSEEK_FLAG_BACKWARD);
+}
+
+bool ThumbnailEngine::DecodeKeyframeAt(int64_t target) {
+    SeekTo(target);
+
+    // The seek lands on the keyframe at or before the target. Everything
+    // else is dropped by the decoder without being decoded.
+    codec_ctx_->skip_frame = AVDISCARD_NONKEY;
+    bool draining = false;
+    while (!has_decoded_frame_) {
+        if (!draining) {
+            int ret = av_read_frame(format_ctx_, packet_);
+            if (ret < 0) {
+                draining = true;
+                avcodec_send_packet(codec_ctx_, nullptr);
+            } else if (packet_->stream_index != stream_index_) {
+                av_packet_unref(packet_);
+                continue;
+            } else {
+                avcodec_send_packet(codec_ctx_, packet_);
+                av_packet_unref(packet_);
+            }
+        }
+
+        int ret = avcodec_receive_frame(codec_ctx_, decoded_frame_);
+        if (ret == 0) {
+            int64_t pts = decoded_frame_->best_effort_timestamp;
+            has_decoded_frame_ = true;
+            decoded_pts_ = pts == AV_NOPTS_VALUE ? target : pts;
+            reusable_from_ = decoded_pts_;
+        } else if (draining || (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)) {
+            break;
+        }
+    }
+    codec_ctx_->skip_frame = AVDISCARD_DEFAULT;
+
+    keyframe_entry_ = has_decoded_frame_ ? FindKeyframeEntry(target) : -1;
+    return has_decoded_frame_;
+}
+
+bool ThumbnailEngine::OutputSize(int width, int* outWidth, int* outHeight) const {
+    bool swapped = rotation_ == 90 || rotation_ == 270;
+    int displayWidth = swapped ? decoded_frame_->height : decoded_frame_->width;
+    int displayHeight = swapped ? decoded_frame_->width : decoded_frame_->height;
+    if (displayWidth <= 0 || displayHeight <= 0) return false;
+
+    // Same result as `scale=<width>:-2`: keep the aspect ratio and round the
+    // height to an even number.
+    *outWidth = width > 0 ? width : displayWidth;
+    *outHeight = std::max(2, static_cast<int>(std::lround(
+        static_cast<double>(*outWidth) * displayHeight / displayWidth / 2.0)) * 2);
+    return true;
+}
+
+bool ThumbnailEngine::ScaleFrame(int width, int channels, std::vector<uint8_t>* pixels, int* outWidth, int* outHeight) {
+    int dstWidth = 0;
+    int dstHeight = 0;
+    if (!OutputSize(width, &dstWidth, &dstHeight)) return false;
+
+    bool swapped = rotation_ == 90 || rotation_ == 270;
+    int scaledWidth = swapped ? dstHeight : dstWidth;
+    int scaledHeight = swapped ? dstWidth : dstHeight;
+
+    scale_ctx_ = sws_getCachedContext(
+        scale_ctx_,
+        decoded_frame_->width, decoded_frame_->height,
+        static_cast<AVPixelFormat>(decoded_frame_->format),
+        scaledWidth, scaledHeight, channels == 4 ? AV_PIX_FMT_RGBA : AV_PIX_FMT_RGB24,
+        SWS_BICUBIC, nullptr, nullptr, nullptr);
+    if (!scale_ctx_) return false;
+
+    std::vector<uint8_t> scaled(static_cast<size_t>(scaledWidth) * scaledHeight * channels);
+    uint8_t* dstData[4] = {scaled.data(), nullptr, nullptr, nullptr};
+    int dstLinesize[4] = {scaledWidth * channels, 0, 0, 0};
+    sws_scale(scale_ctx_, decoded_frame_->data, decoded_frame_->linesize,
+              0, decoded_frame_->height, dstData, dstLinesize);
+
+    if (rotation_ == 0) {
+        *pixels = std::move(scaled);
+    } else {
+        RotatePixels(scaled, scaledWidth, scaledHeight, channels, rotation_, pixels);
+    }
+    *outWidth = dstWidth;
+    *outHeight = dstHeight;
+    return true;
+}
+
+bool ThumbnailEngine::ExtractThumbnail(
+    int64_t timestampMs,
+    int width,
+    const std::string& format,
+    std::vector<uint8_t>* imageBytes,
+    ThumbnailExactness exactness,
+    int quality) {
+    if (!format_ctx_ || !codec_ctx_) return false;
+
+    int64_t target = ToStreamTimestamp(timestampMs);
+    if (exactness == ThumbnailExactness::NearestKeyframe) {
+        return DecodeKeyframeAt(target) && EncodeDecodedFrame(width, format, quality, imageBytes);
+    }
+    SeekTo(target);
+    if (!DecodeUntil(target)) return false;
+    return EncodeDecodedFrame(width, format, quality, imageBytes);
+}
+
+void ThumbnailEngine::ExtractThumbnails(
+    const std::vector<int64_t>& timestampsMs,
+    int width,
+    const std::string& format,
+    std::vector<std::vector<uint8_t>>* images,
+    ThumbnailExactness exactness,
+    const ThumbnailCallback& onThumbnail,
+    int quality) {
+    images->assign(timestampsMs.size(), {});
+    if (!format_ctx_ || !codec_ctx_) return;
+
+    std::vector<size_t> order(timestampsMs.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return timestampsMs[a] < timestampsMs[b];
+    });
+
+    has_decoded_frame_ = false;
+    eof_ = false;
+    keyframe_entry_ = -1;
+    for (size_t i : order) {
+        int64_t target = ToStreamTimestamp(timestampsMs[i]);
+        if (exactness == ThumbnailExactness::NearestKeyframe) {
+            int entry = FindKeyframeEntry(target);
+            bool sameKeyframe = has_decoded_frame_ && entry >= 0 && entry == keyframe_entry_;
+            if (!sameKeyframe && !DecodeKeyframeAt(target)) continue;
+        } else {
+            if (ShouldSeek(target)) SeekTo(target);
+            if (!DecodeUntil(target)) continue;
+        }
+        if (EncodeDecodedFrame(width, format, quality, &(*images)[i]) && onThumbnail) {
+            onThumbnail(i, (*images)[i]);
+        }
+    }
+}
+
+bool ThumbnailEngine::EncodeDecodedFrame(
+    int width,
+    const std::string& format,
+    int quality,
+    std::vector<uint8_t>* imageBytes) {
+    int outWidth = 0;
+    int outHeight = 0;
+    // Raw frames go out as scaled, no encoder involved.
+    if (format == kRawThumbnailFormat) return ScaleFrame(width, 4, imageBytes, &outWidth, &outHeight);
+
+    // Upright frames are scaled straight into the encoder's input in one
+    // pass; rotated ones go through RGB to be rotated first.
+    if (rotation_ == 0) {
+        return OutputSize(width, &outWidth, &outHeight) &&
+            encoder_.EncodeFrame(decoded_frame_, outWidth, outHeight, format, quality, imageBytes);
+    }
+
+    std::vector<uint8_t> rgb;
+    if (!ScaleFrame(width, 3, &rgb, &outWidth, &outHeight)) return false;
+    return encoder_.EncodeRgb(rgb.data(), outWidth, outHeight, format, quality, imageBytes);
+}
+
+std::unique_ptr<ThumbnailEngine> ThumbnailEnginePool::Acquire(std::string* error, int concurrentDecoders) {
+    if (std::unique_ptr<ThumbnailEngine> idle = TryAcquireIdle()) return idle;
+
+    auto engine = std::make_unique<ThumbnailEngine>();
+    if (!engine->Open(source_, error, DecoderThreadingFor(DecodeWorkload::Thumbnails, concurrentDecoders))) {
+        return nullptr;
+    }
+    return engine;
+}
+
+std::unique_ptr<ThumbnailEngine> ThumbnailEnginePool::TryAcquireIdle() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_.empty()) return nullptr;
+    std::unique_ptr<ThumbnailEngine> engine = std::move(idle_.back());
+    idle_.pop_back();
+    return engine;
+}
+
+void ThumbnailEnginePool::Release(std::unique_ptr<ThumbnailEngine> engine) {
+    if (!engine) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.push_back(std::move(engine));
+}
+
+size_t ThumbnailEnginePool::MemoryUsage() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t total = 0;
+    for (const auto& engine : idle_) total += engine->MemoryUsage();
+    return total;
+}
+
+std::vector<std::vector<uint8_t>> GenerateThumbnailsInProcess(
+    ThumbnailEnginePool& engines,
+    const std::vector<int64_t>& timestampsMs,
+    int width,
+    const std::string& format,
+    ThumbnailExactness exactness,
+    int maxConcurrency,
+    const ThumbnailCallback& onThumbnail,
+    int quality) {
+    std::vector<std::vector<uint8_t>> thumbnails(timestampsMs.size());
+    if (timestampsMs.empty()) return thumbnails;
+
+    // Every new decoder has to open and probe the input, so only split when
+    // each one gets a few timestamps.
+    ThreadPool& pool = ThreadPool::Shared();
+    size_t decoders = (timestampsMs.size() + kMinTimestampsPerDecoder - 1) / kMinTimestampsPerDecoder;
+    decoders = std::min(decoders, pool.size());
+    if (maxConcurrency > 0) decoders = std::min(decoders, static_cast<size_t>(maxConcurrency));
+
+    if (decoders <= 1) {
+        std::unique_ptr<ThumbnailEngine> engine = engines.Acquire(nullptr, 1);
+        if (engine) {
+            engine->ExtractThumbnails(timestampsMs, width, format, &thumbnails, exactness, onThumbnail, quality);
+            engines.Release(std::move(engine));
+        }
+        return thumbnails;
+    }
+
+    // Contiguous time ranges keep the strip mode effective in every chunk.
+    std::vector<size_t> order(timestampsMs.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return timestampsMs[a] < timestampsMs[b];
+    });
+
+    std::vector<std::future<void>> futures;
+    for (size_t chunk = 0; chunk < decoders; ++chunk) {
+        size_t begin = order.size() * chunk / decoders;
+        size_t end = order.size() * (chunk + 1) / decoders;
+        futures.push_back(pool.Submit([&, begin, end]() {
+            std::unique_ptr<ThumbnailEngine> engine = engines.Acquire(nullptr, static_cast<int>(decoders));
+            if (!engine) return;
+
+            std::vector<int64_t> chunkTimestamps;
+            for (size_t i = begin; i < end; ++i) chunkTimestamps.push_back(timestampsMs[order[i]]);
+
+            ThumbnailCallback onChunkThumbnail;
+            if (onThumbnail) {
+                onChunkThumbnail = [&, begin](size_t index, const std::vector<uint8_t>& imageBytes) {
+                    onThumbnail(order[begin + index], imageBytes);
+                };
+            }
+
+            std::vector<std::vector<uint8_t>> images;
+            engine->ExtractThumbnails(chunkTimestamps, width, format, &images, exactness, onChunkThumbnail, quality);
+            for (size_t i = begin; i < end; ++i) thumbnails[order[i]] = std::move(images[i - begin]);
+            engines.Release(std::move(engine));
+        }));
+    }
+    for (auto& future : futures) pool.Wait(future);
+    return thumbnails;
+}
+
+std::vector<std::vector<uint8_t>> GenerateThumbnailsInProcess(
+    const MediaSource& source,
+    const std::vector<int64_t>& timestampsMs,
+    int width,
+    const std::string& format,
+    ThumbnailExactness exactness,
+    int maxConcurrency,
+    const ThumbnailCallback& onThumbnail,
+    int quality) {
+    ThumbnailEnginePool engines(source);
+    return GenerateThumbnailsInProcess(
+        engines, timestampsMs, width, format, exactness, maxConcurrency, onThumbnail, quality);
+}
+
+}  // namespace pro_video_editor
@@ -0,0 +1,214 @@
+// src/thumbnail_engine.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "decoder_threading.h"
+#include "image_encoder.h"
+#include "media_input.h"
+
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+namespace pro_video_editor {
+
+// How closely a thumbnail has to match its timestamp.
+enum class ThumbnailExactness {
+    // The first frame at or after the timestamp, like `ffmpeg -ss`.
+    Exact,
+    // The keyframe at or before the timestamp. Only keyframes are decoded,
+    // which is much faster on long GOPs.
+    NearestKeyframe,
+};
+
+// Thumbnail format for tightly packed RGBA8888 pixels, e.g. to upload them
+// as a texture without decoding an image first.
+constexpr const char kRawThumbnailFormat[] = "raw";
+
+// Returns the height of a raw thumbnail of |width| pixels and |size| bytes.
+inline int RawThumbnailHeight(int width, size_t size) {
+    return width > 0 ? static_cast<int>(size / (static_cast<size_t>(width) * 4)) : 0;
+}
+
+// Parses the Dart enum name ("exact" or "nearestKeyframe").
+ThumbnailExactness ParseThumbnailExactness(const std::string& name);
+
+// Receives a thumbnail as soon as it is encoded, with its index in the
+// requested timestamps.
+using ThumbnailCallback = std::function<void(size_t index, const std::vector<uint8_t>& imageBytes)>;
+
+// In-process thumbnail extractor built on libavformat, libavcodec and
+// libswscale.
+//
+// The input is opened and probed once; every requested timestamp reuses the
+// same demuxer, decoder and scaler instead of starting a new ffmpeg process.
+// An engine is not thread-safe, use one instance per thread.
+class ThumbnailEngine {
+public:
+    ThumbnailEngine();
+    ~ThumbnailEngine();
+
+    ThumbnailEngine(const ThumbnailEngine&) = delete;
+    ThumbnailEngine& operator=(const ThumbnailEngine&) = delete;
+
+    // Opens |source| and prepares a decoder for its best video stream,
+    // threaded as |threading|.
+    bool Open(
+        const MediaSource& source,
+        std::string* error,
+        const DecoderThreading& threading = DecoderThreadingFor(DecodeWorkload::Thumbnails));
+
+    // Decodes the frame for |timestampMs| (see ThumbnailExactness), scales
+    // it to |width| pixels (keeping the display aspect ratio and rotation)
+    // and encodes it as |format| ("jpeg", "png" or "webp"). With
+    // kRawThumbnailFormat the scaled RGBA pixels are returned as they are.
+    // |quality| (1-100) applies to lossy formats, see ImageEncoder.
+    bool ExtractThumbnail(
+        int64_t timestampMs,
+        int width,
+        const std::string& format,
+        std::vector<uint8_t>* imageBytes,
+        ThumbnailExactness exactness = ThumbnailExactness::Exact,
+        int quality = ImageEncoder::kDefaultQuality);
+
+    // Extracts one thumbnail per entry of |timestampsMs| into |images| (same
+    // order). Entries that could not be extracted are left empty.
+    //
+    // The timestamps are visited in ascending order. Between two of them the
+    // engine keeps decoding forward and only seeks when the demuxer index has
+    // a keyframe in between, so a dense strip (several timestamps per GOP) is
+    // decoded in a single linear pass while sparse timestamps still seek.
+    // With NearestKeyframe, timestamps sharing a keyframe reuse its frame.
+    // |onThumbnail|, if set, is called after every encoded image.
+    void ExtractThumbnails(
+        const std::vector<int64_t>& timestampsMs,
+        int width,
+        const std::string& format,
+        std::vector<std::vector<uint8_t>>* images,
+        ThumbnailExactness exactness = ThumbnailExactness::Exact,
+        const ThumbnailCallback& onThumbnail = nullptr,
+        int quality = ImageEncoder::kDefaultQuality);
+
+    // Returns true if the engine can encode images as |format|.
+    static bool SupportsFormat(const std::string& format);
+
+    // The opened input, nullptr if the engine is not open.
+    const MediaInput* input() const { return input_.get(); }
+
+    // Rough estimate of the memory held by the decoder, in bytes.
+    size_t MemoryUsage() const;
+
+private:
+    int64_t ToStreamTimestamp(int64_t timestampMs) const;
+    bool ShouldSeek(int64_t target) const;
+    void SeekTo(int64_t target);
+    bool DecodeUntil(int64_t target);
+    int FindKeyframeEntry(int64_t target) const;
+    bool DecodeKeyframeAt(int64_t target);
+    bool EncodeDecodedFrame(int width, const std::string& format, int quality, std::vector<uint8_t>* imageBytes);
+    bool OutputSize(int width, int* outWidth, int* outHeight) const;
+    bool ScaleFrame(int width, int channels, std::vector<uint8_t>* pixels, int* outWidth, int* outHeight);
+    void Close();
+
+    std::unique_ptr<MediaInput> input_;
+    AVFormatContext* format_ctx_ = nullptr;
+    AVCodecContext* codec_ctx_ = nullptr;
+    AVPacket* packet_ = nullptr;
+    AVFrame* frame_ = nullptr;
+    AVFrame* decoded_frame_ = nullptr;
+    SwsContext* scale_ctx_ = nullptr;
+    ImageEncoder encoder_;
+    int stream_index_ = -1;
+    int rotation_ = 0;
+
+    // Decoder position, in stream time base.
+    bool has_decoded_frame_ = false;
+    int64_t decoded_pts_ = 0;
+    bool eof_ = false;
+
+    // Targets from here to |decoded_pts_| decode to |decoded_frame_| again.
+    int64_t reusable_from_ = 0;
+
+    // Index entry of the keyframe in |decoded_frame_| in NearestKeyframe
+    // mode, -1 if unknown.
+    int keyframe_entry_ = -1;
+
+    // Average keyframe distance from the demuxer index, in stream time
+    // base. 0 if the index is empty.
+    int64_t keyframe_interval_ = 0;
+
+    // How far the presentation time of a keyframe lies after its index
+    // timestamp, in stream time base. 0 for indexes of presentation times.
+    int64_t index_pts_delay_ = 0;
+};
+
+// Hands out ThumbnailEngines opened on one source and keeps the released
+// ones open, so later requests skip probing and decoder setup. Thread-safe.
+class ThumbnailEnginePool {
+public:
+    // |source| must outlive the pool.
+    explicit ThumbnailEnginePool(const MediaSource& source) : source_(source) {}
+
+    ThumbnailEnginePool(const ThumbnailEnginePool&) = delete;
+    ThumbnailEnginePool& operator=(const ThumbnailEnginePool&) = delete;
+
+    // Returns an idle engine, or opens a new one threaded for
+    // |concurrentDecoders| decoders running at once. Idle engines keep the
+    // threading they were opened with. nullptr on failure.
+    std::unique_ptr<ThumbnailEngine> Acquire(std::string* error, int concurrentDecoders = 1);
+
+    // Returns an idle engine without opening one, nullptr if none is idle.
+    std::unique_ptr<ThumbnailEngine> TryAcquireIdle();
+
+    // Keeps |engine| open for the next Acquire.
+    void Release(std::unique_ptr<ThumbnailEngine> engine);
+
+    // Memory held by the idle engines, in bytes.
+    size_t MemoryUsage() const;
+
+private:
+    const MediaSource& source_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThumbnailEngine>> idle_;
+};
+
+// Extracts one thumbnail per entry of |timestampsMs| from the source of
+// |engines|. Entries that could not be extracted are left empty.
+//
+// The sorted timestamps are split into contiguous chunks, each decoded by
+// its own ThumbnailEngine on the shared ThreadPool. At most |maxConcurrency|
+// decoders run at once; 0 uses every worker of the pool.
+//
+// |onThumbnail|, if set, receives every thumbnail in order of completion.
+// It is called from the pool workers, possibly concurrently.
+std::vector<std::vector<uint8_t>> GenerateThumbnailsInProcess(
+    ThumbnailEnginePool& engines,
+    const std::vector<int64_t>& timestampsMs,
+    int width,
+    const std::string& format,
+    ThumbnailExactness exactness = ThumbnailExactness::Exact,
+    int maxConcurrency = 0,
+    const ThumbnailCallback& onThumbnail = nullptr,
+    int quality = ImageEncoder::kDefaultQuality);
+
+// Same as above with engines that are closed again afterwards.
+std::vector<std::vector<uint8_t>> GenerateThumbnailsInProcess(
+    const MediaSource& source,
+    const std::vector<int64_t>& timestampsMs,
+    int width,
+    const std::string& format,
+    ThumbnailExactness exactness = ThumbnailExactness::Exact,
+    int maxConcurrency = 0,
+    const ThumbnailCallback& onThumbnail = nullptr,
+    int quality = ImageEncoder::kDefaultQuality);
+
+}  // namespace pro_video_editor
@@ -1,118 +1,314 @@
 #include "thumbnail_generator.h"
 
-#include <flutter/standard_method_codec.h>
-
-#include <fstream>
+#include <algorithm>
 #include <string>
 #include <vector>
-#include <sstream>
-#include <iostream>
-#include <chrono>
-#include <filesystem>
+#include <cmath>
 #include <future>
-#include <cstdlib>
-#include <iomanip>
+#include <cstdio>
 
-namespace fs = std::filesystem;
-namespace pro_video_editor {
+#include "ffmpeg_cli_thumbnailer.h"
+#include "image_encoder.h"
+#include "method_args.h"
+#include "scratch_storage.h"
+#include "sprite_sheet.h"
+#include "thread_pool.h"
+#include "thumbnail_cache.h"
+#include "thumbnail_engine.h"
+#include "video_session.h"
 
-std::string GenerateTempFilename(const std::string& prefix, const std::string& extension) {
-    std::stringstream filename;
-    auto now = std::chrono::system_clock::now();
-    auto time = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now.time_since_epoch()) % 1000;
+namespace pro_video_editor {
 
-    std::tm tm = *std::localtime(&time);
-    filename << "/tmp/" << prefix << "_"
-             << std::put_time(&tm, "%Y%m%d%H%M%S")
-             << ms.count() << extension;
+namespace {
 
-    return filename.str();
+// Describes a raw thumbnail, whose bytes alone do not tell its size.
+FlValue* NewRawThumbnailValue(const std::vector<uint8_t>& pixels, int width) {
+    FlValue* value = fl_value_new_map();
+    fl_value_set_string_take(value, "bytes", fl_value_new_uint8_list(pixels.data(), pixels.size()));
+    fl_value_set_string_take(value, "width", fl_value_new_int(width));
+    fl_value_set_string_take(value, "height", fl_value_new_int(RawThumbnailHeight(width, pixels.size())));
+    return value;
 }
 
-bool WriteBytesToFile(const std::string& path, const std::vector<uint8_t>& bytes) {
-    std::ofstream out(path, std::ios::binary);
-    if (!out.is_open()) return false;
-    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
-    return true;
-}
+}  // namespace
 
-void HandleGenerateThumbnails(
-    const flutter::EncodableMap& args,
-    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+FlMethodResponse* HandleGenerateThumbnails(
+    const MethodArgs& args,
+    const ThumbnailEventCallback& onThumbnail) {
 
-    const auto* videoBytes = std::get_if<std::vector<uint8_t>>(&args.at(flutter::EncodableValue("videoBytes")));
-    const auto* timestampsList = std::get_if<flutter::EncodableList>(&args.at(flutter::EncodableValue("timestamps")));
-    const auto* formatStr = std::get_if<std::string>(&args.at(flutter::EncodableValue("thumbnailFormat")));
-    const auto* extensionStr = std::get_if<std::string>(&args.at(flutter::EncodableValue("extension")));
-    const auto* width = std::get_if<double>(&args.at(flutter::EncodableValue("imageWidth")));
+    FlMethodResponse* errorResponse = nullptr;
+    std::shared_ptr<MediaSession> session = ReadMediaSession(args, &errorResponse);
+    if (!session) {
+        return errorResponse;
+    }
+    const MediaSource& source = session->source();
+
+    FlValue* timestampsList = args.GetList("timestamps");
+    std::string formatStr;
+    double width = 0;
+    if (!timestampsList || !args.GetString("thumbnailFormat", &formatStr) || !args.GetDouble("imageWidth", &width)) {
+        return ErrorResponse("InvalidArgument", "Missing required parameters");
+    }
 
-    if (!videoBytes || !timestampsList || !formatStr || !extensionStr || !width) {
-        result->Error("InvalidArgument", "Missing required parameters");
-        return;
+    ThumbnailExactness exactness = ThumbnailExactness::Exact;
+    std::string exactnessName;
+    if (args.GetString("exactness", &exactnessName)) {
+        exactness = ParseThumbnailExactness(exactnessName);
     }
 
-    int roundedWidth = static_cast<int>(std::round(*width));
-    std::string videoExt = *extensionStr;
-    if (videoExt.empty() || videoExt[0] != '.') videoExt = "." + videoExt;
+    int64_t maxConcurrency = 0;
+    args.GetInt("maxConcurrency", &maxConcurrency);
+
+    int64_t quality = ImageEncoder::kDefaultQuality;
+    args.GetInt("quality", &quality);
 
-    std::string imageExt = *formatStr;
+    int roundedWidth = static_cast<int>(std::round(width));
+    bool raw = formatStr == kRawThumbnailFormat;
+    std::string imageExt = formatStr;
     if (imageExt.empty() || imageExt[0] != '.') imageExt = "." + imageExt;
 
-    std::string tempVideoPath = GenerateTempFilename("video_temp", videoExt);
-    if (!WriteBytesToFile(tempVideoPath, *videoBytes)) {
-        result->Error("FileError", "Failed to write temp video file");
-        return;
+    std::vector<int64_t> timestampsMs;
+    std::vector<size_t> thumbnailIndices;
+    size_t timestampCount = fl_value_get_length(timestampsList);
+    for (size_t i = 0; i < timestampCount; ++i) {
+        FlValue* tsValue = fl_value_get_list_value(timestampsList, i);
+        if (fl_value_get_type(tsValue) != FL_VALUE_TYPE_INT) continue;
+        timestampsMs.push_back(fl_value_get_int(tsValue));
+        thumbnailIndices.push_back(i);
     }
 
-    // Assume `ffmpeg` is in system PATH on Linux
-    std::string ffmpegPath = "ffmpeg";
+    // Reports thumbnails with their index in the requested list.
+    ThumbnailCallback onImage;
+    if (onThumbnail) {
+        onImage = [&](size_t index, const std::vector<uint8_t>& imageBytes) {
+            FlValue* event = raw ? NewRawThumbnailValue(imageBytes, roundedWidth) : fl_value_new_map();
+            if (!raw) fl_value_set_string_take(event, "bytes", fl_value_new_uint8_list(imageBytes.data(), imageBytes.size()));
+            fl_value_set_string_take(event, "index", fl_value_new_int(static_cast<int64_t>(thumbnailIndices[index])));
+            onThumbnail(event);
+        };
+    }
 
-    std::vector<std::future<void>> futures;
-    std::vector<flutter::EncodableValue> thumbnails(timestampsList->size());
+    // Serve what was generated before straight from the cache. Raw frames
+    // are cheap to recreate compared to their size, so they are not cached.
+    ThumbnailCache& cache = ThumbnailCache::Shared();
+    std::vector<std::vector<uint8_t>> images(timestampsMs.size());
+    std::vector<std::string> cacheKeys;
+    uint64_t contentHash = 0;
+    if (!raw && session->ContentHash(&contentHash)) {
+        for (int64_t timestampMs : timestampsMs) {
+            cacheKeys.push_back(ThumbnailCache::MakeKey(
+                contentHash, timestampMs, roundedWidth, formatStr, exactness, static_cast<int>(quality)));
+        }
+    }
 
-    int index = 0;
-    for (const auto& tsValue : *timestampsList) {
-        if (!std::holds_alternative<int>(tsValue)) {
-            ++index;
-            continue;
+    std::vector<size_t> uncached;
+    for (size_t i = 0; i < timestampsMs.size(); ++i) {
+        if (!cacheKeys.empty() && cache.Lookup(cacheKeys[i], &images[i])) {
+            if (onImage) onImage(i, images[i]);
+        } else {
+            uncached.push_back(i);
         }
+    }
 
-        int currentIndex = index++;
-        int64_t tsMs = static_cast<int64_t>(std::get<int>(tsValue));
-        double tsSec = tsMs / 1000.0;
+    // Decode the rest in-process on the shared pool.
+    if (!uncached.empty() && ThumbnailEngine::SupportsFormat(formatStr)) {
+        std::vector<int64_t> uncachedTimestamps;
+        for (size_t i : uncached) uncachedTimestamps.push_back(timestampsMs[i]);
 
-        futures.push_back(std::async(std::launch::async, [=, &thumbnails]() {
-            std::ostringstream timestampStream;
-            timestampStream << std::fixed << std::setprecision(3) << tsSec;
+        ThumbnailCallback onDecoded;
+        if (onImage) {
+            onDecoded = [&](size_t index, const std::vector<uint8_t>& imageBytes) {
+                onImage(uncached[index], imageBytes);
+            };
+        }
 
-            std::string tempImagePath = GenerateTempFilename("thumb_" + std::to_string(currentIndex), imageExt);
+        std::vector<std::vector<uint8_t>> decoded = GenerateThumbnailsInProcess(
+            session->engines(), uncachedTimestamps, roundedWidth, formatStr, exactness,
+            static_cast<int>(maxConcurrency), onDecoded, static_cast<int>(quality));
+        for (size_t k = 0; k < uncached.size(); ++k) images[uncached[k]] = std::move(decoded[k]);
+    }
 
-            std::ostringstream cmd;
-            cmd << ffmpegPath
-                << " -ss " << timestampStream.str()
-                << " -i \"" << tempVideoPath << "\""
-                << " -vframes 1 -vf scale=" << roundedWidth << ":-2"
-                << " \"" << tempImagePath << "\"";
+    // Fall back to the ffmpeg executable for frames the engine could not
+    // produce, e.g. when the required image encoder is not built in. Only
+    // this path needs the video on disk. Raw frames never need an encoder.
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < images.size() && !raw; ++i) {
+        if (images[i].empty()) missing.push_back(i);
+    }
 
-            int retCode = std::system(cmd.str().c_str());
+    // Bytes are shared with the child through a scratch file, which stays
+    // in memory unless scratch storage is configured to use a directory.
+    FFmpegCliInput cliInput;
+    cliInput.path = source.path;
+    std::unique_ptr<ScratchFile> scratchVideo;
+    if (!missing.empty() && cliInput.path.empty()) {
+        std::string error;
+        scratchVideo = ScratchFile::CreateWithData("video_temp", source.data, source.size, &error);
+        if (!scratchVideo) {
+            return ErrorResponse("FileError", error);
+        }
+        cliInput.fd = scratchVideo->fd();
+    }
 
-            if (retCode == 0 && fs::exists(tempImagePath)) {
-                std::ifstream in(tempImagePath, std::ios::binary);
-                std::vector<uint8_t> imageBytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-                thumbnails[currentIndex] = flutter::EncodableValue(imageBytes);
-                std::remove(tempImagePath.c_str());
+    // At most one ffmpeg process per pool worker (or |maxConcurrency|).
+    ThreadPool& pool = ThreadPool::Shared();
+    size_t chunks = std::min(missing.size(), pool.size());
+    if (maxConcurrency > 0) chunks = std::min(chunks, static_cast<size_t>(maxConcurrency));
+    std::vector<std::future<void>> futures;
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        futures.push_back(pool.Submit([&, chunk]() {
+            for (size_t k = chunk; k < missing.size(); k += chunks) {
+                size_t i = missing[k];
+                if (ExtractThumbnailWithFFmpegCli(cliInput, timestampsMs[i], roundedWidth, imageExt, &images[i]) && onImage) {
+                    onImage(i, images[i]);
+                }
             }
         }));
     }
 
     for (auto& fut : futures) {
-        fut.get();
+        pool.Wait(fut);
+    }
+
+    scratchVideo.reset();
+
+    // The ffmpeg executable ignores the quality of the key, so only engine
+    // results are cached; the next request retries the engine.
+    if (!cacheKeys.empty()) {
+        std::vector<bool> fromCli(images.size(), false);
+        for (size_t i : missing) fromCli[i] = true;
+        for (size_t i : uncached) {
+            if (!fromCli[i]) cache.Store(cacheKeys[i], images[i]);
+        }
+    }
+
+    // The session may hold more warm decoders now.
+    MediaSessionCache::Shared().Trim();
+
+    // Streamed thumbnails were already delivered.
+    if (onThumbnail) return SuccessResponse(nullptr);
+
+    std::vector<FlValue*> thumbnails(timestampCount, nullptr);
+    for (size_t i = 0; i < images.size(); ++i) {
+        if (images[i].empty()) continue;
+        thumbnails[thumbnailIndices[i]] = raw
+            ? NewRawThumbnailValue(images[i], roundedWidth)
+            : fl_value_new_uint8_list(images[i].data(), images[i].size());
+    }
+
+    FlValue* result = fl_value_new_list();
+    for (FlValue* thumbnail : thumbnails) {
+        fl_value_append_take(result, thumbnail ? thumbnail : fl_value_new_null());
+    }
+    return SuccessResponse(result);
+}
+
+FlMethodResponse* HandleCreateThumbnailSpriteSheet(const MethodArgs& args) {
+    FlMethodResponse* errorResponse = nullptr;
+    std::shared_ptr<MediaSession> session = ReadMediaSession(args, &errorResponse);
+    if (!session) {
+        return errorResponse;
+    }
+
+    FlValue* timestampsList = args.GetList("timestamps");
+    std::string formatStr;
+    double width = 0;
+    if (!timestampsList || !args.GetString("thumbnailFormat", &formatStr) || !args.GetDouble("imageWidth", &width)) {
+        return ErrorResponse("InvalidArgument", "Missing required parameters");
+    }
+    bool raw = formatStr == kRawThumbnailFormat;
+    if (!raw && !ImageEncoder::Supports(formatStr)) {
+        return ErrorResponse("InvalidArgument", "Unsupported sprite sheet format: " + formatStr);
+    }
+
+    ThumbnailExactness exactness = ThumbnailExactness::Exact;
+    std::string exactnessName;
+    if (args.GetString("exactness", &exactnessName)) {
+        exactness = ParseThumbnailExactness(exactnessName);
+    }
+
+    int64_t maxConcurrency = 0;
+    args.GetInt("maxConcurrency", &maxConcurrency);
+
+    int64_t quality = ImageEncoder::kDefaultQuality;
+    args.GetInt("quality", &quality);
+
+    int roundedWidth = static_cast<int>(std::round(width));
+    size_t timestampCount = fl_value_get_length(timestampsList);
+    std::vector<int64_t> timestampsMs;
+    std::vector<size_t> thumbnailIndices;
+    for (size_t i = 0; i < timestampCount; ++i) {
+        FlValue* tsValue = fl_value_get_list_value(timestampsList, i);
+        if (fl_value_get_type(tsValue) != FL_VALUE_TYPE_INT) continue;
+        timestampsMs.push_back(fl_value_get_int(tsValue));
+        thumbnailIndices.push_back(i);
+    }
+
+    int64_t columns = 0;
+    if (!args.GetInt("columns", &columns) || columns <= 0) {
+        columns = DefaultSpriteSheetColumns(timestampCount, roundedWidth);
     }
 
-    std::remove(tempVideoPath.c_str());
-    result->Success(thumbnails);
+    // The tiles are packed from raw frames, so every thumbnail is encoded
+    // once as part of the sheet instead of on its own.
+    std::vector<std::vector<uint8_t>> decoded = GenerateThumbnailsInProcess(
+        session->engines(), timestampsMs, roundedWidth, kRawThumbnailFormat, exactness,
+        static_cast<int>(maxConcurrency));
+    MediaSessionCache::Shared().Trim();
+
+    std::vector<std::vector<uint8_t>> frames(timestampCount);
+    for (size_t k = 0; k < decoded.size(); ++k) frames[thumbnailIndices[k]] = std::move(decoded[k]);
+    decoded.clear();
+
+    SpriteSheet sheet;
+    if (!ComposeSpriteSheet(frames, roundedWidth, static_cast<int>(columns), &sheet)) {
+        return ErrorResponse("ThumbnailError", "Failed to extract any thumbnail");
+    }
+    frames.clear();
+
+    std::vector<uint8_t> imageBytes;
+    if (raw) {
+        imageBytes = std::move(sheet.pixels);
+    } else {
+        ImageEncoder encoder;
+        if (!encoder.EncodeRgba(sheet.pixels.data(), sheet.width, sheet.height, formatStr,
+                                static_cast<int>(quality), &imageBytes)) {
+            return ErrorResponse("ThumbnailError", "Failed to encode the sprite sheet");
+        }
+    }
+
+    FlValue* tiles = fl_value_new_list();
+    for (const SpriteTile& tile : sheet.tiles) {
+        if (tile.width == 0) {
+            fl_value_append_take(tiles, fl_value_new_null());
+            continue;
+        }
+        FlValue* rect = fl_value_new_map();
+        fl_value_set_string_take(rect, "x", fl_value_new_int(tile.x));
+        fl_value_set_string_take(rect, "y", fl_value_new_int(tile.y));
+        fl_value_set_string_take(rect, "width", fl_value_new_int(tile.width));
+        fl_value_set_string_take(rect, "height", fl_value_new_int(tile.height));
+        fl_value_append_take(tiles, rect);
+    }
+
+    FlValue* result = fl_value_new_map();
+    fl_value_set_string_take(result, "bytes", fl_value_new_uint8_list(imageBytes.data(), imageBytes.size()));
+    fl_value_set_string_take(result, "width", fl_value_new_int(sheet.width));
+    fl_value_set_string_take(result, "height", fl_value_new_int(sheet.height));
+    fl_value_set_string_take(result, "tiles", tiles);
+    return SuccessResponse(result);
+}
+
+FlMethodResponse* HandleGetThumbnailCacheStats() {
+    ThumbnailCache::Stats stats = ThumbnailCache::Shared().stats();
+
+    FlValue* result = fl_value_new_map();
+    fl_value_set_string_take(result, "memoryHits", fl_value_new_int(static_cast<int64_t>(stats.memoryHits)));
+    fl_value_set_string_take(result, "diskHits", fl_value_new_int(static_cast<int64_t>(stats.diskHits)));
+    fl_value_set_string_take(result, "misses", fl_value_new_int(static_cast<int64_t>(stats.misses)));
+    fl_value_set_string_take(result, "memoryBytes", fl_value_new_int(static_cast<int64_t>(stats.memoryBytes)));
+    fl_value_set_string_take(result, "diskBytes", fl_value_new_int(static_cast<int64_t>(stats.diskBytes)));
+    return SuccessResponse(result);
 }
 
 } // namespace pro_video_editor
@@ -1,14 +1,38 @@
-// src/video_processor.h
+// src/thumbnail_generator.h
 #pragma once
 
-#include <flutter/standard_method_codec.h>
-#include <flutter/method_result_functions.h>
+#include <functional>
+
+#include "method_args.h"
+#include "thumbnail_engine.h"
 
 namespace pro_video_editor {
 
-	void HandleGenerateThumbnails(
-        const flutter::EncodableMap& args,
-        std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
-    
-    }  // namespace pro_video_editor
-    
\ No newline at end of file
+    // Receives one streamed thumbnail as a map with its `index` and
+    // `bytes`, plus `width` and `height` for raw thumbnails. The callee
+    // takes ownership: FlValue reference counts are not atomic, so the
+    // worker thread must not touch the event once it is handed over.
+    using ThumbnailEventCallback = std::function<void(FlValue* event)>;
+
+    // Generates the thumbnails of a `createVideoThumbnails` call.
+    //
+    // Without |onThumbnail| the result is the list of images; raw
+    // thumbnails are maps of `bytes`, `width` and `height`. With it, every
+    // image is passed to |onThumbnail| as soon as it is encoded (possibly
+    // from several threads) and the result is null once all are done.
+    FlMethodResponse* HandleGenerateThumbnails(
+        const MethodArgs& args,
+        const ThumbnailEventCallback& onThumbnail = nullptr);
+
+    // Generates the thumbnails of a `createThumbnailSpriteSheet` call and
+    // packs them into one image of `thumbnailFormat` (raw for RGBA pixels),
+    // `columns` tiles wide if given. The result is a map of the image
+    // `bytes`, its `width` and `height`, and `tiles`: one map of `x`, `y`,
+    // `width` and `height` per timestamp, null for failed thumbnails.
+    FlMethodResponse* HandleCreateThumbnailSpriteSheet(const MethodArgs& args);
+
+    // Returns the hit and miss counters of the thumbnail cache. Cheap, may
+    // run on the main thread.
+    FlMethodResponse* HandleGetThumbnailCacheStats();
+
+}  // namespace pro_video_editor
@@ -0,0 +1,93 @@
+#include "video_exporter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "video_session.h"
+
+namespace pro_video_editor {
+
+FlMethodResponse* HandleExportVideo(
+    const MethodArgs& args,
+    const ExportProgressCallback& onProgress) {
+
+    // An open session saves sending the video again; the export still opens
+    // its own demuxer since it reads every stream.
+    FlMethodResponse* errorResponse = nullptr;
+    std::shared_ptr<MediaSession> session = ReadMediaSession(args, &errorResponse);
+    if (!session) {
+        return errorResponse;
+    }
+
+    ExportVideoOptions options;
+    options.source = session->source();
+    std::string error;
+
+    args.GetBytes("imageBytes", &options.imageData, &options.imageSize);
+
+    if (FlValue* codecArgs = args.GetList("codecArgs")) {
+        for (size_t i = 0; i < fl_value_get_length(codecArgs); ++i) {
+            FlValue* arg = fl_value_get_list_value(codecArgs, i);
+            if (fl_value_get_type(arg) == FL_VALUE_TYPE_STRING) options.codecArgs.push_back(fl_value_get_string(arg));
+        }
+    }
+
+    args.GetString("outputFormat", &options.outputFormat);
+    args.GetString("filters", &options.filters);
+    args.GetBool("allowStreamCopy", &options.allowStreamCopy);
+    int64_t parallelSegments = 1;
+    if (args.GetInt("parallelSegments", &parallelSegments)) {
+        options.parallelSegments = static_cast<int>(std::clamp<int64_t>(parallelSegments, 0, 64));
+    }
+
+    if (FlValue* matrices = args.GetList("colorMatrices")) {
+        for (size_t i = 0; i < fl_value_get_length(matrices); ++i) {
+            FlValue* value = fl_value_get_list_value(matrices, i);
+            std::vector<double> matrix;
+            if (fl_value_get_type(value) == FL_VALUE_TYPE_LIST) {
+                for (size_t j = 0; j < fl_value_get_length(value); ++j) {
+                    double number = 0;
+                    if (ReadNumber(fl_value_get_list_value(value, j), &number)) matrix.push_back(number);
+                }
+            } else if (fl_value_get_type(value) == FL_VALUE_TYPE_FLOAT_LIST) {
+                const double* numbers = fl_value_get_float_list(value);
+                matrix.assign(numbers, numbers + fl_value_get_length(value));
+            }
+            options.colorMatrices.push_back(std::move(matrix));
+        }
+    }
+
+    // Dart sends integers for whole seconds but may send doubles as well.
+    args.GetDouble("startTime", &options.startTime);
+    args.GetDouble("endTime", &options.endTime);
+    double videoDuration = 0;
+    if (args.GetDouble("videoDuration", &videoDuration)) {
+        options.videoDurationMs = static_cast<int64_t>(videoDuration);
+    }
+
+    // With an output path or descriptor the muxer writes straight to it and
+    // only the path is returned, so the video is never held in memory.
+    args.GetString("outputPath", &options.outputPath);
+    int64_t outputFd = -1;
+    if (options.outputPath.empty() && args.GetInt("outputFd", &outputFd)) {
+        options.outputFd = static_cast<int>(outputFd);
+    }
+    if (!options.outputPath.empty() || options.outputFd >= 0) {
+        if (!ExportVideo(options, nullptr, onProgress, &error)) {
+            return ErrorResponse("FFmpegError", "Export failed: " + error);
+        }
+        return SuccessResponse(options.outputPath.empty() ? fl_value_new_null()
+                                                          : fl_value_new_string(options.outputPath.c_str()));
+    }
+
+    std::vector<uint8_t> output;
+    if (!ExportVideo(options, &output, onProgress, &error)) {
+        return ErrorResponse("FFmpegError", "Export failed: " + error);
+    }
+
+    return SuccessResponse(fl_value_new_uint8_list(output.data(), output.size()));
+}
+
+}  // namespace pro_video_editor
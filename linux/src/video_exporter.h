@@ -0,0 +1,16 @@
+// src/video_exporter.h
+#pragma once
+
+#include "export_video.h"
+#include "method_args.h"
+
+namespace pro_video_editor {
+
+    // Renders the video described by |args| and returns the encoded bytes.
+    // Blocks until the export is done, so call it off the main thread.
+    // |onProgress| receives values from 0.0 to 1.0 on the calling thread.
+    FlMethodResponse* HandleExportVideo(
+        const MethodArgs& args,
+        const ExportProgressCallback& onProgress);
+
+}  // namespace pro_video_editor
@@ -0,0 +1,90 @@
+#include "video_metadata.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/pixdesc.h>
+}
+
+#include "av_utils.h"
+
+namespace pro_video_editor {
+
+namespace {
+
+double FramesPerSecond(AVRational rate) {
+    return rate.num > 0 && rate.den > 0 ? av_q2d(rate) : 0;
+}
+
+AudioStreamMetadata ReadAudioStreamMetadata(const AVStream* stream) {
+    const AVCodecParameters* codecpar = stream->codecpar;
+    AudioStreamMetadata audio;
+    audio.codec = avcodec_get_name(codecpar->codec_id);
+    if (const char* name = av_get_sample_fmt_name(static_cast<AVSampleFormat>(codecpar->format))) {
+        audio.sampleFormat = name;
+    }
+    audio.sampleRate = codecpar->sample_rate;
+    audio.bitRate = codecpar->bit_rate;
+
+    char layout[64] = {0};
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 24, 100)
+    audio.channels = codecpar->ch_layout.nb_channels;
+    if (codecpar->ch_layout.order != AV_CHANNEL_ORDER_UNSPEC &&
+        av_channel_layout_describe(&codecpar->ch_layout, layout, sizeof(layout)) > 0) {
+        audio.channelLayout = layout;
+    }
+#else
+    audio.channels = codecpar->channels;
+    if (codecpar->channel_layout != 0) {
+        av_get_channel_layout_string(layout, sizeof(layout), codecpar->channels, codecpar->channel_layout);
+        audio.channelLayout = layout;
+    }
+#endif
+    return audio;
+}
+
+}  // namespace
+
+bool ReadVideoMetadata(AVFormatContext* format_ctx, int64_t fileSize, VideoMetadata* metadata) {
+    int videoIndex = FindVideoStreamIndex(format_ctx);
+    if (videoIndex < 0) return false;
+
+    AVStream* video = format_ctx->streams[videoIndex];
+    const AVCodecParameters* codecpar = video->codecpar;
+    metadata->durationMs = format_ctx->duration > 0
+        ? static_cast<double>(format_ctx->duration) / (AV_TIME_BASE / 1000)
+        : static_cast<double>(video->duration) * av_q2d(video->time_base) * 1000.0;
+    metadata->width = codecpar->width;
+    metadata->height = codecpar->height;
+    metadata->fileSize = fileSize;
+
+    metadata->frameRate = FramesPerSecond(video->r_frame_rate);
+    metadata->averageFrameRate = FramesPerSecond(video->avg_frame_rate);
+    metadata->rotation = GetDisplayRotation(video);
+
+    if (format_ctx->iformat && format_ctx->iformat->name) metadata->containerFormat = format_ctx->iformat->name;
+    metadata->videoCodec = avcodec_get_name(codecpar->codec_id);
+    if (const char* name = av_get_pix_fmt_name(static_cast<AVPixelFormat>(codecpar->format))) {
+        metadata->pixelFormat = name;
+    }
+    metadata->videoBitRate = codecpar->bit_rate;
+    metadata->bitRate = format_ctx->bit_rate;
+
+    metadata->audioStreams.clear();
+    for (unsigned i = 0; i < format_ctx->nb_streams; ++i) {
+        if (format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+            metadata->audioStreams.push_back(ReadAudioStreamMetadata(format_ctx->streams[i]));
+        }
+    }
+
+    metadata->indexEntries = avformat_index_get_entries_count(video);
+    metadata->keyframeCount = 0;
+    for (int i = 0; i < metadata->indexEntries; ++i) {
+        const AVIndexEntry* entry = avformat_index_get_entry(video, i);
+        if (entry && (entry->flags & AVINDEX_KEYFRAME)) ++metadata->keyframeCount;
+    }
+    return true;
+}
+
+}  // namespace pro_video_editor
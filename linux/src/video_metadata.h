@@ -0,0 +1,63 @@
+// src/video_metadata.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct AVFormatContext;
+
+namespace pro_video_editor {
+
+struct AudioStreamMetadata {
+    std::string codec;
+    // Empty if the probe did not tell it.
+    std::string sampleFormat;
+    int sampleRate = 0;
+    int channels = 0;
+    // E.g. "stereo" or "5.1"; empty if unknown.
+    std::string channelLayout;
+    int64_t bitRate = 0;
+};
+
+// Everything getVideoInformation reports, read from one probed input so
+// callers do not have to open the video again. Zero or empty fields were
+// not known to the probe; a fast probe relies on the container headers, so
+// e.g. the pixel format may be missing where a full probe has it.
+struct VideoMetadata {
+    double durationMs = 0;
+    int width = 0;
+    int height = 0;
+    int64_t fileSize = 0;
+
+    // The base frame rate (r_frame_rate) and the average one, in frames
+    // per second.
+    double frameRate = 0;
+    double averageFrameRate = 0;
+
+    // Clockwise display rotation in degrees (0, 90, 180 or 270). |width|
+    // and |height| are the coded size, before the rotation.
+    int rotation = 0;
+
+    std::string containerFormat;
+    std::string videoCodec;
+    std::string pixelFormat;
+
+    // Bits per second of the video stream and of the whole container.
+    int64_t videoBitRate = 0;
+    int64_t bitRate = 0;
+
+    std::vector<AudioStreamMetadata> audioStreams;
+
+    // Entries and keyframes in the demuxer's index of the video stream.
+    // Some containers load their index lazily (e.g. Matroska cues), so it
+    // may be empty right after probing.
+    int indexEntries = 0;
+    int keyframeCount = 0;
+};
+
+// Reads the metadata of the best video stream of |format_ctx|. Returns
+// false if the input has no video stream.
+bool ReadVideoMetadata(AVFormatContext* format_ctx, int64_t fileSize, VideoMetadata* metadata);
+
+}  // namespace pro_video_editor
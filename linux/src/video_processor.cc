@@ -1,122 +1,174 @@
 #include "video_processor.h"
 
-extern "C" {
-#include <libavformat/avformat.h>
-#include <libavutil/dict.h>
-}
-
-#include <flutter/standard_method_codec.h>
-#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
-#include <sstream>
-#include <filesystem>
-#include <chrono>
-#include <iomanip>
-#include <iostream>
 
-namespace fs = std::filesystem;
+#include "media_input.h"
+#include "method_args.h"
+#include "thread_pool.h"
+#include "thumbnail_engine.h"
+#include "video_metadata.h"
+#include "video_session.h"
+
 namespace pro_video_editor {
 
-std::string GenerateTempFilename(const std::string& extension) {
-    std::stringstream filename;
-    auto now = std::chrono::system_clock::now();
-    auto time = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-
-    std::tm tm = *std::localtime(&time);
-    filename << "/tmp/vid_"
-             << std::put_time(&tm, "%Y%m%d%H%M%S")
-             << ms.count()
-             << extension;
-    return filename.str();
-}
+namespace {
 
-bool WriteBytesToFile(const std::string& path, const std::vector<uint8_t>& bytes) {
-    std::ofstream out(path, std::ios::binary);
-    if (!out.is_open()) return false;
-    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
-    return true;
+void SetString(FlValue* map, const char* key, const std::string& value) {
+    fl_value_set_string_take(map, key, value.empty() ? fl_value_new_null() : fl_value_new_string(value.c_str()));
 }
 
-void HandleGetVideoInformation(
-    const flutter::EncodableMap& args,
-    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+MediaProbe ReadProbe(const MethodArgs& args) {
+    std::string probeName;
+    return args.GetString("probeMode", &probeName) ? ParseMediaProbe(probeName) : MediaProbe::Full;
+}
 
-    // Extract videoBytes
-    auto itVideo = args.find(flutter::EncodableValue("videoBytes"));
-    if (itVideo == args.end() || !std::holds_alternative<std::vector<uint8_t>>(itVideo->second)) {
-        result->Error("InvalidArgument", "Missing or invalid videoBytes");
-        return;
+// Reads the metadata of the video of |session|. A warm engine of the
+// session already has the input probed. Otherwise only the demuxer is
+// opened with |probe|, without any decoder.
+bool ProbeSession(MediaSession& session, MediaProbe probe, VideoMetadata* metadata, std::string* error) {
+    std::unique_ptr<ThumbnailEngine> engine = session.engines().TryAcquireIdle();
+    std::unique_ptr<MediaInput> probed;
+    if (!engine) {
+        probed = MediaInput::Open(session.source(), error, probe);
+        if (!probed) return false;
     }
-    const auto& videoBytes = std::get<std::vector<uint8_t>>(itVideo->second);
 
-    // Extract extension
-    auto itExt = args.find(flutter::EncodableValue("extension"));
-    if (itExt == args.end() || !std::holds_alternative<std::string>(itExt->second)) {
-        result->Error("InvalidArgument", "Missing or invalid extension");
-        return;
-    }
-    std::string extension = std::get<std::string>(itExt->second);
-    if (extension.empty() || extension[0] != '.') extension = "." + extension;
-
-    // Write video to temp file
-    std::string tempFilePath = GenerateTempFilename(extension);
-    if (!WriteBytesToFile(tempFilePath, videoBytes)) {
-        result->Error("FileError", "Failed to write video temp file");
-        return;
-    }
+    const MediaInput* input = engine ? engine->input() : probed.get();
+    bool found = ReadVideoMetadata(input->format_context(), input->size(), metadata);
+    session.engines().Release(std::move(engine));
+    if (!found && error) *error = "No video stream found";
+    return found;
+}
 
-    // Use FFmpeg to extract metadata
-    AVFormatContext* fmt_ctx = nullptr;
-    if (avformat_open_input(&fmt_ctx, tempFilePath.c_str(), nullptr, nullptr) != 0) {
-        fs::remove(tempFilePath);
-        result->Error("FFmpegError", "Could not open video file");
-        return;
+}  // namespace
+
+FlValue* NewVideoMetadataValue(const VideoMetadata& metadata) {
+    FlValue* result = fl_value_new_map();
+    fl_value_set_string_take(result, "duration", fl_value_new_float(metadata.durationMs));
+    fl_value_set_string_take(result, "width", fl_value_new_int(metadata.width));
+    fl_value_set_string_take(result, "height", fl_value_new_int(metadata.height));
+    fl_value_set_string_take(result, "fileSize", fl_value_new_int(metadata.fileSize));
+    fl_value_set_string_take(result, "frameRate", fl_value_new_float(metadata.frameRate));
+    fl_value_set_string_take(result, "averageFrameRate", fl_value_new_float(metadata.averageFrameRate));
+    fl_value_set_string_take(result, "rotation", fl_value_new_int(metadata.rotation));
+    SetString(result, "containerFormat", metadata.containerFormat);
+    SetString(result, "videoCodec", metadata.videoCodec);
+    SetString(result, "pixelFormat", metadata.pixelFormat);
+    fl_value_set_string_take(result, "videoBitRate", fl_value_new_int(metadata.videoBitRate));
+    fl_value_set_string_take(result, "bitRate", fl_value_new_int(metadata.bitRate));
+    fl_value_set_string_take(result, "indexEntries", fl_value_new_int(metadata.indexEntries));
+    fl_value_set_string_take(result, "keyframeCount", fl_value_new_int(metadata.keyframeCount));
+
+    FlValue* audioStreams = fl_value_new_list();
+    for (const AudioStreamMetadata& audio : metadata.audioStreams) {
+        FlValue* stream = fl_value_new_map();
+        SetString(stream, "codec", audio.codec);
+        SetString(stream, "sampleFormat", audio.sampleFormat);
+        fl_value_set_string_take(stream, "sampleRate", fl_value_new_int(audio.sampleRate));
+        fl_value_set_string_take(stream, "channels", fl_value_new_int(audio.channels));
+        SetString(stream, "channelLayout", audio.channelLayout);
+        fl_value_set_string_take(stream, "bitRate", fl_value_new_int(audio.bitRate));
+        fl_value_append_take(audioStreams, stream);
     }
+    fl_value_set_string_take(result, "audioStreams", audioStreams);
+    return result;
+}
 
-    if (avformat_find_stream_info(fmt_ctx, nullptr) < 0) {
-        avformat_close_input(&fmt_ctx);
-        fs::remove(tempFilePath);
-        result->Error("FFmpegError", "Failed to find stream info");
-        return;
-    }
+FlMethodResponse* HandleGetVideoInformation(const MethodArgs& args, const RangeReadCallback& readRange) {
 
-    int video_stream_index = -1;
-    for (unsigned i = 0; i < fmt_ctx->nb_streams; ++i) {
-        if (fmt_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-            video_stream_index = i;
-            break;
-        }
+    // Read the video from an open session, its path, Dart on demand, or
+    // straight from the channel buffer
+    FlMethodResponse* errorResponse = nullptr;
+    std::shared_ptr<MediaSession> session = ReadMediaSession(args, &errorResponse, readRange);
+    if (!session) {
+        return errorResponse;
     }
 
-    if (video_stream_index == -1) {
-        avformat_close_input(&fmt_ctx);
-        fs::remove(tempFilePath);
-        result->Error("FFmpegError", "No video stream found");
-        return;
+    std::string error;
+    VideoMetadata metadata;
+    bool found = ProbeSession(*session, ReadProbe(args), &metadata, &error);
+    MediaSessionCache::Shared().Trim();
+    if (!found) {
+        return ErrorResponse("FFmpegError", error);
     }
 
-    AVStream* video_stream = fmt_ctx->streams[video_stream_index];
-    double duration_ms = (fmt_ctx->duration > 0)
-        ? static_cast<double>(fmt_ctx->duration) / (AV_TIME_BASE / 1000)
-        : static_cast<double>(video_stream->duration) * av_q2d(video_stream->time_base) * 1000.0;
-
-    int width = video_stream->codecpar->width;
-    int height = video_stream->codecpar->height;
-    int64_t file_size = fs::file_size(tempFilePath);
+    return SuccessResponse(NewVideoMetadataValue(metadata));
+}
 
-    avformat_close_input(&fmt_ctx);
-    fs::remove(tempFilePath);
+FlMethodResponse* HandleGetVideoInformationBatch(const MethodArgs& args) {
+    FlValue* videos = args.GetList("videos");
+    if (!videos) {
+        return ErrorResponse("InvalidArgument", "Missing videos");
+    }
+    MediaProbe probe = ReadProbe(args);
+    int64_t maxConcurrency = 0;
+    args.GetInt("maxConcurrency", &maxConcurrency);
+
+    struct Result {
+        VideoMetadata metadata;
+        std::string errorCode;
+        std::string error;
+    };
+    size_t count = fl_value_get_length(videos);
+    std::vector<Result> results(count);
+
+    auto probeVideo = [&](size_t index) {
+        Result& result = results[index];
+        MethodArgs videoArgs(fl_value_get_list_value(videos, index));
+        if (!videoArgs.IsMap()) {
+            result.errorCode = "InvalidArgument";
+            result.error = "Expected a map";
+            return;
+        }
 
-    // Return result to Flutter
-    flutter::EncodableMap result_map;
-    result_map[flutter::EncodableValue("duration")] = flutter::EncodableValue(duration_ms);
-    result_map[flutter::EncodableValue("width")] = flutter::EncodableValue(width);
-    result_map[flutter::EncodableValue("height")] = flutter::EncodableValue(height);
-    result_map[flutter::EncodableValue("fileSize")] = flutter::EncodableValue(file_size);
+        FlMethodResponse* errorResponse = nullptr;
+        std::shared_ptr<MediaSession> session = ReadMediaSession(videoArgs, &errorResponse);
+        if (!session) {
+            FlMethodErrorResponse* response = FL_METHOD_ERROR_RESPONSE(errorResponse);
+            result.errorCode = fl_method_error_response_get_code(response);
+            result.error = fl_method_error_response_get_message(response);
+            g_object_unref(errorResponse);
+            return;
+        }
+        if (!ProbeSession(*session, probe, &result.metadata, &result.error)) {
+            result.errorCode = "FFmpegError";
+        }
+    };
+
+    // Every worker takes the next video once it is done, so a few slow
+    // probes do not hold up the others.
+    ThreadPool& pool = ThreadPool::Shared();
+    size_t workers = std::min(count, pool.size());
+    if (maxConcurrency > 0) workers = std::min(workers, static_cast<size_t>(maxConcurrency));
+    std::atomic<size_t> next{0};
+    std::vector<std::future<void>> futures;
+    for (size_t worker = 0; worker < workers; ++worker) {
+        futures.push_back(pool.Submit([&]() {
+            for (size_t index = next++; index < count; index = next++) probeVideo(index);
+        }));
+    }
+    for (auto& future : futures) {
+        pool.Wait(future);
+    }
+    MediaSessionCache::Shared().Trim();
 
-    result->Success(flutter::EncodableValue(result_map));
+    FlValue* list = fl_value_new_list();
+    for (const Result& result : results) {
+        if (result.errorCode.empty()) {
+            fl_value_append_take(list, NewVideoMetadataValue(result.metadata));
+            continue;
+        }
+        FlValue* error = fl_value_new_map();
+        fl_value_set_string_take(error, "errorCode", fl_value_new_string(result.errorCode.c_str()));
+        fl_value_set_string_take(error, "errorMessage", fl_value_new_string(result.error.c_str()));
+        fl_value_append_take(list, error);
+    }
+    return SuccessResponse(list);
 }
 
 }  // namespace pro_video_editor
@@ -1,13 +1,27 @@
 // src/video_processor.h
 #pragma once
 
-#include <flutter/standard_method_codec.h>
-#include <flutter/method_result_functions.h>
+#include "method_args.h"
+#include "video_metadata.h"
+#include "video_session.h"
 
 namespace pro_video_editor {
 
-	void HandleGetVideoInformation(
-		const flutter::EncodableMap& args,
-		std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+    // Returns |metadata| as the map getVideoInformation responds with.
+    // Unknown strings are null, unknown numbers 0.
+    FlValue* NewVideoMetadataValue(const VideoMetadata& metadata);
+
+    // Returns duration, resolution and size of the video in |args|. Videos
+    // given by `readerId` are read through |readRange|.
+    FlMethodResponse* HandleGetVideoInformation(
+        const MethodArgs& args,
+        const RangeReadCallback& readRange = nullptr);
+
+    // Probes every entry of `videos`, each a map like the video arguments
+    // of HandleGetVideoInformation, concurrently on the shared ThreadPool
+    // (at most `maxConcurrency` at once if given). The result lists the
+    // metadata in input order, or a map of `errorCode` and `errorMessage`
+    // for videos that failed.
+    FlMethodResponse* HandleGetVideoInformationBatch(const MethodArgs& args);
 
 }  // namespace pro_video_editor
@@ -0,0 +1,84 @@
+#include "video_session.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pro_video_editor {
+
+FlMethodResponse* HandleOpenVideo(const MethodArgs& args) {
+    MediaSource source;
+    std::string error;
+    if (!ReadMediaSource(args, &source, &error)) {
+        return ErrorResponse("InvalidArgument", error);
+    }
+
+    // |source| points into the argument map, which is released on the main
+    // thread once the call returns. The session keeps a copy of the bytes
+    // instead of a reference: FlValue reference counts are not atomic, and
+    // the last session reference may be dropped on any thread.
+    std::shared_ptr<const void> owner;
+    if (source.path.empty() && source.data) {
+        auto bytes = std::make_shared<std::vector<uint8_t>>(source.data, source.data + source.size);
+        source.data = bytes->data();
+        owner = std::move(bytes);
+    }
+
+    auto session = std::make_shared<MediaSession>(source, std::move(owner));
+    if (!session->Warm(&error)) {
+        return ErrorResponse("FFmpegError", error);
+    }
+
+    int64_t handle = MediaSessionCache::Shared().Add(std::move(session));
+    return SuccessResponse(fl_value_new_int(handle));
+}
+
+FlMethodResponse* HandleCloseVideo(const MethodArgs& args) {
+    int64_t handle = 0;
+    if (!args.GetInt("sessionId", &handle)) {
+        return ErrorResponse("InvalidArgument", "Missing sessionId");
+    }
+    // Closing twice, or after an eviction, is not an error.
+    MediaSessionCache::Shared().Remove(handle);
+    return SuccessResponse(nullptr);
+}
+
+std::shared_ptr<MediaSession> ReadMediaSession(
+    const MethodArgs& args,
+    FlMethodResponse** errorResponse,
+    const RangeReadCallback& readRange) {
+    int64_t handle = 0;
+    if (args.GetInt("sessionId", &handle)) {
+        std::shared_ptr<MediaSession> session = MediaSessionCache::Shared().Get(handle);
+        if (!session) {
+            *errorResponse = ErrorResponse("SessionNotFound", "The video was closed or evicted");
+        }
+        return session;
+    }
+
+    MediaSource source;
+    int64_t readerId = 0;
+    int64_t size = 0;
+    if (readRange && args.GetInt("readerId", &readerId)) {
+        if (!args.GetInt("videoSize", &size) || size <= 0 || !args.GetString("extension", &source.extension)) {
+            *errorResponse = ErrorResponse("InvalidArgument", "Missing videoSize or extension of the reader");
+            return nullptr;
+        }
+        if (source.extension[0] != '.') source.extension = "." + source.extension;
+        source.size = static_cast<size_t>(size);
+        source.read = [readRange, readerId](int64_t offset, uint8_t* buffer, size_t count) {
+            return readRange(readerId, offset, buffer, count);
+        };
+        return std::make_shared<MediaSession>(source, nullptr);
+    }
+
+    std::string error;
+    if (!ReadMediaSource(args, &source, &error)) {
+        *errorResponse = ErrorResponse("InvalidArgument", error);
+        return nullptr;
+    }
+    return std::make_shared<MediaSession>(source, nullptr);
+}
+
+}  // namespace pro_video_editor
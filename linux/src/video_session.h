@@ -0,0 +1,37 @@
+// src/video_session.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "media_session.h"
+#include "method_args.h"
+
+namespace pro_video_editor {
+
+    // Reads a range of the Dart-side video `readerId` like a RangeReader.
+    // Blocks until Dart answered, so it must not run on the main thread.
+    using RangeReadCallback =
+        std::function<int64_t(int64_t readerId, int64_t offset, uint8_t* buffer, size_t size)>;
+
+    // Opens the video in |args| as a MediaSession and returns its handle.
+    // The argument map is referenced, so `videoBytes` is kept without a copy.
+    FlMethodResponse* HandleOpenVideo(const MethodArgs& args);
+
+    // Closes the session `sessionId`.
+    FlMethodResponse* HandleCloseVideo(const MethodArgs& args);
+
+    // Resolves the video of a method call. With `sessionId` the open session
+    // is returned, otherwise one that only lives for this call is created
+    // from ReadMediaSource. With `readerId` and |readRange|, the video of
+    // `videoSize` bytes is read from Dart on demand instead. On failure
+    // returns nullptr and sets |errorResponse|; `SessionNotFound` tells Dart
+    // to resend the video.
+    std::shared_ptr<MediaSession> ReadMediaSession(
+        const MethodArgs& args,
+        FlMethodResponse** errorResponse,
+        const RangeReadCallback& readRange = nullptr);
+
+}  // namespace pro_video_editor
@@ -2,8 +2,33 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+}
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "include/pro_video_editor/pro_video_editor_plugin.h"
 #include "pro_video_editor_plugin_private.h"
+#include "src/decoder_threading.h"
+#include "src/export_video.h"
+#include "src/h264_bitstream.h"
+#include "src/media_session.h"
+#include "src/scratch_storage.h"
+#include "src/sprite_sheet.h"
+#include "src/thumbnail_cache.h"
 
 // This demonstrates a simple unit test of the C portion of this plugin's
 // implementation.
@@ -27,5 +52,462 @@ TEST(ProVideoEditorPlugin, GetPlatformVersion) {
   EXPECT_THAT(fl_value_get_string(result), testing::StartsWith("Linux "));
 }
 
+// Records the longest gap between two ticks of a 5 ms main loop timer.
+struct StallMonitor {
+  gint64 last_tick_us = 0;
+  gint64 max_gap_us = 0;
+};
+
+static gboolean stall_tick_cb(gpointer user_data) {
+  StallMonitor* monitor = static_cast<StallMonitor*>(user_data);
+  gint64 now = g_get_monotonic_time();
+  monitor->max_gap_us = std::max(monitor->max_gap_us, now - monitor->last_tick_us);
+  monitor->last_tick_us = now;
+  return G_SOURCE_CONTINUE;
+}
+
+TEST(ProVideoEditorPlugin, BackgroundWorkDoesNotStallMainLoop) {
+  g_autoptr(GMainLoop) loop = g_main_loop_new(nullptr, FALSE);
+  StallMonitor monitor;
+  monitor.last_tick_us = g_get_monotonic_time();
+  guint tick = g_timeout_add(5, stall_tick_cb, &monitor);
+
+  // Stands in for a slow handler, e.g. probing a large video.
+  bool responded = false;
+  run_on_background_thread(
+      []() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+        return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+      },
+      [&](FlMethodResponse* response) {
+        responded = FL_IS_METHOD_SUCCESS_RESPONSE(response);
+        g_main_loop_quit(loop);
+      });
+  g_main_loop_run(loop);
+  g_source_remove(tick);
+
+  EXPECT_TRUE(responded);
+  // The main loop kept ticking while the work ran. The bound is loose so a
+  // busy machine does not make the test flaky; a blocking handler would
+  // stall for the full 500 ms.
+  EXPECT_LT(monitor.max_gap_us, 100 * 1000);
+  std::printf("main loop stall: %.1f ms\n", monitor.max_gap_us / 1000.0);
+}
+
+TEST(MediaSessionCache, EvictsLeastRecentlyUsedOverBudget) {
+  // In-memory videos count with their size; nothing is decoded here.
+  static const uint8_t kBytes[100] = {};
+  MediaSource source;
+  source.data = kBytes;
+  source.size = sizeof(kBytes);
+  source.extension = ".mp4";
+
+  MediaSessionCache cache(250);
+  int64_t first = cache.Add(std::make_shared<MediaSession>(source, nullptr));
+  int64_t second = cache.Add(std::make_shared<MediaSession>(source, nullptr));
+  EXPECT_NE(cache.Get(first), nullptr);
+
+  // |second| is now the least recently used one.
+  int64_t third = cache.Add(std::make_shared<MediaSession>(source, nullptr));
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_NE(cache.Get(first), nullptr);
+  EXPECT_EQ(cache.Get(second), nullptr);
+  EXPECT_NE(cache.Get(third), nullptr);
+
+  EXPECT_TRUE(cache.Remove(first));
+  EXPECT_FALSE(cache.Remove(first));
+
+  // The most recent session stays even if it alone exceeds the budget.
+  cache.SetMemoryBudget(10);
+  EXPECT_EQ(cache.size(), 1u);
+  EXPECT_NE(cache.Get(third), nullptr);
+}
+
+TEST(ThumbnailCache, ServesFromMemoryAndPersistsToDisk) {
+  std::string directory = std::filesystem::temp_directory_path() /
+                          ("thumbnail_cache_test_" + std::to_string(getpid()));
+  std::filesystem::remove_all(directory);
+
+  std::vector<uint8_t> image(100, 7);
+  std::vector<uint8_t> out;
+  std::string first = ThumbnailCache::MakeKey(
+      1, 1000, 320, "jpeg", ThumbnailExactness::Exact, 80);
+  std::string second = ThumbnailCache::MakeKey(
+      1, 1000, 320, "jpeg", ThumbnailExactness::NearestKeyframe, 80);
+  EXPECT_NE(first, second);
+
+  {
+    // Room for one image in memory, two on disk.
+    ThumbnailCache cache(directory, 150, 250);
+    EXPECT_FALSE(cache.Lookup(first, &out));
+    cache.Store(first, image);
+    EXPECT_TRUE(cache.Lookup(first, &out));
+    EXPECT_EQ(out, image);
+
+    cache.Store(second, image);
+    EXPECT_TRUE(cache.Lookup(first, &out));
+    ThumbnailCache::Stats stats = cache.stats();
+    EXPECT_EQ(stats.memoryHits, 1u);
+    EXPECT_EQ(stats.diskHits, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.diskBytes, 200u);
+  }
+
+  {
+    // A new instance finds the files and keeps the most recently used one.
+    ThumbnailCache cache(directory, 150, 150);
+    EXPECT_TRUE(cache.Lookup(first, &out));
+    EXPECT_FALSE(cache.Lookup(second, &out));
+    EXPECT_EQ(cache.stats().diskHits, 1u);
+
+    cache.Clear();
+    EXPECT_TRUE(std::filesystem::is_empty(directory));
+  }
+  std::filesystem::remove_all(directory);
+}
+
+// Creates |perThread| scratch files on each of 8 threads at once, keeps
+// them all open and checks that no two share an inode or each other's data.
+static void StressScratchFiles(int perThread) {
+  constexpr int kThreads = 8;
+  std::vector<std::vector<std::unique_ptr<ScratchFile>>> files(kThreads);
+  std::vector<int> failures(kThreads, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < perThread; ++i) {
+        std::vector<uint8_t> payload(64 + i, static_cast<uint8_t>(t * perThread + i));
+        std::unique_ptr<ScratchFile> file =
+            ScratchFile::CreateWithData("stress", payload.data(), payload.size(), nullptr);
+        std::vector<uint8_t> readBack;
+        if (!file || !file->ReadAll(&readBack) || readBack != payload) {
+          ++failures[t];
+          continue;
+        }
+        files[t].push_back(std::move(file));
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  std::set<std::pair<dev_t, ino_t>> inodes;
+  for (int t = 0; t < kThreads; ++t) {
+    EXPECT_EQ(failures[t], 0);
+    for (const auto& file : files[t]) {
+      struct stat info;
+      ASSERT_EQ(fstat(file->fd(), &info), 0);
+      EXPECT_TRUE(inodes.insert({info.st_dev, info.st_ino}).second);
+    }
+  }
+  EXPECT_EQ(inodes.size(), static_cast<size_t>(kThreads * perThread));
+}
+
+TEST(ScratchStorage, ConcurrentMemoryFilesNeverCollide) {
+  StressScratchFiles(200);
+}
+
+TEST(ScratchStorage, DirectoryFilesLeaveNothingBehind) {
+  ScratchStorageConfig original = GetScratchStorageConfig();
+  std::filesystem::path directory = std::filesystem::temp_directory_path() /
+      ("pro_video_editor_scratch_test_" + std::to_string(getpid()));
+  std::filesystem::create_directories(directory);
+
+  ScratchStorageConfig config;
+  config.backing = ScratchBacking::Directory;
+  config.directory = directory.string();
+  SetScratchStorageConfig(config);
+  StressScratchFiles(50);
+
+  // Files are unnamed, so the directory stays empty even while they exist.
+  {
+    const uint8_t data[] = {1, 2, 3};
+    std::unique_ptr<ScratchFile> file = ScratchFile::CreateWithData("open", data, sizeof(data), nullptr);
+    ASSERT_NE(file, nullptr);
+    EXPECT_EQ(file->size(), sizeof(data));
+    EXPECT_TRUE(std::filesystem::exists(file->path()));
+    EXPECT_TRUE(std::filesystem::is_empty(directory));
+  }
+
+  SetScratchStorageConfig(original);
+  std::filesystem::remove_all(directory);
+}
+
+TEST(SpriteSheet, PacksTilesInInputOrder) {
+  // Two rows of two 2 px wide cells, as high as the highest thumbnail.
+  std::vector<std::vector<uint8_t>> thumbnails = {
+      std::vector<uint8_t>(2 * 3 * 4, 1),
+      {},
+      std::vector<uint8_t>(2 * 2 * 4, 3),
+  };
+  SpriteSheet sheet;
+  ASSERT_TRUE(ComposeSpriteSheet(thumbnails, 2, 2, &sheet));
+  EXPECT_EQ(sheet.width, 4);
+  EXPECT_EQ(sheet.height, 6);
+  ASSERT_EQ(sheet.tiles.size(), 3u);
+
+  EXPECT_EQ(sheet.tiles[0].height, 3);
+  EXPECT_EQ(sheet.tiles[1].width, 0);
+  EXPECT_EQ(sheet.tiles[2].x, 0);
+  EXPECT_EQ(sheet.tiles[2].y, 3);
+  EXPECT_EQ(sheet.tiles[2].height, 2);
+
+  // The failed thumbnail leaves its cell transparent.
+  EXPECT_EQ(sheet.pixels[0], 1);
+  EXPECT_EQ(sheet.pixels[2 * 4], 0);
+  EXPECT_EQ(sheet.pixels[3 * sheet.width * 4], 3);
+
+  EXPECT_FALSE(ComposeSpriteSheet({{}, {}}, 2, 2, &sheet));
+}
+
+TEST(H264Bitstream, ReadsParameterSetIdsAndConvertsAnnexB) {
+  // avcC with 4 byte lengths, SPS id 0 (ue "1") and PPS id 0, SPS id 0.
+  const uint8_t avcc[] = {
+      1, 100, 0, 31, 0xff, 0xe1,
+      0, 5, 0x67, 100, 0, 31, 0x80,
+      1,
+      0, 2, 0x68, 0xc0,
+  };
+  AvcDecoderConfig config;
+  ASSERT_TRUE(ParseAvcDecoderConfig(avcc, sizeof(avcc), &config));
+  EXPECT_EQ(config.nalLengthSize, 4);
+  EXPECT_EQ(config.spsIds, std::vector<int>({0}));
+  EXPECT_EQ(config.ppsIds, std::vector<int>({0}));
+  EXPECT_EQ(UnusedParameterSetId(config), 1);
+
+  const uint8_t annexB[] = {0, 0, 0, 1, 0x67, 1, 2, 0, 0, 1, 0x65, 3};
+  std::vector<uint8_t> converted;
+  ASSERT_TRUE(AnnexBToLengthPrefixed(annexB, sizeof(annexB), 4, &converted));
+  EXPECT_EQ(converted, std::vector<uint8_t>({0, 0, 0, 3, 0x67, 1, 2, 0, 0, 0, 2, 0x65, 3}));
+
+  // Annex B extradata is not an avcC record.
+  EXPECT_FALSE(ParseAvcDecoderConfig(annexB, sizeof(annexB), &config));
+}
+
+// Encodes |frames| frames of a moving 64x64 gradient at 30 fps into an
+// H.264 MP4 at |path|, with a keyframe every |gop| frames and |bFrames|
+// B-frames between the reference frames. Returns false without libx264.
+static bool WriteTestClip(const std::string& path, int frames, int gop, int bFrames) {
+  const AVCodec* codec = avcodec_find_encoder_by_name("libx264");
+  AVFormatContext* out = nullptr;
+  if (!codec || avformat_alloc_output_context2(&out, nullptr, "mp4", path.c_str()) < 0) return false;
+  AVCodecContext* encoder = avcodec_alloc_context3(codec);
+  AVStream* stream = avformat_new_stream(out, nullptr);
+  encoder->width = 64;
+  encoder->height = 64;
+  encoder->pix_fmt = AV_PIX_FMT_YUV420P;
+  encoder->time_base = {1, 30};
+  encoder->framerate = {30, 1};
+  encoder->gop_size = gop;
+  encoder->keyint_min = gop;
+  encoder->max_b_frames = bFrames;
+  encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  // Fixed GOPs with every B-frame slot used, whatever the content.
+  av_opt_set(encoder->priv_data, "preset", "veryfast", 0);
+  av_opt_set(encoder->priv_data, "x264-params", "scenecut=0:b-adapt=0", 0);
+
+  AVFrame* frame = av_frame_alloc();
+  AVPacket* packet = av_packet_alloc();
+  frame->format = encoder->pix_fmt;
+  frame->width = encoder->width;
+  frame->height = encoder->height;
+  bool ok = avcodec_open2(encoder, codec, nullptr) >= 0 &&
+            avcodec_parameters_from_context(stream->codecpar, encoder) >= 0 &&
+            av_frame_get_buffer(frame, 0) >= 0 &&
+            avio_open(&out->pb, path.c_str(), AVIO_FLAG_WRITE) >= 0 &&
+            avformat_write_header(out, nullptr) >= 0;
+  for (int i = 0; ok && i <= frames; ++i) {
+    if (i < frames) {
+      ok = av_frame_make_writable(frame) >= 0;
+      for (int y = 0; ok && y < frame->height; ++y) {
+        for (int x = 0; x < frame->width; ++x) {
+          frame->data[0][y * frame->linesize[0] + x] = static_cast<uint8_t>(x + y + i * 3);
+        }
+      }
+      for (int plane = 1; ok && plane < 3; ++plane) {
+        for (int y = 0; y < frame->height / 2; ++y) {
+          std::fill_n(frame->data[plane] + y * frame->linesize[plane], frame->width / 2, 128);
+        }
+      }
+      frame->pts = i;
+    }
+    // The last round flushes the encoder.
+    ok = ok && avcodec_send_frame(encoder, i < frames ? frame : nullptr) >= 0;
+    while (ok && avcodec_receive_packet(encoder, packet) >= 0) {
+      av_packet_rescale_ts(packet, encoder->time_base, stream->time_base);
+      packet->stream_index = stream->index;
+      ok = av_interleaved_write_frame(out, packet) >= 0;
+    }
+  }
+  ok = ok && av_write_trailer(out) >= 0;
+
+  av_packet_free(&packet);
+  av_frame_free(&frame);
+  avcodec_free_context(&encoder);
+  avio_closep(&out->pb);
+  avformat_free_context(out);
+  return ok;
+}
+
+// The video of a file: its packets in decoding order and the timestamps of
+// its decoded frames in microseconds, in presentation order.
+struct VideoTrack {
+  std::vector<uint8_t> extradata;
+  std::vector<std::vector<uint8_t>> packets;
+  std::vector<int64_t> framesUs;
+};
+
+static bool ReadVideoTrack(const std::string& path, VideoTrack* track) {
+  AVFormatContext* in = nullptr;
+  if (avformat_open_input(&in, path.c_str(), nullptr, nullptr) < 0) return false;
+  int index = avformat_find_stream_info(in, nullptr) >= 0
+      ? av_find_best_stream(in, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0)
+      : -1;
+  if (index < 0) {
+    avformat_close_input(&in);
+    return false;
+  }
+  AVStream* stream = in->streams[index];
+  track->extradata.assign(stream->codecpar->extradata,
+                          stream->codecpar->extradata + stream->codecpar->extradata_size);
+
+  const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+  AVCodecContext* decoder = avcodec_alloc_context3(codec);
+  AVPacket* packet = av_packet_alloc();
+  AVFrame* frame = av_frame_alloc();
+  bool ok = codec && avcodec_parameters_to_context(decoder, stream->codecpar) >= 0 &&
+            avcodec_open2(decoder, codec, nullptr) >= 0;
+  bool eof = false;
+  while (ok && !eof) {
+    eof = av_read_frame(in, packet) < 0;
+    if (!eof && packet->stream_index != index) {
+      av_packet_unref(packet);
+      continue;
+    }
+    if (!eof) track->packets.emplace_back(packet->data, packet->data + packet->size);
+    ok = avcodec_send_packet(decoder, eof ? nullptr : packet) >= 0;
+    av_packet_unref(packet);
+    while (ok && avcodec_receive_frame(decoder, frame) >= 0) {
+      track->framesUs.push_back(av_rescale_q(frame->best_effort_timestamp, stream->time_base, {1, 1000000}));
+    }
+  }
+
+  av_frame_free(&frame);
+  av_packet_free(&packet);
+  avcodec_free_context(&decoder);
+  avformat_close_input(&in);
+  return ok;
+}
+
+TEST(ExportVideo, SplitsAtTheKeyframesClosestToEvenSegments) {
+  constexpr int64_t kSecond = 1000000;
+  std::vector<int64_t> keyframes;
+  for (int64_t t = 2; t < 120; t += 2) keyframes.push_back(t * kSecond);
+
+  // 120 s in 4 segments, keyframes every 2 s: the even splits are exact.
+  EXPECT_EQ(SplitAtKeyframes(keyframes, 0, 120 * kSecond, 4, 10 * kSecond),
+            std::vector<int64_t>({0, 30 * kSecond, 60 * kSecond, 90 * kSecond}));
+
+  // A trim starting at 1 s moves the splits to the closest keyframes.
+  EXPECT_EQ(SplitAtKeyframes(keyframes, kSecond, 58 * kSecond, 2, 10 * kSecond),
+            std::vector<int64_t>({kSecond, 30 * kSecond}));
+
+  // Sparse keyframes never give segments much shorter than the minimum.
+  std::vector<int64_t> sparse = {3 * kSecond, 50 * kSecond};
+  EXPECT_EQ(SplitAtKeyframes(sparse, 0, 60 * kSecond, 4, 10 * kSecond),
+            std::vector<int64_t>({0, 50 * kSecond}));
+  EXPECT_EQ(SplitAtKeyframes({}, 0, 60 * kSecond, 4, 10 * kSecond), std::vector<int64_t>({0}));
+}
+
+TEST(ExportVideo, CopiesVideoThatMatchesTheMp4EncodingConfig) {
+  std::filesystem::path directory = std::filesystem::temp_directory_path() /
+      ("pro_video_editor_copy_test_" + std::to_string(getpid()));
+  std::filesystem::create_directories(directory);
+  std::string source = (directory / "source.mp4").string();
+  std::string output = (directory / "output.mp4").string();
+  if (!WriteTestClip(source, 90, 30, 2)) {
+    std::filesystem::remove_all(directory);
+    GTEST_SKIP() << "libx264 is not available";
+  }
+
+  // The arguments Mp4EncodingConfig sends, which always name a pixel format.
+  ExportVideoOptions options;
+  options.source.path = source;
+  options.videoDurationMs = 3000;
+  options.allowStreamCopy = true;
+  options.codecArgs = {"-c:v", "libx264", "-crf", "23", "-preset", "fast",
+                       "-pix_fmt", "yuv420p", "-c:a", "aac"};
+  options.outputPath = output;
+  std::string error;
+  ASSERT_TRUE(ExportVideo(options, nullptr, nullptr, &error)) << error;
+
+  // Only a copy gives back the source packets.
+  VideoTrack in;
+  VideoTrack out;
+  ASSERT_TRUE(ReadVideoTrack(source, &in));
+  ASSERT_TRUE(ReadVideoTrack(output, &out));
+  EXPECT_EQ(out.extradata, in.extradata);
+  EXPECT_EQ(out.packets, in.packets);
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST(ExportVideo, ParallelSegmentsKeepEveryFrameOfBFrameVideo) {
+  if (std::thread::hardware_concurrency() < 2) GTEST_SKIP() << "Segments need two cores";
+  std::filesystem::path directory = std::filesystem::temp_directory_path() /
+      ("pro_video_editor_segment_test_" + std::to_string(getpid()));
+  std::filesystem::create_directories(directory);
+  std::string source = (directory / "source.mp4").string();
+  std::string output = (directory / "output.mp4").string();
+  // 25 s with a keyframe every second: two segments, joined at a keyframe
+  // that is shown three frames after it is decoded.
+  constexpr int kFrames = 750;
+  if (!WriteTestClip(source, kFrames, 30, 3)) {
+    std::filesystem::remove_all(directory);
+    GTEST_SKIP() << "libx264 is not available";
+  }
+
+  ExportVideoOptions options;
+  options.source.path = source;
+  options.videoDurationMs = kFrames * 1000 / 30;
+  options.codecArgs = {"-c:v", "libx264", "-preset", "ultrafast"};
+  options.parallelSegments = 2;
+  options.outputPath = output;
+  std::string error;
+  ASSERT_TRUE(ExportVideo(options, nullptr, nullptr, &error)) << error;
+
+  // A frame lost or repeated at the join breaks the even spacing.
+  VideoTrack out;
+  ASSERT_TRUE(ReadVideoTrack(output, &out));
+  ASSERT_EQ(out.framesUs.size(), static_cast<size_t>(kFrames));
+  for (size_t i = 1; i < out.framesUs.size(); ++i) {
+    EXPECT_NEAR(out.framesUs[i] - out.framesUs[i - 1], 1000000 / 30, 1) << "at frame " << i;
+  }
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST(DecoderThreading, SplitsCoresAmongConcurrentDecoders) {
+  DecoderThreadingPolicy original = GetDecoderThreadingPolicy();
+
+  int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  DecoderThreading one = DecoderThreadingFor(DecodeWorkload::Thumbnails, 1);
+  EXPECT_EQ(one.threadCount, cores);
+  EXPECT_EQ(one.threadType, DecoderThreadType::Slice);
+  EXPECT_EQ(DecoderThreadingFor(DecodeWorkload::Thumbnails, cores * 2).threadCount, 1);
+  EXPECT_EQ(DecoderThreadingFor(DecodeWorkload::Export).threadType,
+            DecoderThreadType::FrameAndSlice);
+
+  // Explicit thread counts are kept as they are.
+  DecoderThreadingPolicy policy;
+  policy.exportVideo = {3, DecoderThreadType::Frame};
+  SetDecoderThreadingPolicy(policy);
+  DecoderThreading exportThreading = DecoderThreadingFor(DecodeWorkload::Export, 8);
+  EXPECT_EQ(exportThreading.threadCount, 3);
+  EXPECT_EQ(exportThreading.threadType, DecoderThreadType::Frame);
+
+  SetDecoderThreadingPolicy(original);
+}
+
 }  // namespace test
 }  // namespace pro_video_editor
@@ -3,7 +3,12 @@ import 'dart:ui';
 
 import 'package:flutter_test/flutter_test.dart';
 import 'package:plugin_platform_interface/plugin_platform_interface.dart';
+import 'package:pro_video_editor/core/models/thumbnail/create_thumbnail_sprite_sheet_model.dart';
 import 'package:pro_video_editor/core/models/thumbnail/create_video_thumbnail_model.dart';
+import 'package:pro_video_editor/core/models/thumbnail/indexed_thumbnail_model.dart';
+import 'package:pro_video_editor/core/models/thumbnail/raw_thumbnail_model.dart';
+import 'package:pro_video_editor/core/models/thumbnail/thumbnail_cache_stats_model.dart';
+import 'package:pro_video_editor/core/models/thumbnail/thumbnail_sprite_sheet_model.dart';
 import 'package:pro_video_editor/core/models/video/editor_video_model.dart';
 import 'package:pro_video_editor/core/models/video/export_video_model.dart';
 import 'package:pro_video_editor/core/models/video/video_information_model.dart';
@@ -22,7 +27,43 @@ class MockProVideoEditorPlatform
   }
 
   @override
-  Future<VideoInformation> getVideoInformation(EditorVideo value) {
+  Future<List<RawThumbnail?>> createRawVideoThumbnails(
+    CreateVideoThumbnail value,
+  ) {
+    return Future.value([]);
+  }
+
+  @override
+  Stream<IndexedThumbnail> createVideoThumbnailsStream(
+    CreateVideoThumbnail value,
+  ) {
+    return const Stream.empty();
+  }
+
+  @override
+  Future<ThumbnailSpriteSheet> createThumbnailSpriteSheet(
+    CreateThumbnailSpriteSheet value,
+  ) {
+    return Future.value(ThumbnailSpriteSheet(
+      bytes: Uint8List(0),
+      format: value.format,
+      width: 0,
+      height: 0,
+      tiles: const [],
+    ));
+  }
+
+  @override
+  Future<void> openVideo(EditorVideo value) => Future.value();
+
+  @override
+  Future<void> closeVideo(EditorVideo value) => Future.value();
+
+  @override
+  Future<VideoInformation> getVideoInformation(
+    EditorVideo value, {
+    VideoProbeMode probeMode = VideoProbeMode.fast,
+  }) {
     return Future.value(VideoInformation(
       duration: Duration.zero,
       extension: 'mp4',
@@ -31,6 +72,26 @@ class MockProVideoEditorPlatform
     ));
   }
 
+  @override
+  Future<List<VideoInformation?>> getVideoInformationBatch(
+    List<EditorVideo> values, {
+    VideoProbeMode probeMode = VideoProbeMode.fast,
+    int? maxConcurrency,
+  }) {
+    return Future.value(List.filled(values.length, null));
+  }
+
+  @override
+  Future<ThumbnailCacheStats> getThumbnailCacheStats() {
+    return Future.value(const ThumbnailCacheStats(
+      memoryHits: 0,
+      diskHits: 0,
+      misses: 0,
+      memoryBytes: 0,
+      diskBytes: 0,
+    ));
+  }
+
   @override
   Stream<double> get exportProgressStream => const Stream.empty();
 
@@ -38,6 +99,11 @@ class MockProVideoEditorPlatform
   Future<Uint8List> exportVideo(ExportVideoModel value) {
     return Future.value(Uint8List(0));
   }
+
+  @override
+  Future<String> exportVideoToFile(ExportVideoModel value, String outputPath) {
+    return Future.value(outputPath);
+  }
 }
 
 void main() {